@@ -0,0 +1,183 @@
+#ifndef ZPPARCHIVE_HPP
+#define ZPPARCHIVE_HPP
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "zpplib.hpp"
+
+namespace slx
+{
+  //! Класс чтения набора файлов, сжатых zlib
+  /*!
+     Объекты чтения всех файлов разделяют один кэш распакованных участков.
+     Количество одновременно открытых файлов ограничено: давно
+     не использованные файлы закрываются и при следующем чтении открываются
+     снова. Индекс файла строится при первом обращении к нему.
+     Память под окна индексов ограничивается общим для процесса лимитом
+     ZppReader::SetIndexMemoryLimit()
+   */
+  class ZppArchive
+  {
+  public:
+    //! Конструктор
+    ZppArchive
+    (
+        const size_t i_max_open_files = 256 //!< [in] Максимальное количество открытых файлов
+      , const size_t i_cache_size = 67108864 //!< [in] Лимит памяти кэша распакованных участков
+    );
+
+    //! Деструктор
+    ~ZppArchive();
+
+    ZppArchive(const ZppArchive &) = delete;
+    ZppArchive & operator = (const ZppArchive &) = delete;
+
+    //! Добавить файл
+    /*!
+       Файл не открывается до первого обращения
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Add
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Удалить файл
+    /*!
+       Не должен вызываться одновременно с чтением этого файла
+     */
+    void Remove
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Получить количество файлов
+    /*!
+      \return Количество файлов
+     */
+    size_t GetFileCount();
+
+    //! Получить объект чтения файла
+    /*!
+       Строит индекс файла при первом обращении.
+       Объект принадлежит архиву
+
+       \return Объект чтения
+       \return nullptr Файл не добавлен или ошибка построения индекса
+     */
+    ZppReader * GetReader
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Прочитать данные
+    /*!
+       Чтение данных файла по смещению
+       Считывается i_count байт
+
+       \return Количество считанных байт
+       \return <0 Ошибка
+     */
+    ssize_t ReadOffset
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Прочитать данные
+    /*!
+       Чтение данных файла по смещению
+       Считывается i_count байт
+
+       \return Количество считанных байт
+       \return <0 Ошибка
+     */
+    ssize_t ReadOffset
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Получить размер несжатых данных файла
+    /*!
+      \return Размер файла, 0 в случае ошибки
+     */
+    size_t GetSize
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Установить максимальное количество открытых файлов
+    /*!
+       Файлы, из которых идет чтение, не закрываются, поэтому лимит
+       может быть превышен на время одновременного чтения многих файлов
+     */
+    void SetMaxOpenFiles
+    (
+        const size_t i_count //!< [in] Максимальное количество открытых файлов
+    );
+
+    //! Получить максимальное количество открытых файлов
+    /*!
+      \return Максимальное количество открытых файлов
+     */
+    size_t GetMaxOpenFiles();
+
+    //! Получить количество открытых файлов
+    /*!
+      \return Количество открытых файлов
+     */
+    size_t GetOpenFileCount();
+
+    //! Получить кэш распакованных участков
+    /*!
+      \return Кэш, общий для всех файлов архива
+     */
+    ZppLruSpanCache & GetSpanCache();
+
+  protected:
+    class Source;
+
+    struct Entry
+    {
+      std::unique_ptr<Source> source;
+      std::unique_ptr<ZppReader> reader;
+      bool flag_indexed = false;
+      std::mutex mutex;
+    };
+
+    Entry * FindEntry(const std::string & i_filename);
+
+    ZppFileSource * Acquire(Source * i_source);
+
+    void Release(Source * i_source);
+
+    void CloseSource(Source * i_source);
+
+    void Trim
+    (
+        const size_t i_limit
+    );
+
+    std::map<std::string, std::unique_ptr<Entry>> m_entries;
+    std::mutex m_mutex;
+
+    std::list<Source *> m_open; //!< Открытые файлы, начиная с последнего использованного
+    size_t m_max_open_files = 0;
+    std::mutex m_handle_mutex;
+
+    ZppLruSpanCache m_cache;
+  };
+}
+
+#endif // ZPPARCHIVE_HPP
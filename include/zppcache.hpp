@@ -0,0 +1,266 @@
+#ifndef ZPPCACHE_HPP
+#define ZPPCACHE_HPP
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace slx
+{
+  //! Ключ распакованного участка
+  struct ZppSpanKey
+  {
+    uint64_t file = 0; //!< Хэш идентификатора файла
+    uint64_t offset = 0; //!< Смещение начала участка в несжатых данных
+
+    bool operator == (const ZppSpanKey & i_other) const;
+  };
+
+  //! Кэш распакованных участков между точками доступа
+  /*!
+     Может разделяться несколькими объектами чтения, методы вызываются
+     из разных потоков одновременно
+   */
+  class ZppSpanCache
+  {
+  public:
+    virtual ~ZppSpanCache() = default;
+
+    //! Найти участок и скопировать из него данные
+    /*!
+       После промаха вызывающий распаковывает участок и передаёт его
+       Insert() или, при ошибке, вызывает Cancel()
+
+       \return true Участок найден, данные скопированы
+       \return false Участка нет в кэше или он короче запрошенного
+     */
+    virtual bool Lookup
+    (
+        const ZppSpanKey & i_key //!< [in] Ключ участка
+      , const size_t i_offset //!< [in] Смещение внутри участка
+      , uint8_t * o_data //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт
+    ) = 0;
+
+    //! Поместить участок в кэш
+    virtual void Insert
+    (
+        const ZppSpanKey & i_key //!< [in] Ключ участка
+      , const uint8_t * i_data //!< [in] Распакованные данные участка
+      , const size_t i_size //!< [in] Размер участка
+    ) = 0;
+
+    //! Отказаться от помещения участка в кэш
+    /*!
+       Вызывается вместо Insert(), если участок после промаха Lookup()
+       распаковать не удалось
+     */
+    virtual void Cancel
+    (
+        const ZppSpanKey & i_key //!< [in] Ключ участка
+    );
+  };
+
+  //! Кэш распакованных участков в памяти процесса
+  /*!
+     При превышении лимита вытесняются давно не использованные участки
+   */
+  class ZppLruSpanCache : public ZppSpanCache
+  {
+  public:
+    //! Конструктор
+    ZppLruSpanCache
+    (
+        const size_t i_limit //!< [in] Лимит памяти в байтах
+    );
+
+    bool Lookup
+    (
+        const ZppSpanKey & i_key
+      , const size_t i_offset
+      , uint8_t * o_data
+      , const size_t i_count
+    ) override;
+
+    void Insert
+    (
+        const ZppSpanKey & i_key
+      , const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+    //! Установить лимит памяти
+    void SetLimit
+    (
+        const size_t i_limit //!< [in] Лимит памяти в байтах
+    );
+
+    //! Получить лимит памяти
+    /*!
+      \return Лимит памяти в байтах
+     */
+    size_t GetLimit();
+
+    //! Получить объем памяти, занятый участками
+    /*!
+      \return Объем в байтах
+     */
+    size_t GetUsage();
+
+    //! Очистить кэш
+    void Clear();
+
+  protected:
+    struct KeyHash
+    {
+      size_t operator () (const ZppSpanKey & i_key) const;
+    };
+
+    typedef std::list<std::pair<ZppSpanKey, std::vector<uint8_t>>> SpanList;
+
+    void Trim();
+
+    SpanList m_spans; //!< Участки, начиная с последнего использованного
+    std::unordered_map<ZppSpanKey, SpanList::iterator, KeyHash> m_map;
+    size_t m_limit = 0;
+    size_t m_usage = 0;
+    std::mutex m_mutex;
+  };
+
+  //! Кэш распакованных участков в разделяемой памяти
+  /*!
+     Сегмент POSIX shared memory разделяется всеми процессами, открывшими
+     кэш с тем же именем, поэтому участок горячего файла распаковывается
+     один раз на хост, а не в каждом процессе.
+
+     Сегмент разбит на ячейки одного размера, участок длиннее ячейки
+     не кэшируется. Ячейки сгруппированы в наборы по WAYS штук, участок
+     попадает в набор по хэшу ключа, в наборе вытесняется давно не
+     использованная ячейка. Чтение без блокировок: ячейка защищена
+     счётчиком версий, запись захватывает одну ячейку.
+
+     Промах Lookup() захватывает ячейку под участок до Insert() или
+     Cancel(), и другие процессы, запросившие тот же участок, ждут его
+     вместо повторной распаковки, но не дольше заданного в конструкторе
+     времени, после чего распаковывают участок сами. Ячейку, захваченную
+     завершившимся процессом, забирает следующая запись.
+
+     Размеры сегмента задаёт создавший его процесс, остальные используют
+     их независимо от параметров конструктора. Сегмент хранит содержимое
+     файлов и по умолчанию доступен только владельцу
+   */
+  class ZppShmSpanCache : public ZppSpanCache
+  {
+  public:
+    //! Конструктор
+    /*!
+       Открывает сегмент, создавая его при отсутствии
+     */
+    ZppShmSpanCache
+    (
+        const std::string & i_name //!< [in] Имя сегмента, "/имя"
+      , const size_t i_limit //!< [in] Объем данных в байтах
+      , const size_t i_slot_size = 1310720 //!< [in] Размер ячейки, не меньше расстояния между точками доступа
+      , const mode_t i_mode = 0600 //!< [in] Права создаваемого сегмента
+      , const size_t i_wait = 20000 //!< [in] Наибольшее ожидание участка, распаковываемого другим процессом, мкс
+    );
+
+    //! Деструктор
+    /*!
+       Отключается от сегмента, сегмент остаётся до Remove()
+     */
+    ~ZppShmSpanCache();
+
+    ZppShmSpanCache(const ZppShmSpanCache &) = delete;
+    ZppShmSpanCache & operator = (const ZppShmSpanCache &) = delete;
+
+    bool Lookup
+    (
+        const ZppSpanKey & i_key
+      , const size_t i_offset
+      , uint8_t * o_data
+      , const size_t i_count
+    ) override;
+
+    void Insert
+    (
+        const ZppSpanKey & i_key
+      , const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+    void Cancel
+    (
+        const ZppSpanKey & i_key
+    ) override;
+
+    //! Получить статус готовности
+    /*!
+      \return Статус готовности
+     */
+    bool IsReady();
+
+    //! Получить размер ячейки
+    /*!
+      \return Наибольший кэшируемый участок в байтах
+     */
+    size_t GetSlotSize();
+
+    //! Получить количество ячеек
+    /*!
+      \return Количество ячеек
+     */
+    size_t GetSlotCount();
+
+    //! Удалить сегмент
+    /*!
+       Подключённые процессы продолжают работать с ним до отключения
+
+       \return true Успех
+     */
+    static bool Remove
+    (
+        const std::string & i_name //!< [in] Имя сегмента
+    );
+
+    //! Ячеек в наборе
+    static const size_t WAYS = 8;
+
+  protected:
+    struct header;
+    struct slot;
+
+    //! Пауза ожидания участка, распаковываемого другим процессом, мкс
+    static const int WAIT_STEP = 100;
+
+    int attach(const std::string & i_name, const size_t i_limit, const size_t i_slot_size, const mode_t i_mode);
+
+    slot * find_set(const ZppSpanKey & i_key);
+
+    /* Take a slot of the set for the span: the one holding it, an empty or
+     the oldest one. Returns the slot with an odd seq, or nullptr. */
+    slot * take_slot(const ZppSpanKey & i_key, slot * io_set);
+
+    /* The slot this process took for the span, or nullptr. */
+    slot * find_claim(const ZppSpanKey & i_key, slot * io_set);
+
+    void release(slot & io_slot);
+
+    bool is_alive(slot & i_slot);
+
+    header * m_header = nullptr;
+    slot * m_slots = nullptr;
+    uint8_t * m_data = nullptr;
+    size_t m_mapped = 0;  //!< Размер отображения
+    size_t m_slot_count = 0;  //!< Проверенные размеры сегмента, заголовку
+    size_t m_slot_size = 0;   //!< после подключения не доверяем
+    size_t m_wait = 0;  //!< Наибольшее ожидание участка, мкс
+  };
+}
+
+#endif // ZPPCACHE_HPP
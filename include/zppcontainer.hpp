@@ -0,0 +1,297 @@
+#ifndef ZPPCONTAINER_HPP
+#define ZPPCONTAINER_HPP
+
+#include "zppsource.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+namespace slx
+{
+  //! Класс записи контейнера небольших записей
+  /*!
+     Записи сжимаются группами по GetGroupSize() штук, каждая группа -
+     отдельный поток deflate с общим предустановленным словарём.
+     В конце файла записывается таблица смещений групп и записей, поэтому
+     чтение записи распаковывает только начало её группы.
+
+     Формат (числа little endian):
+     заголовок "ZPPCONT1", версия, размер словаря, записей в группе,
+     словарь; сжатые группы; таблица: для каждой группы смещение (8 байт),
+     сжатый и несжатый размер (по 4 байта), для каждой записи смещение
+     её конца в группе (4 байта); концевик: смещение таблицы, количество
+     записей и групп (по 8 байт), "ZPPCEND1"
+   */
+  class ZppContainerWriter
+  {
+  public:
+    //! Конструктор
+    ZppContainerWriter() = default;
+
+    //! Конструктор
+    /*!
+       Открывает файл на запись
+     */
+    ZppContainerWriter
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Деструктор
+    ~ZppContainerWriter();
+
+    ZppContainerWriter(const ZppContainerWriter &) = delete;
+    ZppContainerWriter & operator = (const ZppContainerWriter &) = delete;
+
+    //! Открыть файл
+    /*!
+       Открывает файл на запись
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Закрыть файл
+    /*!
+       Сжимает последнюю группу и записывает таблицу смещений
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Close();
+
+    //! Добавить запись
+    /*!
+       \return Номер записи
+       \return <0 Ошибка
+     */
+    ssize_t Write
+    (
+        const uint8_t * i_data //!< [in] Данные записи
+      , const size_t i_size //!< [in] Размер записи
+    );
+
+    //! Добавить запись
+    /*!
+       \return Номер записи
+       \return <0 Ошибка
+     */
+    ssize_t Write
+    (
+        const std::vector<uint8_t> & i_data //!< [in] Данные записи
+    );
+
+    //! Получить количество записей
+    /*!
+      \return Количество записанных записей
+     */
+    size_t GetRecordCount();
+
+    //! Установить словарь
+    /*!
+       Действует при следующем открытии файла. Используются последние
+       32 КиБ словаря. Пустой словарь - без словаря
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт, словарь не изменён
+     */
+    int SetDictionary
+    (
+        const std::vector<uint8_t> & i_dictionary //!< [in] Словарь
+    );
+
+    //! Получить словарь
+    /*!
+      \return Словарь
+     */
+    const std::vector<uint8_t> & GetDictionary();
+
+    //! Получить количество записей в группе
+    /*!
+      \return Количество записей в группе
+     */
+    size_t GetGroupSize();
+
+    //! Установить количество записей в группе
+    /*!
+       Действует при следующем открытии файла
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт, значение не изменено
+       \return Z_STREAM_ERROR Количество равно 0
+     */
+    int SetGroupSize
+    (
+        size_t i_size //!< [in] Количество записей в группе, больше 0
+    );
+
+    //! Получить уровень сжатия
+    /*!
+      \return Уровень сжатия
+     */
+    int GetCompressionLevel();
+
+    //! Установить уровень сжатия
+    /*!
+     */
+    void SetCompressionLevel
+    (
+        int i_level //!< [in] Уровень сжатия
+    );
+
+    //! Получить статус готовности
+    /*!
+      \return Статус готовности
+     */
+    bool IsReady();
+
+    //! Построить словарь по образцам записей
+    /*!
+       Выбирает из образцов участки, чаще всего встречающиеся в разных
+       записях; самые полезные участки ставятся в конец словаря
+
+       \return Словарь размером не более i_size байт
+     */
+    static std::vector<uint8_t> TrainDictionary
+    (
+        const std::vector<std::vector<uint8_t>> & i_samples //!< [in] Образцы записей
+      , const size_t i_size = 32768 //!< [in] Размер словаря
+    );
+
+    //! Максимальный размер словаря
+    static const size_t MAX_DICTIONARY = 32768;
+
+  protected:
+    int compress_group();
+
+    FILE * m_file = nullptr;
+    bool m_flag_error = true;
+    int m_compression_level = Z_BEST_COMPRESSION;
+    size_t m_group_size = 64;
+    std::vector<uint8_t> m_dictionary;
+
+    z_stream m_stream = {};
+    std::vector<uint8_t> m_group;   //!< Данные текущей группы
+    std::vector<uint8_t> m_output;  //!< Сжатая группа
+    std::vector<uint8_t> m_table;   //!< Таблица групп
+    std::vector<uint32_t> m_ends;   //!< Концы записей в группах
+    uint64_t m_offset = 0;          //!< Смещение следующей группы
+  };
+
+  //! Класс чтения контейнера небольших записей
+  /*!
+     Таблица смещений загружается при открытии, запись читается
+     распаковкой начала её группы. Чтения из разных потоков допустимы
+   */
+  class ZppContainerReader
+  {
+  public:
+    //! Конструктор
+    ZppContainerReader() = default;
+
+    //! Конструктор
+    /*!
+       Открывает файл на чтение
+     */
+    ZppContainerReader
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Открыть файл
+    /*!
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Файл не является контейнером или повреждён
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Открыть контейнер из источника
+    /*!
+       Источник должен существовать, пока используется объект и сообщать
+       размер данных: идентификатор файла или отображение в память
+
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Данные не являются контейнером или повреждены
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppSource * i_source //!< [in] Источник данных
+    );
+
+    //! Закрыть файл
+    void Close();
+
+    //! Получить количество записей
+    /*!
+      \return Количество записей
+     */
+    size_t GetRecordCount();
+
+    //! Прочитать запись
+    /*!
+       \return Размер записи
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecord
+    (
+        const size_t i_index //!< [in] Номер записи
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будет записана запись
+    );
+
+    //! Прочитать записи подряд
+    /*!
+       Каждая группа распаковывается один раз
+
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecords
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_count //!< [in] Количество записей
+      , std::vector<std::vector<uint8_t>> & o_records //!< [out] Записи
+    );
+
+    //! Получить словарь
+    /*!
+      \return Словарь
+     */
+    const std::vector<uint8_t> & GetDictionary();
+
+    //! Получить статус готовности
+    /*!
+      \return Статус готовности
+     */
+    bool IsReady();
+
+  protected:
+    struct group
+    {
+      uint64_t offset;  //!< Смещение сжатых данных
+      uint32_t size;    //!< Сжатый размер
+      uint32_t length;  //!< Несжатый размер
+    };
+
+    int decode_group(size_t i_group, size_t i_length, std::vector<uint8_t> & o_data);
+
+    ZppSource * m_source = nullptr;
+    std::unique_ptr<ZppSource> m_own_source;
+    std::vector<uint8_t> m_dictionary;
+    size_t m_group_size = 0;
+    std::vector<group> m_groups;
+    std::vector<uint32_t> m_ends;
+  };
+}
+
+#endif // ZPPCONTAINER_HPP
@@ -7,13 +7,86 @@
 #include <fstream>
 #include <vector>
 #include <list>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
 #include <string.h>
 
 #include <zlib.h>
 
+#include "zppcache.hpp"
+#include "zppsink.hpp"
+#include "zppsource.hpp"
+#include "zppstatus.hpp"
+#include "zppthreadpool.hpp"
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
 namespace slx
 {
+  //! Формат сжатых данных
+  enum ZppFormat
+  {
+    ZPP_FORMAT_DEFLATE = 0, //!< zlib, GZip или независимые блоки GZip
+    ZPP_FORMAT_ZSTD = 1     //!< Кадры zstd с таблицей поиска (seekable format)
+  };
+
+  //! Порядок байт чисел в распакованных данных
+  enum ZppByteOrder
+  {
+    ZPP_ORDER_NATIVE = 0, //!< Порядок байт процессора
+    ZPP_ORDER_LITTLE = 1, //!< От младшего к старшему
+    ZPP_ORDER_BIG = 2     //!< От старшего к младшему
+  };
+
+  //! Описание участка файла для независимой распаковки
+  /*!
+     Участок распаковывается от точки доступа индекса: с её смещения
+     в сжатых данных и с её окном, затем пропускаются данные до begin.
+     Описание передаётся в другой процесс через Serialize() и открывается
+     ZppSplitReader без индекса всего файла
+   */
+  struct ZppSplit
+  {
+    ZppFileId file;                 //!< Идентификатор файла, сравнивается только размер, 0 - не проверяется
+    uint32_t check = 0;             //!< CRC-32 первых 4 КиБ сжатых данных от compressed_begin
+    int format = 0;                 //!< Вид индекса: поток deflate, блоки GZip или кадры zstd
+    int bits = 0;                   //!< Бит точки доступа в байте перед compressed_begin
+    uint64_t point = 0;             //!< Смещение точки доступа в несжатых данных
+    uint64_t begin = 0;             //!< Начало участка в несжатых данных, не меньше point
+    uint64_t end = 0;               //!< Конец участка в несжатых данных
+    uint64_t compressed_begin = 0;  //!< Смещение точки доступа в сжатых данных
+    uint64_t compressed_end = 0;    //!< Смещение первой точки доступа после участка в сжатых данных
+    std::vector<uint8_t> window;    //!< 32 КиБ несжатых данных перед точкой, пусто для блоков и zstd
+
+    //! Записать описание в байты
+    /*!
+      \return Описание в переносимом формате
+     */
+    std::vector<uint8_t> Serialize() const;
+
+    //! Прочитать описание из байт
+    /*!
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Данные не являются описанием участка
+     */
+    int Deserialize
+    (
+        const uint8_t * i_data //!< [in] Данные Serialize()
+      , const size_t i_size //!< [in] Размер данных
+    );
+  };
+
   //! Класс чтения файлов, сжатых zlib
+  /*!
+     Формат определяется при построении индекса: zlib, GZip, независимые
+     блоки ZppWriter или кадры zstd. Для zstd библиотека собирается
+     с ZPP_WITH_ZSTD (make ZSTD=1), иначе построение индекса вернёт
+     Z_VERSION_ERROR
+   */
   class ZppReader
   {
   public:
@@ -38,8 +111,53 @@ namespace slx
         FILE * i_file //!< [in] Дескриптор файла
     );
 
+    //! Конструктор
+    /*!
+       Открывает сжатые данные в памяти на чтение
+     */
+    ZppReader
+    (
+        const uint8_t * i_data //!< [in] Сжатые данные
+      , const size_t i_size //!< [in] Размер данных
+    );
+
+    //! Конструктор перемещения
+    /*!
+       Дожидается асинхронных чтений перемещаемого объекта
+     */
+    ZppReader
+    (
+        ZppReader && io_other //!< [in,out] Перемещаемый объект
+    );
+
     ~ZppReader();
 
+    ZppReader(const ZppReader &) = delete;
+    ZppReader & operator = (const ZppReader &) = delete;
+
+    //! Перемещение
+    /*!
+       Закрывает текущий файл и дожидается асинхронных чтений
+       перемещаемого объекта
+     */
+    ZppReader & operator =
+    (
+        ZppReader && io_other //!< [in,out] Перемещаемый объект
+    );
+
+    //! Создать копию объекта чтения
+    /*!
+       Копия использует тот же индекс без повторной распаковки, но свой
+       дескриптор файла и свою текущую позицию, поэтому её можно передать
+       другому потоку. Данные в памяти и источник, переданный в Open(),
+       используются совместно. Копия объекта, следящего за дописываемым
+       файлом (SetFlagFollow()), строит свой индекс по доступным данным
+       из того же источника, её Refresh() независим
+
+       \return Копия, IsReady() == false при ошибке или если файл изменился
+     */
+    ZppReader Clone();
+
     //! Открыть файл
     /*!
        Открывает файл на чтение
@@ -66,6 +184,35 @@ namespace slx
       , bool i_build_index = true //!< Флаг, создавать ли индекс при открытии
     );
 
+    //! Открыть данные в памяти
+    /*!
+       Открывает сжатые данные в памяти на чтение.
+       Данные не копируются и должны существовать до закрытия
+
+       \return Количество точек в индексе
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        const uint8_t * i_data //!< [in] Сжатые данные
+      , const size_t i_size //!< [in] Размер данных
+      , bool i_build_index = true //!< Флаг, создавать ли индекс при открытии
+    );
+
+    //! Открыть источник данных
+    /*!
+       Открывает на чтение пользовательский источник сжатых данных.
+       Источник не удаляется при закрытии и должен существовать до него
+
+       \return Количество точек в индексе
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppSource * i_source //!< [in] Источник данных
+      , bool i_build_index = true //!< Флаг, создавать ли индекс при открытии
+    );
+
     //! Закрыть файл
     void Close();
 
@@ -136,72 +283,597 @@ namespace slx
 
     //! Прочитать данные
     /*!
-       Чтение данных по смещению
-       Считывается i_count байт
+       Чтение данных по смещению
+       Считывается i_count байт
+
+       \return Количество считанных байт
+     */
+    ssize_t ReadOffset
+    (
+        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Прочитать данные асинхронно
+    /*!
+       Чтение данных по смещению в пуле потоков.
+       Считывается i_count байт.
+       Массив o_data должен существовать до завершения чтения.
+       Чтения одного объекта выполняются параллельно
+
+       \return Результат: количество считанных байт или код ошибки
+     */
+    std::future<ssize_t> ReadOffsetAsync
+    (
+        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const size_t i_offset //!< [in] Смещение
+      , const ZppCancel & i_cancel = ZppCancel() //!< [in] Признак отмены
+    );
+
+    //! Прочитать данные асинхронно
+    /*!
+       Чтение данных по смещению в пуле потоков.
+       Считывается i_count байт.
+       По завершении в рабочем потоке вызывается i_callback с количеством
+       считанных байт или кодом ошибки (ZPP_CANCELED, если чтение отменено
+       до начала). К моменту вызова объект уже не используется.
+       Массив o_data должен существовать до завершения чтения
+
+       \return Z_OK Чтение поставлено в очередь
+       \return ZPP_QUEUE_FULL Очередь заполнена, i_callback не будет вызван
+       \return <0 Ошибка
+     */
+    int ReadOffsetAsync
+    (
+        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const size_t i_offset //!< [in] Смещение
+      , std::function<void(ssize_t)> i_callback //!< [in] Обработчик завершения
+      , const ZppCancel & i_cancel = ZppCancel() //!< [in] Признак отмены
+    );
+
+    //! Прочитать несколько участков данных
+    /*!
+       Участки (смещение, количество байт) записываются в o_data подряд
+       в заданном порядке. Участки одного интервала между точками доступа
+       читаются одним проходом распаковки, разные интервалы распаковываются
+       параллельно в пуле потоков
+
+       \return Количество считанных байт
+       \return <0 Ошибка, в том числе если участок выходит за конец данных
+     */
+    ssize_t ReadOffsets
+    (
+        const std::vector<std::pair<size_t, size_t>> & i_ranges //!< [in] Участки: смещение и количество байт
+      , uint8_t * o_data //!< [out] Массив, в который будут записаны данные
+    );
+
+    //! Распаковать участок данных
+    /*!
+       Интервалы между точками доступа распаковываются параллельно в пуле
+       потоков прямо в o_data. Участок за концом данных обрезается
+
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressRange
+    (
+        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Распаковать участок данных в файл
+    /*!
+       Файл создаётся (перезаписывается) с размером участка, отображается
+       в память и заполняется параллельно. При ошибке файл удаляется
+
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressRange
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , const size_t i_count //!< [in] Количество байт
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Распаковать участок данных в дескриптор
+    /*!
+       Интервалы распаковываются параллельно группами и записываются
+       по порядку с текущей позиции, поэтому подходит и для каналов
+
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressRange
+    (
+        int i_fd //!< [in] Дескриптор для записи
+      , const size_t i_count //!< [in] Количество байт
+      , const size_t i_offset //!< [in] Смещение
+    );
+
+    //! Прочитать массив чисел
+    /*!
+       Интервалы между точками доступа распаковываются параллельно прямо
+       в o_data, порядок байт меняется сразу после распаковки интервала.
+       Неполный элемент в конце данных не считывается
+
+       \return Количество считанных элементов
+       \return <0 Ошибка
+     */
+    ssize_t ReadArray
+    (
+        void * o_data //!< [out] Массив, в который будут записаны элементы
+      , const size_t i_width //!< [in] Размер элемента: 1, 2, 4 или 8 байт
+      , const size_t i_count //!< [in] Количество элементов
+      , const size_t i_offset //!< [in] Смещение первого элемента в байтах
+      , const ZppByteOrder i_order //!< [in] Порядок байт в данных
+    );
+
+    //! Прочитать столбец чисел из записей
+    /*!
+       Считываются элементы по смещениям i_offset, i_offset + i_stride, ...
+       Интервалы между точками доступа распаковываются параллельно, из
+       каждого интервала элементы выбираются и меняют порядок байт сразу
+       после его распаковки. Элемент, не поместившийся в данные, не
+       считывается
+
+       \return Количество считанных элементов
+       \return <0 Ошибка
+     */
+    ssize_t ReadColumn
+    (
+        void * o_data //!< [out] Массив, в который будут записаны элементы
+      , const size_t i_width //!< [in] Размер элемента: 1, 2, 4 или 8 байт
+      , const size_t i_count //!< [in] Количество элементов
+      , const size_t i_offset //!< [in] Смещение первого элемента в байтах
+      , const size_t i_stride //!< [in] Расстояние между элементами в байтах, не меньше i_width
+      , const ZppByteOrder i_order //!< [in] Порядок байт в данных
+    );
+
+    //! Прочитать массив чисел
+    /*!
+       \return Количество считанных элементов
+       \return <0 Ошибка
+     */
+    template <class T>
+    ssize_t ReadArray
+    (
+        T * o_data //!< [out] Массив, в который будут записаны элементы
+      , const size_t i_count //!< [in] Количество элементов
+      , const size_t i_offset //!< [in] Смещение первого элемента в байтах
+      , const ZppByteOrder i_order = ZPP_ORDER_NATIVE //!< [in] Порядок байт в данных
+    );
+
+    //! Прочитать массив чисел
+    /*!
+       Вектор получает размер считанного массива
+
+       \return Количество считанных элементов
+       \return <0 Ошибка
+     */
+    template <class T>
+    ssize_t ReadArray
+    (
+        std::vector<T> & o_data //!< [out] Вектор, в который будут записаны элементы
+      , const size_t i_count //!< [in] Количество элементов
+      , const size_t i_offset //!< [in] Смещение первого элемента в байтах
+      , const ZppByteOrder i_order = ZPP_ORDER_NATIVE //!< [in] Порядок байт в данных
+    );
+
+    //! Распаковать все данные
+    /*!
+       Массив o_data должен вмещать GetSize() байт
+
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressAll
+    (
+        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
+    );
+
+    //! Распаковать все данные в файл
+    /*!
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressAll
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Распаковать все данные в дескриптор
+    /*!
+       \return Количество распакованных байт
+       \return <0 Ошибка
+     */
+    ssize_t DecompressAll
+    (
+        int i_fd //!< [in] Дескриптор для записи
+    );
+
+    //! Проверить целостность данных
+    /*!
+       Интервалы между точками доступа распаковываются параллельно
+       в пуле потоков, минуя кэш. Контрольные суммы интервалов (CRC32
+       для gzip, Adler-32 для zlib) объединяются и сравниваются с концевиком
+       потока вместе с размером данных. В файле из независимых блоков
+       проверяется концевик каждого блока.
+       При ошибке в o_offset и o_in записываются смещения начала первого
+       повреждённого интервала в распакованных и сжатых данных. Если
+       интервалы распаковались, но не совпала сумма всего потока,
+       записываются смещения концевика (o_offset равно GetSize())
+
+       \return Z_OK Данные целы
+       \return Z_DATA_ERROR Данные повреждены
+       \return <0 Ошибка чтения, индекс не построен или файл дописывается
+     */
+    int Verify
+    (
+        size_t & o_offset //!< [out] Смещение повреждённого участка в распакованных данных
+      , size_t & o_in //!< [out] Смещение повреждённого участка в сжатых данных
+    );
+
+    //! Проверить целостность данных
+    /*!
+       \return Z_OK Данные целы
+       \return Z_DATA_ERROR Данные повреждены
+       \return <0 Ошибка
+     */
+    int Verify();
+
+    //! Установить кэш распакованных участков
+    /*!
+       Кэш может разделяться несколькими объектами чтения. При чтении
+       через кэш участок между точками доступа распаковывается целиком.
+       Используется только для источников с идентификатором файла
+     */
+    void SetSpanCache
+    (
+        ZppSpanCache * i_cache //!< [in] Кэш, nullptr - без кэша
+    );
+
+    //! Установить политику ввода-вывода
+    /*!
+       Применяется к файлам, открываемым после вызова (по имени или
+       дескриптору). Если файловая система не поддерживает O_DIRECT,
+       вместо ZPP_IO_DIRECT используется ZPP_IO_STREAM.
+       См. ZppFileSource::SetIoPolicy()
+     */
+    void SetIoPolicy
+    (
+        ZppIoPolicy i_policy //!< [in] Политика
+    );
+
+    //! Получить политику ввода-вывода
+    /*!
+      \return Политика
+     */
+    ZppIoPolicy GetIoPolicy();
+
+    //! Установить пул потоков для асинхронного чтения
+    /*!
+     */
+    void SetThreadPool
+    (
+        ZppThreadPool * i_pool //!< [in] Пул потоков, nullptr - общий пул процесса
+    );
+
+    //! Найти последовательность байт
+    /*!
+       Участки между точками доступа распаковываются и просматриваются
+       параллельно в пуле потоков
+
+       \return 1 Последовательность найдена, o_offset - ее смещение
+       \return 0 Последовательность не найдена
+       \return <0 Ошибка
+     */
+    int Find
+    (
+        const std::vector<uint8_t> & i_pattern //!< [in] Искомая последовательность
+      , size_t & o_offset //!< [out] Смещение первого вхождения
+      , const size_t i_from = 0 //!< [in] Смещение начала поиска
+    );
+
+    //! Найти все вхождения последовательности байт
+    /*!
+       Участки между точками доступа распаковываются и просматриваются
+       параллельно в пуле потоков. Перекрывающиеся вхождения учитываются
+
+       \return Количество найденных вхождений
+       \return <0 Ошибка
+     */
+    ssize_t FindAll
+    (
+        const std::vector<uint8_t> & i_pattern //!< [in] Искомая последовательность
+      , std::vector<size_t> & o_offsets //!< [out] Смещения вхождений по возрастанию
+      , const size_t i_from = 0 //!< [in] Смещение начала поиска
+      , const size_t i_max = 0 //!< [in] Максимальное количество вхождений, 0 - без ограничений
+    );
+
+    //! Найти любой байт из набора
+    /*!
+       Участки между точками доступа распаковываются и просматриваются
+       параллельно в пуле потоков
+
+       \return 1 Байт найден, o_offset - его смещение
+       \return 0 Ни один байт из набора не найден
+       \return <0 Ошибка
+     */
+    int FindFirstOf
+    (
+        const std::vector<uint8_t> & i_set //!< [in] Набор искомых байт
+      , size_t & o_offset //!< [out] Смещение первого найденного байта
+      , const size_t i_from = 0 //!< [in] Смещение начала поиска
+    );
+
+    //! Построить индекс строк
+    /*!
+       Для текстовых файлов с разделителем строк '\n'.
+       Сохраняет смещение каждой i_step-й строки, участки между точками
+       доступа просматриваются параллельно в пуле потоков.
+       Требует построенного индекса
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int BuildLineIndex
+    (
+        const size_t i_step = 1024 //!< [in] Шаг контрольных точек в строках
+    );
+
+    //! Получить количество строк
+    /*!
+       Последняя строка без '\n' в конце тоже учитывается
+
+      \return Количество строк, 0 если индекс строк не построен
+     */
+    size_t GetLineCount();
+
+    //! Получить смещение начала строки
+    /*!
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int GetLineOffset
+    (
+        const size_t i_line //!< [in] Номер строки, начиная с 0
+      , size_t & o_offset //!< [out] Смещение начала строки
+    );
+
+    //! Прочитать строку
+    /*!
+       Строка считывается без '\n'
+
+       \return Длина строки
+       \return <0 Ошибка
+     */
+    ssize_t ReadLine
+    (
+        const size_t i_line //!< [in] Номер строки, начиная с 0
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будет записана строка
+    );
+
+    //! Прочитать строки
+    /*!
+       Строки считываются подряд вместе с разделителями '\n'
+
+       \return Количество считанных строк
+       \return <0 Ошибка
+     */
+    ssize_t ReadLines
+    (
+        const size_t i_first //!< [in] Номер первой строки, начиная с 0
+      , const size_t i_count //!< [in] Количество строк
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будут записаны строки
+    );
+
+    //! Установить текущую позицию
+    /*!
+
+     */
+    int SetPos
+    (
+        const size_t i_pos //!< [in] Позиция
+    );
+
+    //! Получить текущую позицию
+    /*!
+      \return Позиция
+     */
+    size_t GetPos();
+
+    //! Получить размер файла
+    /*!
+      \return Размер файла
+     */
+    size_t GetSize();
+
+    //! Получить интервал между точками доступа
+    /*!
+       Данные интервала распаковываются от одной точки доступа, поэтому
+       интервал - наименьшая единица чтения без лишней распаковки
+
+       \return Z_OK Успех
+       \return <0 Ошибка, в том числе если позиция за концом данных
+     */
+    int GetSpan
+    (
+        const size_t i_pos //!< [in] Позиция внутри интервала
+      , size_t & o_begin //!< [out] Начало интервала
+      , size_t & o_end //!< [out] Конец интервала
+    );
+
+    //! Установить размеры буфера
+    /*!
+     */
+    int SetBufferSize
+    (
+        const size_t i_size_backward //!< [in] Количество байт для кэширования до запрашиваемой позиции
+      , const size_t i_size_forward //!< [in] Количество байт для кэширования после запрашиваемой позиции
+    );
+
+    //! Получить размер буфера
+    /*!
+      \return Размер буфера
+     */
+    size_t GetBufferSize();
+
+    //! Получить значение флага выравнивания по границам считываемых данных
+    /*!
+      \return значение флага выравнивания по границам считываемых данных
+     */
+    bool GetFlagAllignBuffer();
+
+    //! Установить значение флага выравнивания по границам считываемых данных
+    /*!
+       Без выравнивания буфер operator [] сдвигается: перекрывающаяся часть
+       сохраняется, распаковывается только новая. Со смещением вперёд
+       распаковка продолжается с места остановки, поэтому побайтовый проход
+       распаковывает данные один раз. С выравниванием так же продолжается
+       переход к следующему интервалу. С кэшем участков (SetSpanCache())
+       данные берутся из кэша
+     */
+    void SetFlagAllignBuffer
+    (
+        bool i_flag //!< [in] Флаг выравнивания по границам считываемых данных
+    );
+
+    //! Построить индекс
+    /*!
+       Файлы из независимых блоков (см. ZppWriter::SetBlockSize())
+       индексируются по заголовкам блоков, без распаковки, файлы zstd -
+       по таблице поиска, а без неё распаковкой, с точкой доступа в начале
+       каждого кадра. Дописываемые файлы zstd не поддерживаются.
+       Индекс файла (кроме дописываемого) общий для всех объектов чтения
+       процесса, открывших тот же файл (устройство, inode, размер и время
+       изменения), и строится один раз
+     */
+    int BuildIndex();
+
+    //! Сохранить индекс в файл
+    /*!
+       Сохраняются точки доступа вместе с окнами, расстояние между ними
+       и размер и время изменения файла данных. Индекс дописываемого файла не сохраняется
 
-       \return Количество считанных байт
+       \return Z_OK Успех
+       \return <0 Ошибка
      */
-    ssize_t ReadOffset
+    int SaveIndex
     (
-        uint8_t * o_data  //!< [out] Массив, в который будут записаны данные
-      , const size_t i_count //!< [in] Количество байт для считывания
-      , const size_t i_offset //!< [in] Смещение
+        const std::string & i_filename //!< [in] Имя файла индекса
     );
 
-    //! Установить текущую позицию
+    //! Загрузить индекс из файла
     /*!
+       Заменяет построение индекса после Open() с i_build_index = false.
+       Размер и время изменения файла данных должны совпадать
+       с сохранёнными. Индекс становится общим для объектов чтения того же
+       файла с тем расстоянием между точками, с которым он был построен
 
+       \return Количество точек в индексе
+       \return Z_DATA_ERROR Файл индекса повреждён или не соответствует данным
+       \return <0 Ошибка
      */
-    int SetPos
+    int LoadIndex
     (
-        const size_t i_pos //!< [in] Позиция
+        const std::string & i_filename //!< [in] Имя файла индекса
     );
 
-    //! Получить текущую позицию
+    //! Разбить данные на участки для параллельной обработки
     /*!
-      \return Позиция
+       Границы выбираются среди точек доступа ближе всего к равным долям
+       несжатых данных, поэтому каждый участок распаковывается независимо
+       (ZppSplitReader). Границу можно сдвинуть вперёд до начала записи
+       или строки, тогда каждая запись или строка целиком попадает в один
+       участок. Участков может получиться меньше i_count, если мало точек
+       доступа. Индекс должен быть построен полностью
+
+       \return Количество участков
+       \return <0 Ошибка
      */
-    size_t GetPos();
+    ssize_t PlanSplits
+    (
+        const size_t i_count //!< [in] Желаемое количество участков
+      , std::vector<ZppSplit> & o_splits //!< [out] Участки по возрастанию смещения
+      , const size_t i_record_size = 0 //!< [in] Размер записи, границы кратны ему, 0 - без выравнивания
+      , const bool i_flag_lines = false //!< [in] Флаг выравнивания границ на начала строк
+    );
 
-    //! Получить размер файла
+    //! Получить значение флага слежения за дописываемым файлом
     /*!
-      \return Размер файла
+      \return Значение флага
      */
-    size_t GetSize();
+    bool GetFlagFollow();
 
-    //! Установить размеры буфера
+    //! Установить значение флага слежения за дописываемым файлом
     /*!
+       Применяется при построении индекса. В режиме слежения конец файла
+       до конца сжатого потока не считается ошибкой: индексируются доступные
+       данные, а состояние распаковки сохраняется для Refresh()
      */
-    int SetBufferSize
+    void SetFlagFollow
     (
-        const size_t i_size_backward //!< [in] Количество байт для кэширования до запрашиваемой позиции
-      , const size_t i_size_forward //!< [in] Количество байт для кэширования после запрашиваемой позиции
+        bool i_flag //!< [in] Флаг слежения за дописываемым файлом
     );
 
-    //! Получить размер буфера
+    //! Дополнить индекс данными, дописанными в файл
     /*!
-      \return Размер буфера
+       Распаковываются только новые сжатые данные, GetSize() увеличивается.
+       Не должен вызываться одновременно с чтением из этого объекта.
+       Индекс строк не обновляется
+
+       \return Количество новых байт несжатых данных
+       \return <0 Ошибка
      */
-    size_t GetBufferSize();
+    ssize_t Refresh();
 
-    //! Получить значение флага выравнивания по границам считываемых данных
+    //! Дождаться изменения файла
     /*!
-      \return значение флага выравнивания по границам считываемых данных
+       Для файлов, открытых по имени, использует inotify
+
+       \return 1 Файл изменился или содержит непрочитанные данные
+       \return 0 Истекло время ожидания
+       \return <0 Ошибка
      */
-    bool GetFlagAllignBuffer();
+    int WaitForData
+    (
+        const int i_timeout //!< [in] Время ожидания в миллисекундах, -1 - без ограничения
+    );
 
-    //! Установить значение флага выравнивания по границам считываемых данных
+    //! Получить признак конца сжатого потока
     /*!
+      \return true Индекс охватывает весь поток и дополняться не будет
      */
-    void SetFlagAllignBuffer
+    bool IsComplete();
+
+    //! Установить лимит памяти под окна индексов
+    /*!
+       Лимит общий для всех экземпляров ZppReader в процессе.
+       Окна точек доступа сверх лимита вытесняются во временный файл
+       и подгружаются обратно при чтении. В памяти остаются только смещения.
+       0 - без ограничений
+     */
+    static void SetIndexMemoryLimit
     (
-        bool i_flag //!< [in] Флаг выравнивания по границам считываемых данных
+        const size_t i_limit //!< [in] Лимит в байтах
     );
 
-    //! Построить индекс
+    //! Получить лимит памяти под окна индексов
     /*!
+      \return Лимит в байтах, 0 - без ограничений
      */
-    int BuildIndex();
+    static size_t GetIndexMemoryLimit();
+
+    //! Получить объем памяти, занятый окнами индексов
+    /*!
+      \return Объем в байтах для всех экземпляров ZppReader в процессе
+     */
+    static size_t GetIndexMemoryUsage();
 
     //! Получить имя файла
     /*!
@@ -229,13 +901,27 @@ namespace slx
     static const ssize_t WINSIZE = 32768U;        /* sliding window size */
     static const ssize_t CHUNK   = 16384;         /* file input buffer size */
 
+    struct access;
+
+    /* resident copy of an access point window, linked into the process-wide
+     LRU list of windows */
+    struct window
+    {
+      struct window *prev;    /* more recently used window */
+      struct window *next;    /* less recently used window */
+      struct access *index;   /* index owning the window */
+      int point;              /* number of the entry in index->list */
+      unsigned char data[WINSIZE];  /* preceding 32K of uncompressed data */
+    };
+
     /* access point entry */
     struct point
     {
       off_t out;          /* corresponding offset in uncompressed data */
       off_t in;           /* offset in input file of first full byte */
       int bits;           /* number of bits (1-7) from byte at in - 1, or 0 */
-      unsigned char window[WINSIZE];  /* preceding 32K of uncompressed data */
+      struct window *window;  /* resident window, NULL if evicted */
+      int spilled;        /* window has been written to the spill file */
     };
 
     /* access point list */
@@ -246,13 +932,31 @@ namespace slx
       struct point *list; /* allocated list */
       size_t compressed_size;
       size_t uncompressed_size;
+      FILE *spill;        /* file with evicted windows, NULL until first eviction */
+      int blocks;         /* independent gzip members (1) or zstd frames (2),
+                             points have no windows */
+      off_t span;         /* distance between access points it was built with */
+    };
+
+    /* process-wide list of resident windows and their memory budget */
+    struct window_lru
+    {
+      struct window *head;  /* most recently used window */
+      struct window *tail;  /* least recently used window */
+      size_t usage;         /* bytes held by resident windows */
+      size_t limit;         /* budget for resident windows, 0 - unlimited */
     };
 
+    static struct window_lru lru;
+
     /* Deallocate an index built by build_index() */
     static void free_index(struct access *index);
 
-    /* Add an entry to the access point list.  If out of memory, deallocate the
-     existing list and return NULL. */
+    /* Allocate an empty index.  Returns NULL if out of memory. */
+    static struct access *alloc_index();
+
+    /* Add an entry to the access point list, with no window if window is NULL.
+     If out of memory, deallocate the existing list and return NULL. */
     static struct access *addpoint(struct access *index, int bits,
                                    off_t in, off_t out, unsigned left, unsigned char *window);
 
@@ -264,7 +968,81 @@ namespace slx
      returns the number of access points on success (>= 1), Z_MEM_ERROR for out
      of memory, Z_DATA_ERROR for an error in the input file, or Z_ERRNO for a
      file read error.  On success, *built points to the resulting index. */
-    static int build_index(FILE *in, off_t span, struct access **built);
+    static int build_index(ZppSource *in, off_t span, struct access **built);
+
+    /* state of an index build, kept between calls of build_step() */
+    struct builder
+    {
+      z_stream strm;
+      off_t pos;          /* offset of the next input to read */
+      off_t totin, totout;  /* our own total counters to avoid 4GB limit */
+      off_t last;         /* totout value of last access point */
+      int blocks;         /* walk block headers instead of inflating, -1 unknown */
+      unsigned char input[CHUNK];
+      unsigned char window[WINSIZE];
+    };
+
+    /* Start an index build.  Returns Z_OK or an inflateInit2() error. */
+    static int build_begin(struct builder *state);
+
+    /* Continue an index build with the input from state->pos on, adding access
+     points to *built (allocated by the first point).  Returns Z_STREAM_END at
+     the end of the stream, Z_OK if follow is true and the input ended before
+     it, or an error as build_index(), including Z_DATA_ERROR for input ending
+     early otherwise.  The sizes in *built cover the data decoded so far. */
+    static int build_step(ZppSource *in, off_t span, struct access **built,
+                          struct builder *state, int follow);
+
+    /* Release the inflate state of an index build. */
+    static void build_end(struct builder *state);
+
+    /* Return 1 if the input starts with a gzip member carrying the block sizes
+     written by ZppWriter in block mode, 0 if not, or -1 if the input is too
+     short to tell. */
+    static int is_blocks(ZppSource *in);
+
+    /* Build or extend an index of a file made of independent gzip members by
+     walking their headers from *pos on, with one access point without a
+     window per non-empty member.  Returns Z_STREAM_END at the end of the
+     input, or if follow is true Z_STREAM_END after a final empty member and
+     Z_OK if the input ends before one; otherwise Z_DATA_ERROR for a member
+     without block sizes, Z_MEM_ERROR or Z_ERRNO. */
+    static int build_blocks(ZppSource *in, struct access **built, off_t *pos,
+                            int follow);
+
+    /* Return 1 if the input starts with a zstd frame or with the seek table
+     of a file without frames, 0 if not. */
+    static int is_zstd(ZppSource *in);
+
+    /* Build an index of a zstd file with one access point without a window
+     per non-empty frame, from the seek table at the end of the input if its
+     size is known and the table matches it, otherwise by decoding all frames.
+     Returns Z_STREAM_END, Z_DATA_ERROR, Z_MEM_ERROR, Z_ERRNO, or
+     Z_VERSION_ERROR if the library is built without zstd. */
+    static int build_zstd(ZppSource *in, struct access **built);
+
+    /* Provide the next piece of compressed input at offset pos in strm -- taken
+     directly from the source if it is in memory, otherwise read into input,
+     which holds CHUNK bytes.  Returns the number of bytes available, 0 at the
+     end of the input, or Z_ERRNO on a read error. */
+    static ssize_t fill_input(ZppSource *in, off_t pos, unsigned char *input,
+                              z_stream *strm);
+
+    /* Link a resident window at the head of the LRU list, then evict the least
+     recently used windows until the budget is met.  Must be called with the
+     window lock held. */
+    static void touch_window(struct window *win);
+
+    /* Write the window out to the spill file of its index (once per window) and
+     release its memory.  Must be called with the window lock held.  Returns
+     Z_OK, or Z_ERRNO if the spill file cannot be written, in which case the
+     window stays resident. */
+    static int evict_window(struct window *win);
+
+    /* Copy the window of access point number point into window, reading it back
+     from the spill file if it has been evicted.  Returns Z_OK, Z_MEM_ERROR or
+     Z_ERRNO. */
+    static int load_window(struct access *index, int point, unsigned char *window);
 
     /* Use the index to read len bytes from offset into buf, return bytes read or
      negative for error (Z_DATA_ERROR or Z_MEM_ERROR).  If data is requested past
@@ -273,29 +1051,271 @@ namespace slx
      should not return a data error unless the file was modified since the index
      was generated.  extract() may also return Z_ERRNO if there is an error on
      reading or seeking the input file. */
-    static int extract(FILE *in, struct access *index, off_t offset,
+    static int extract(ZppSource *in, struct access *index, off_t offset,
                        unsigned char *buf, int len);
 
+    /* sequential decoder state -- an inflate stream started at an access point
+     that keeps delivering data in order without going back to the index */
+    struct cursor
+    {
+      z_stream strm;
+      ZppSource *in;
+      off_t pos;          /* offset in input of the next compressed data */
+      off_t out;          /* offset in uncompressed data of the next byte */
+      int active;         /* strm is initialized */
+      int end;            /* end of stream reached */
+      int blocks;         /* continue with the next gzip member at its end */
+      struct ZSTD_DCtx_s *zstd;  /* decoder of zstd frames, NULL for deflate */
+      int idle;           /* no zstd frame is partly decoded */
+      unsigned char input[CHUNK];
+    };
+
+    /* Start a cursor at the access point preceding offset and skip to offset.
+     If offset is past the end of the data, the cursor stops at the end.
+     Returns Z_OK or an error as extract().  cursor_close() must be called in
+     any case. */
+    static int cursor_open(ZppSource *in, struct access *index, off_t offset,
+                           struct cursor *cur);
+
+    /* Read the next len bytes from the cursor into buf.  Returns the number of
+     bytes read, less than len only at the end of the data, or an error as
+     extract(). */
+    static int cursor_read(struct cursor *cur, unsigned char *buf, int len);
+
+    /* cursor_read() for zstd frames. */
+    static int cursor_read_zstd(struct cursor *cur, unsigned char *buf, int len);
+
+    /* Move the cursor forward to offset, or to the end of the data if offset is
+     past it.  Returns Z_OK or an error as extract(). */
+    static int cursor_skip(struct cursor *cur, off_t offset);
+
+    /* Return the number of the last access point at or before offset. */
+    static int find_point(struct access *index, off_t offset);
+
+    /* Release the inflate state of the cursor. */
+    static void cursor_close(struct cursor *cur);
+
     int PopulateBuffer
     (
         const size_t i_pos
     );
 
+    //! Разбить диапазон несжатых данных на участки между точками доступа
+    void GetSpans
+    (
+        size_t i_begin
+      , size_t i_end
+      , std::vector<std::pair<size_t, size_t>> & o_spans
+    );
+
+    //! Поиск последовательности или набора байт по участкам
+    ssize_t Search
+    (
+        const std::vector<uint8_t> & i_pattern
+      , bool i_flag_set
+      , size_t i_from
+      , size_t i_max
+      , std::vector<size_t> & o_offsets
+    );
+
+    ZppThreadPool & GetThreadPool();
+
+    //! Шаг построения индекса дописываемого файла
+    int BuildStep();
+
+    //! Дождаться завершения асинхронных чтений
+    void WaitAsync();
+
+    //! Применить политику ввода-вывода к открытому файлу
+    void ApplyIoPolicy(ZppFileSource * io_source);
+
+    //! Освободить индекс или отказаться от общего индекса
+    void ReleaseIndex();
+
+    /* Return the shared index of a file built with access points about every
+     span bytes, or nullptr if there is none. */
+    static std::shared_ptr<access> find_index(const ZppFileId & i_id, off_t i_span);
+
+    /* Make a complete index available to the other readers of the file that
+     use the same span. */
+    static void share_index(const ZppFileId & i_id, off_t i_span, const std::shared_ptr<access> & i_index);
+
+    //! Чтение по смещению через кэш распакованных участков
+    ssize_t ReadCached
+    (
+        uint8_t * o_data
+      , const size_t i_count
+      , const size_t i_offset
+    );
+
+    //! Найти начало строки и прочитать строки начиная с нее
+    ssize_t ScanLines
+    (
+        size_t i_first
+      , size_t i_count
+      , size_t & o_offset
+      , std::vector<uint8_t> * o_data
+    );
+
+    /* line index checkpoint */
+    struct line_point
+    {
+      size_t line;        /* number of newlines before offset */
+      size_t offset;      /* offset in uncompressed data, not always a line start */
+    };
+
     int PopulateBufferAlign
     (
         const size_t i_pos
     );
 
+    int fill_buffer
+    (
+        uint8_t * o_data
+      , const size_t i_count
+      , const size_t i_offset
+    );
+
+    void close_buffer_cursor();
+
     std::string m_filename;
-    FILE * m_file = nullptr;
+    ZppSource * m_source = nullptr;
+    std::shared_ptr<ZppSource> m_own_source;
     size_t m_cur_pos = 0;
     struct access * m_index = nullptr;
+    std::shared_ptr<access> m_index_owner; //!< Владелец полного индекса, общего с другими объектами
 
     size_t m_buffsize_backward = 0; //1048576L
     size_t m_buffsize_forward = 0;  //1048576L
     bool m_flag_align_buffer = true;
+    off_t m_span = SPAN;            //!< Расстояние между точками доступа нового индекса
     std::vector<uint8_t> m_buffer;
     size_t m_buffer_beg = 0;
+    std::unique_ptr<cursor> m_buffer_cursor; //!< Распаковка, продолжающая буфер вперёд
+
+    ZppThreadPool * m_pool = nullptr;
+    ZppSpanCache * m_cache = nullptr;
+    uint64_t m_file_key = 0;
+
+    bool m_flag_follow = false;
+    struct builder * m_builder = nullptr;
+    ZppIoPolicy m_io_policy = ZPP_IO_DEFAULT;
+
+    std::vector<line_point> m_lines;
+    size_t m_line_count = 0;
+    std::mutex m_async_mutex;
+    std::condition_variable m_async_cond;
+    size_t m_async_pending = 0;
+
+    friend struct ZppSplit;
+    friend class ZppSplitReader;
+  };
+
+  //! Класс последовательного чтения участка файла по описанию ZppSplit
+  /*!
+     Не строит индекс файла: распаковка начинается с точки доступа
+     из описания и продолжается до конца участка. Подходит для обработки
+     одного участка в отдельном процессе или на другой машине
+   */
+  class ZppSplitReader
+  {
+  public:
+    //! Конструктор
+    ZppSplitReader() = default;
+
+    //! Конструктор
+    /*!
+       Открывает участок файла
+     */
+    ZppSplitReader
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , const ZppSplit & i_split //!< [in] Описание участка
+    );
+
+    //! Деструктор
+    ~ZppSplitReader();
+
+    ZppSplitReader(const ZppSplitReader &) = delete;
+    ZppSplitReader & operator = (const ZppSplitReader &) = delete;
+
+    //! Открыть участок файла
+    /*!
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Файл не совпадает с описанным или повреждён
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , const ZppSplit & i_split //!< [in] Описание участка
+    );
+
+    //! Открыть участок из источника
+    /*!
+       Источник должен существовать, пока используется объект
+
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Данные не совпадают с описанными или повреждены
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppSource * i_source //!< [in] Источник сжатых данных
+      , const ZppSplit & i_split //!< [in] Описание участка
+    );
+
+    //! Закрыть участок
+    void Close();
+
+    //! Прочитать данные
+    /*!
+       Последовательное чтение до конца участка
+
+       \return Количество считанных байт, 0 в конце участка
+       \return <0 Ошибка
+     */
+    ssize_t Read
+    (
+        uint8_t * o_data //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+    );
+
+    //! Прочитать строку
+    /*!
+       Строка считывается без '\n'
+
+       \return Длина строки
+       \return ZPP_END Достигнут конец участка
+       \return <0 Ошибка
+     */
+    ssize_t ReadLine
+    (
+        std::vector<uint8_t> & o_line //!< [out] Вектор, в который будет записана строка
+    );
+
+    //! Получить текущую позицию
+    /*!
+      \return Смещение следующего байта в несжатых данных файла
+     */
+    size_t GetPos();
+
+    //! Получить статус готовности
+    /*!
+      \return Статус готовности
+     */
+    bool IsReady();
+
+  protected:
+    int fill();
+
+    ZppSource * m_source = nullptr;
+    std::unique_ptr<ZppSource> m_own_source;
+    std::unique_ptr<ZppReader::cursor> m_cursor;
+    size_t m_pos = 0;                 //!< Смещение следующего байта
+    size_t m_end = 0;                 //!< Конец участка
+    std::vector<uint8_t> m_buffer;    //!< Распакованные, но не выданные данные
+    size_t m_buffer_pos = 0;          //!< Начало невыданных данных в буфере
   };
 
   //! Класс записи файлов, со сжатием zlib
@@ -353,8 +1373,28 @@ namespace slx
         FILE * i_file //!< [in] Дескриптор файла
     );
 
+    //! Открыть приёмник
+    /*!
+       Сжатые данные передаются приёмнику. Приёмник должен существовать
+       до Close(), объект им не владеет. Политика ввода-вывода действует
+       только для файлов
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppSink * i_sink //!< [in] Приёмник сжатых данных
+    );
+
     //! Закрыть файл
-    void Close();
+    /*!
+       Завершает сжатие и сбрасывает данные в приёмник
+
+       \return Z_OK Успех
+       \return <0 Ошибка сжатия или записи
+     */
+    int Close();
 
     //! Записать данные
     /*!
@@ -385,6 +1425,49 @@ namespace slx
      */
     size_t GetSize();
 
+    //! Усыпить объект записи
+    /*!
+       Сжатые данные дописываются до границы байта (поток deflate) или
+       блока, состояние сжатия и буферы освобождаются, файл, открытый по
+       имени, закрывается. Поток deflate сбрасывается полностью
+       (Z_FULL_FLUSH), поэтому в памяти не остаётся ни окна, ни буферов,
+       а сжатие после пробуждения не ссылается на прежние данные.
+       Write() и Close() будят объект сами. Формат, флаг GZip, размер
+       блока и уровень сжатия до Close() не меняются, поэтому поток
+       после пробуждения продолжается с теми же настройками
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Hibernate();
+
+    //! Разбудить объект записи
+    /*!
+       Файл открывается заново на дозапись, поток продолжается, поэтому
+       результат - тот же один поток GZip или zlib. Файл, размер которого
+       не совпадает с записанным (подменён или усечён), не дописывается
+
+       \return Z_OK Успех
+       \return Z_DATA_ERROR Файл изменён, пока объект спал
+       \return <0 Ошибка
+     */
+    int Resume();
+
+    //! Проверить, усыплён ли объект записи
+    /*!
+      \return true Объект усыплён Hibernate()
+     */
+    bool IsHibernated();
+
+    //! Получить объём памяти состояния сжатия
+    /*!
+       Оценка памяти состояний deflate или zstd и буферов, у усыплённого
+       объекта - 0
+
+      \return Количество байт
+     */
+    size_t GetMemoryUsage();
+
     //! Получить значения флага совместимости с GZip
     /*!
       \return Значение флага
@@ -393,8 +1476,12 @@ namespace slx
 
     //! Установить значения флага совместимости с GZip
     /*!
+       Действует при следующем открытии файла
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт или объект усыплён, значение не изменено
      */
-    void SetFlagGzip
+    int SetFlagGzip
     (
         bool i_flag //!< [in] Значения флага совместимости с GZip
     );
@@ -407,8 +1494,12 @@ namespace slx
 
     //! Установить уровень сжатия
     /*!
+       Действует при следующем открытии файла
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт или объект усыплён, значение не изменено
      */
-    void SetCompressionLevel
+    int SetCompressionLevel
     (
         int i_level //!< [in] Уровень сжатия
     );
@@ -427,6 +1518,82 @@ namespace slx
         size_t i_size //!< [in] Размер блока данных
     );
 
+    //! Получить размер независимого блока
+    /*!
+      \return Размер блока несжатых данных, 0 - обычный поток
+     */
+    size_t GetBlockSize();
+
+    //! Установить размер независимого блока
+    /*!
+       Если размер не 0, данные сжимаются независимыми блоками, каждый
+       из которых - отдельный член gzip с размерами блока в поле extra
+       заголовка. Файл остаётся совместимым с gunzip, а ZppReader строит
+       индекс по заголовкам без распаковки. Требует флага совместимости
+       с GZip, иначе Open() вернёт Z_STREAM_ERROR. Действует при следующем
+       открытии файла
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт или объект усыплён, значение не изменено
+     */
+    int SetBlockSize
+    (
+        size_t i_size //!< [in] Размер блока несжатых данных, не более MAX_BLOCK_SIZE
+    );
+
+    //! Установить пул потоков для сжатия блоков
+    /*!
+       В режиме независимых блоков группа заполненных блоков сжимается
+       параллельно в пуле и записывается по порядку. Действует при
+       следующем открытии файла
+     */
+    void SetThreadPool
+    (
+        ZppThreadPool * i_pool //!< [in] Пул потоков, nullptr - сжатие в вызывающем потоке
+    );
+
+    //! Получить формат сжатия
+    /*!
+      \return Формат
+     */
+    ZppFormat GetFormat();
+
+    //! Установить формат сжатия
+    /*!
+       ZPP_FORMAT_ZSTD - кадры zstd по GetBlockSize() байт (0 - 1 МиБ)
+       с таблицей поиска в конце файла, в формате seekable zstd. Кадры
+       сжимаются в пуле SetThreadPool(), уровень сжатия передаётся zstd,
+       Z_DEFAULT_COMPRESSION - уровень zstd по умолчанию, флаг GZip не
+       используется. Если библиотека собрана без zstd, Open() вернёт
+       Z_VERSION_ERROR. Действует при следующем открытии файла
+
+       \return Z_OK Успех
+       \return Z_ERRNO Файл открыт или объект усыплён, значение не изменено
+     */
+    int SetFormat
+    (
+        ZppFormat i_format //!< [in] Формат
+    );
+
+    //! Установить политику ввода-вывода
+    /*!
+       При ZPP_IO_STREAM записанные данные периодически сбрасываются на
+       диск и вытесняются из страничного кэша, чтобы запись большого файла
+       не вытесняла чужие данные. Запись идёт через буфер stdio, поэтому
+       ZPP_IO_DIRECT действует как ZPP_IO_STREAM. Действует при следующем
+       открытии файла
+     */
+    void SetIoPolicy
+    (
+        ZppIoPolicy i_policy //!< [in] Политика
+    );
+
+    //! Получить политику ввода-вывода
+    /*!
+      \return Политика
+     */
+    ZppIoPolicy GetIoPolicy();
+
     //! Получить имя файла
     /*!
       \return Имя файла
@@ -439,6 +1606,9 @@ namespace slx
      */
     bool IsReady();
 
+    //! Максимальный размер независимого блока
+    static const size_t MAX_BLOCK_SIZE = 1 << 30;
+
   protected:
     int InitZLib();
 
@@ -446,8 +1616,23 @@ namespace slx
 
     int compress(const uint8_t * i_data, size_t i_size);
 
+    int compress_blocks();
+
+    void fail();
+
+    void drop_written();
+
+    int write_seek_table();
+
+    void next_output();
+
+    int write_output(bool i_more);
+
     std::vector<uint8_t> m_buffer;
     FILE * m_file = nullptr;
+    ZppSink * m_sink = nullptr;
+    std::unique_ptr<ZppSink> m_own_sink;              //!< Приёмник открытого объектом файла
+    uint8_t * m_output = nullptr;                     //!< Начало текущего участка вывода
     std::string m_filename;
     int m_compression_level = Z_BEST_COMPRESSION;
     size_t m_chunk_size = 4096;
@@ -456,7 +1641,48 @@ namespace slx
     bool m_flag_error = true;
 
     z_stream m_stream = {};
+
+    size_t m_block_size = 0;
+    ZppThreadPool * m_pool = nullptr;
+    std::vector<z_stream> m_block_streams;            //!< Состояния сжатия блоков группы
+    std::vector<std::vector<uint8_t>> m_blocks;       //!< Данные блоков группы
+    std::vector<std::vector<uint8_t>> m_block_output; //!< Сжатые блоки группы
+    size_t m_block_count = 0;                         //!< Занятые блоки группы
+    size_t m_total_out = 0;
+
+    ZppIoPolicy m_io_policy = ZPP_IO_DEFAULT;
+    off_t m_drop_from = -1;                           //!< Начало ещё не вытесненных данных
+
+    ZppFormat m_format = ZPP_FORMAT_DEFLATE;
+    size_t m_open_block = 0;                          //!< Размер блока открытого файла, 0 - один поток
+    std::vector<ZSTD_CCtx_s *> m_zstd_streams;        //!< Состояния сжатия кадров группы
+    std::vector<uint32_t> m_frames;                   //!< Сжатый и несжатый размеры записанных кадров
+
+    bool m_flag_hibernated = false;                   //!< Объект усыплён, состояние сжатия освобождено
+    bool m_flag_resumed = false;                      //!< Поток продолжен без заголовка, концовка пишется вручную
+    uLong m_check = 0;                                //!< CRC-32 или Adler-32 всех данных продолженного потока
+    size_t m_resumed_in = 0;                          //!< Несжатых байт до текущего состояния сжатия
+    size_t m_resumed_out = 0;                         //!< Сжатых байт до текущего состояния сжатия
   };
+
+  template <class T>
+  ssize_t ZppReader::ReadArray(T * o_data, const size_t i_count, const size_t i_offset, const ZppByteOrder i_order)
+  {
+    static_assert(std::is_arithmetic<T>::value, "the elements must be numbers");
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "unsupported element size");
+
+    return ReadArray(static_cast<void *>(o_data), sizeof(T), i_count, i_offset, i_order);
+  }
+
+  template <class T>
+  ssize_t ZppReader::ReadArray(std::vector<T> & o_data, const size_t i_count, const size_t i_offset, const ZppByteOrder i_order)
+  {
+    o_data.resize(i_count);
+    ssize_t ret_val = ReadArray(o_data.data(), i_count, i_offset, i_order);
+    o_data.resize(ret_val > 0 ? static_cast<size_t>(ret_val) : 0);
+
+    return ret_val;
+  }
 }
 
 #endif // ZPPLIB_HPP
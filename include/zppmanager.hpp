@@ -0,0 +1,135 @@
+#ifndef ZPPMANAGER_HPP
+#define ZPPMANAGER_HPP
+
+#include "zpplib.hpp"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace slx
+{
+  //! Набор объектов записи с ограничением памяти
+  /*!
+     Объекты записи, в которые давно не писали, усыпляются
+     (ZppWriter::Hibernate()), пока память активных объектов превышает
+     лимит. Запись через Write() будит объект, поэтому открытыми могут
+     оставаться десятки тысяч файлов, а память определяется только
+     активными. Набор не владеет объектами: они закрываются вызывающим
+     после Remove(). Методы можно вызывать из разных потоков. Запись
+     выполняется вне блокировки набора, поэтому в разные объекты пишут
+     параллельно; объект, в который идёт запись, не усыпляется. Один
+     объект не должен писаться из нескольких потоков одновременно
+   */
+  class ZppWriterManager
+  {
+  public:
+    //! Конструктор
+    ZppWriterManager
+    (
+        const size_t i_limit //!< [in] Лимит памяти активных объектов в байтах
+    );
+
+    ZppWriterManager(const ZppWriterManager &) = delete;
+    ZppWriterManager & operator = (const ZppWriterManager &) = delete;
+
+    //! Добавить объект записи
+    /*!
+       Объект должен быть открыт. Добавленный объект считается последним
+       использованным
+
+       \return Z_OK Успех
+       \return Z_ERRNO Объект не открыт или уже добавлен
+     */
+    int Add
+    (
+        ZppWriter * i_writer //!< [in] Объект записи
+    );
+
+    //! Исключить объект записи из набора
+    /*!
+       Объект остаётся в том же состоянии, усыплённый будится при записи
+       или закрытии
+     */
+    void Remove
+    (
+        ZppWriter * i_writer //!< [in] Объект записи
+    );
+
+    //! Записать данные
+    /*!
+       Усыплённый объект будится, затем давно не использованные объекты
+       усыпляются до лимита памяти. Ошибка усыпления другого объекта
+       не возвращается, она переводит тот объект в состояние ошибки
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Write
+    (
+        ZppWriter * i_writer //!< [in] Объект записи из набора
+      , const uint8_t * i_data //!< [in] Массив с данными для записи
+      , size_t i_size //!< [in] Количество байт для записи
+    );
+
+    //! Усыпить объекты до лимита памяти
+    /*!
+       \return Z_OK Успех
+       \return <0 Ошибка усыпления одного из объектов
+     */
+    int Trim();
+
+    //! Установить лимит памяти
+    void SetLimit
+    (
+        const size_t i_limit //!< [in] Лимит памяти активных объектов в байтах
+    );
+
+    //! Получить лимит памяти
+    /*!
+      \return Лимит памяти в байтах
+     */
+    size_t GetLimit();
+
+    //! Получить объём памяти активных объектов
+    /*!
+       Объём каждого объекта учитывается при добавлении и после каждой
+       записи через Write()
+
+      \return Объём в байтах, см. ZppWriter::GetMemoryUsage()
+     */
+    size_t GetUsage();
+
+    //! Получить количество объектов
+    /*!
+      \return Количество объектов в наборе
+     */
+    size_t GetCount();
+
+    //! Получить количество активных объектов
+    /*!
+      \return Количество объектов, не усыплённых набором
+     */
+    size_t GetActiveCount();
+
+  protected:
+    typedef std::list<ZppWriter *> WriterList;
+
+    struct Entry
+    {
+      WriterList::iterator position; //!< Усыплённые - m_active.end()
+      size_t usage = 0; //!< Объём памяти после последней записи
+      int pins = 0; //!< Количество незавершённых записей
+    };
+
+    int trim(ZppWriter * i_keep);
+
+    WriterList m_active; //!< Активные объекты, начиная с последнего использованного
+    std::unordered_map<ZppWriter *, Entry> m_map;
+    size_t m_limit = 0;
+    size_t m_usage = 0; //!< Объём памяти активных объектов
+    std::mutex m_mutex;
+  };
+}
+
+#endif // ZPPMANAGER_HPP
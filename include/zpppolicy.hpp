@@ -0,0 +1,375 @@
+#ifndef ZPPPOLICY_HPP
+#define ZPPPOLICY_HPP
+
+#include "zpplib.hpp"
+
+#include <mutex>
+#include <type_traits>
+
+namespace slx
+{
+  //! Способ буферизации operator []
+  enum ZppBuffering
+  {
+    ZPP_BUFFER_DYNAMIC = 0, //!< Выбирается SetFlagAlignBuffer() во время работы
+    ZPP_BUFFER_ALIGN = 1,   //!< Буфер - участок между соседними точками доступа
+    ZPP_BUFFER_WINDOW = 2   //!< Буфер - окно SetBufferSize() вокруг позиции
+  };
+
+  //! Мьютекс без блокировки для объектов, используемых одним потоком
+  struct ZppNullMutex
+  {
+    void lock() {}
+    void unlock() {}
+  };
+
+  //! Политика чтения по умолчанию, совпадает с поведением ZppReader
+  struct ZppReaderPolicy
+  {
+    //! Расстояние между точками доступа в несжатых данных
+    static constexpr off_t SPAN = 1048576L;
+    //! Способ буферизации operator []
+    static constexpr ZppBuffering BUFFERING = ZPP_BUFFER_DYNAMIC;
+    //! Байт до позиции в буфере ZPP_BUFFER_WINDOW
+    static constexpr size_t BUFFER_BACKWARD = 0;
+    //! Байт после позиции в буфере ZPP_BUFFER_WINDOW
+    static constexpr size_t BUFFER_FORWARD = 0;
+    //! Допустим вызов operator [] из нескольких потоков
+    static constexpr bool THREAD_SAFE = false;
+  };
+
+  //! Плотный индекс: быстрый произвольный доступ ценой памяти индекса
+  struct ZppDensePolicy : ZppReaderPolicy
+  {
+    static constexpr off_t SPAN = 262144L;
+    static constexpr ZppBuffering BUFFERING = ZPP_BUFFER_ALIGN;
+  };
+
+  //! Редкий индекс: мало памяти, operator [] распаковывает окно после позиции
+  struct ZppSparsePolicy : ZppReaderPolicy
+  {
+    static constexpr off_t SPAN = 4194304L;
+    static constexpr ZppBuffering BUFFERING = ZPP_BUFFER_WINDOW;
+    static constexpr size_t BUFFER_FORWARD = 1048575;
+  };
+
+  //! Класс чтения с параметрами, заданными при компиляции
+  /*!
+     Политика задаёт расстояние между точками доступа строящегося индекса,
+     буферизацию и потокобезопасность operator []. Без ветвлений во время
+     работы собирается только operator []: выбор буферизации выполняется
+     при компиляции, поэтому SetFlagAlignBuffer() действует только при
+     ZPP_BUFFER_DYNAMIC. SPAN лишь задаёт начальное значение расстояния,
+     индекс строится общим кодом ZppReader с этим значением во время
+     работы. Индекс файла используется совместно только читателями
+     с тем же SPAN.
+
+     Объект можно передавать как ZppReader *, но тогда operator []
+     вызывается в варианте ZppReader
+   */
+  template <class Policy = ZppReaderPolicy>
+  class BasicZppReader : public ZppReader
+  {
+    static_assert(Policy::SPAN >= WINSIZE, "the span must exceed the window size");
+
+  public:
+    //! Конструктор
+    BasicZppReader();
+
+    //! Конструктор
+    /*!
+       Открывает файл на чтение
+     */
+    BasicZppReader
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Конструктор
+    /*!
+       Открывает файл на чтение
+     */
+    BasicZppReader
+    (
+        FILE * i_file //!< [in] Дескриптор файла
+    );
+
+    //! Конструктор
+    /*!
+       Открывает сжатые данные в памяти на чтение
+     */
+    BasicZppReader
+    (
+        const uint8_t * i_data //!< [in] Сжатые данные
+      , const size_t i_size //!< [in] Размер данных
+    );
+
+    //! Конструктор перемещения
+    BasicZppReader
+    (
+        BasicZppReader && io_other //!< [in,out] Перемещаемый объект
+    );
+
+    //! Перемещение
+    BasicZppReader & operator =
+    (
+        BasicZppReader && io_other //!< [in,out] Перемещаемый объект
+    );
+
+    //! Создать копию объекта чтения
+    /*!
+       См. ZppReader::Clone()
+
+       \return Копия, IsReady() == false при ошибке или если файл изменился
+     */
+    BasicZppReader Clone();
+
+    //! Вернуть байт по индексу
+    /*!
+      \return значния байта
+      \return 0x00 в случае ошибки
+     */
+    uint8_t operator [] (const size_t i_pos);
+
+  protected:
+    typedef typename std::conditional<Policy::THREAD_SAFE, std::mutex, ZppNullMutex>::type mutex_type;
+
+    mutex_type m_policy_mutex;
+  };
+
+  //! Читатель с плотным индексом
+  typedef BasicZppReader<ZppDensePolicy> ZppDenseReader;
+
+  //! Читатель с редким индексом
+  typedef BasicZppReader<ZppSparsePolicy> ZppSparseReader;
+
+  //! Политика записи по умолчанию, совпадает с настройками ZppWriter
+  struct ZppWriterPolicy
+  {
+    //! Уровень сжатия
+    static constexpr int LEVEL = Z_BEST_COMPRESSION;
+    //! Размер буфера сжатых данных
+    static constexpr size_t CHUNK_SIZE = 4096;
+    //! Совместимость с GZip
+    static constexpr bool GZIP = true;
+    //! Размер независимого блока, 0 - один поток deflate
+    static constexpr size_t BLOCK_SIZE = 0;
+    //! Допустим вызов Write() из нескольких потоков
+    static constexpr bool THREAD_SAFE = false;
+  };
+
+  //! Запись независимыми блоками для быстрого индексирования и чтения
+  struct ZppBlockWriterPolicy : ZppWriterPolicy
+  {
+    static constexpr int LEVEL = Z_DEFAULT_COMPRESSION;
+    static constexpr size_t CHUNK_SIZE = 65536;
+    static constexpr size_t BLOCK_SIZE = 1048576;
+  };
+
+  //! Класс записи с параметрами, заданными при компиляции
+  /*!
+     Политика задаёт начальные настройки сжатия, их можно изменить до
+     следующего открытия файла, и потокобезопасность Write()
+   */
+  template <class Policy = ZppWriterPolicy>
+  class BasicZppWriter : public ZppWriter
+  {
+    static_assert(Policy::BLOCK_SIZE == 0 || Policy::GZIP == true, "blocks are gzip members");
+    static_assert(Policy::BLOCK_SIZE <= MAX_BLOCK_SIZE, "the block size is too large");
+
+  public:
+    //! Конструктор
+    BasicZppWriter();
+
+    //! Конструктор
+    /*!
+       Открывает файл на запись
+     */
+    BasicZppWriter
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Конструктор
+    /*!
+       Открывает файл на запись
+     */
+    BasicZppWriter
+    (
+        FILE * i_file //!< [in] Дескриптор файла
+    );
+
+    //! Закрыть файл
+    /*!
+      \return Результат ZppWriter::Close()
+     */
+    int Close();
+
+    //! Записать данные
+    /*!
+       Записывается i_data.size() байт
+
+       \return Количество записанных байт
+     */
+    int Write
+    (
+        const std::vector<uint8_t> & i_data //!< [in] Вектор с данными для записи
+    );
+
+    //! Записать данные
+    /*!
+       Записывается i_size байт
+
+       \return Количество записанных байт
+     */
+    int Write
+    (
+        const uint8_t * i_data //!< [in] Данные для записи
+      , size_t i_size //!< [in] Количество байт для записи
+    );
+
+  protected:
+    typedef typename std::conditional<Policy::THREAD_SAFE, std::mutex, ZppNullMutex>::type mutex_type;
+
+    mutex_type m_policy_mutex;
+  };
+
+  //! Запись независимыми блоками
+  typedef BasicZppWriter<ZppBlockWriterPolicy> ZppBlockWriter;
+
+  template <class Policy>
+  BasicZppReader<Policy>::BasicZppReader()
+  {
+    m_span = Policy::SPAN;
+    m_buffsize_backward = Policy::BUFFER_BACKWARD;
+    m_buffsize_forward = Policy::BUFFER_FORWARD;
+    m_flag_align_buffer = Policy::BUFFERING != ZPP_BUFFER_WINDOW;
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy>::BasicZppReader(const std::string & i_filename)
+    : BasicZppReader()
+  {
+    Open(i_filename);
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy>::BasicZppReader(FILE * i_file)
+    : BasicZppReader()
+  {
+    Open(i_file);
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy>::BasicZppReader(const uint8_t * i_data, const size_t i_size)
+    : BasicZppReader()
+  {
+    Open(i_data, i_size);
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy>::BasicZppReader(BasicZppReader && io_other)
+    : ZppReader(std::move(io_other))
+  {
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy> & BasicZppReader<Policy>::operator = (BasicZppReader && io_other)
+  {
+    ZppReader::operator = (std::move(io_other));
+    return *this;
+  }
+
+  template <class Policy>
+  BasicZppReader<Policy> BasicZppReader<Policy>::Clone()
+  {
+    BasicZppReader clone;
+    static_cast<ZppReader &>(clone) = ZppReader::Clone();
+    return clone;
+  }
+
+  template <class Policy>
+  uint8_t BasicZppReader<Policy>::operator [](const size_t i_pos)
+  {
+    std::lock_guard<mutex_type> lock(m_policy_mutex);
+
+    if constexpr (Policy::BUFFERING == ZPP_BUFFER_DYNAMIC)
+    {
+      return ZppReader::operator [](i_pos);
+    }
+
+    /* the buffer is empty while no file is open */
+    if (i_pos - m_buffer_beg < m_buffer.size())
+    {
+      return m_buffer[i_pos - m_buffer_beg];
+    }
+
+    if (m_index == nullptr || m_source == nullptr || i_pos >= m_index->uncompressed_size)
+    {
+      return 0x00;
+    }
+
+    int ret;
+    if constexpr (Policy::BUFFERING == ZPP_BUFFER_ALIGN)
+    {
+      ret = PopulateBufferAlign(i_pos);
+    }
+    else
+    {
+      ret = PopulateBuffer(i_pos);
+    }
+
+    if (ret != Z_OK || i_pos - m_buffer_beg >= m_buffer.size())
+    {
+      return 0x00;
+    }
+
+    return m_buffer[i_pos - m_buffer_beg];
+  }
+
+  template <class Policy>
+  BasicZppWriter<Policy>::BasicZppWriter()
+  {
+    SetCompressionLevel(Policy::LEVEL);
+    SetChunkSize(Policy::CHUNK_SIZE);
+    SetFlagGzip(Policy::GZIP);
+    SetBlockSize(Policy::BLOCK_SIZE);
+  }
+
+  template <class Policy>
+  BasicZppWriter<Policy>::BasicZppWriter(const std::string & i_filename)
+    : BasicZppWriter()
+  {
+    Open(i_filename);
+  }
+
+  template <class Policy>
+  BasicZppWriter<Policy>::BasicZppWriter(FILE * i_file)
+    : BasicZppWriter()
+  {
+    Open(i_file);
+  }
+
+  template <class Policy>
+  int BasicZppWriter<Policy>::Close()
+  {
+    std::lock_guard<mutex_type> lock(m_policy_mutex);
+    return ZppWriter::Close();
+  }
+
+  template <class Policy>
+  int BasicZppWriter<Policy>::Write(const std::vector<uint8_t> & i_data)
+  {
+    std::lock_guard<mutex_type> lock(m_policy_mutex);
+    return ZppWriter::Write(i_data);
+  }
+
+  template <class Policy>
+  int BasicZppWriter<Policy>::Write(const uint8_t * i_data, size_t i_size)
+  {
+    std::lock_guard<mutex_type> lock(m_policy_mutex);
+    return ZppWriter::Write(i_data, i_size);
+  }
+}
+
+#endif // ZPPPOLICY_HPP
@@ -0,0 +1,178 @@
+#ifndef ZPPRECORD_HPP
+#define ZPPRECORD_HPP
+
+#include "zpplib.hpp"
+
+namespace slx
+{
+  //! Класс чтения записей фиксированного размера из файлов, сжатых zlib
+  /*!
+     Работает поверх открытого ZppReader с построенным индексом.
+     Пакетное чтение распаковывает каждый интервал между точками доступа
+     не более одного раза, интервалы распаковываются параллельно
+   */
+  class ZppRecordReader
+  {
+  public:
+    //! Конструктор
+    ZppRecordReader() = default;
+
+    //! Конструктор
+    ZppRecordReader
+    (
+        ZppReader * i_reader //!< [in] Объект чтения сжатого файла
+      , const size_t i_record_size //!< [in] Размер записи в байтах
+    );
+
+    //! Задать объект чтения и размер записи
+    /*!
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppReader * i_reader //!< [in] Объект чтения сжатого файла
+      , const size_t i_record_size //!< [in] Размер записи в байтах
+    );
+
+    //! Получить размер записи
+    /*!
+      \return Размер записи в байтах
+     */
+    size_t GetRecordSize();
+
+    //! Получить количество записей
+    /*!
+       Неполная запись в конце данных не учитывается
+
+      \return Количество записей
+     */
+    size_t GetRecordCount();
+
+    //! Прочитать запись
+    /*!
+       Считывается GetRecordSize() байт
+
+       \return Количество считанных байт
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecord
+    (
+        const size_t i_index //!< [in] Номер записи
+      , uint8_t * o_data //!< [out] Массив, в который будет записана запись
+    );
+
+    //! Прочитать запись
+    /*!
+       \return Количество считанных байт
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecord
+    (
+        const size_t i_index //!< [in] Номер записи
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будет записана запись
+    );
+
+    //! Прочитать записи подряд
+    /*!
+       Считывается i_count * GetRecordSize() байт
+
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecords
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_count //!< [in] Количество записей
+      , uint8_t * o_data //!< [out] Массив, в который будут записаны записи
+    );
+
+    //! Прочитать записи подряд
+    /*!
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecords
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_count //!< [in] Количество записей
+      , std::vector<uint8_t> & o_data //!< [out] Вектор, в который будут записаны записи
+    );
+
+    //! Прочитать записи с шагом
+    /*!
+       Считываются записи i_first, i_first + i_stride, ...
+
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecordsStrided
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_stride //!< [in] Шаг в записях
+      , const size_t i_count //!< [in] Количество записей
+      , uint8_t * o_data //!< [out] Массив, в который будут записаны записи
+    );
+
+    //! Прочитать записи по списку номеров
+    /*!
+       Записи записываются в o_data в порядке i_indices
+
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadRecords
+    (
+        const std::vector<size_t> & i_indices //!< [in] Номера записей
+      , uint8_t * o_data //!< [out] Массив, в который будут записаны записи
+    );
+
+    //! Прочитать поле записей подряд
+    /*!
+       Поле i_field каждой записи i_first ... i_first + i_count - 1
+       записывается в o_data как число, см. ZppReader::ReadColumn()
+
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    ssize_t ReadColumn
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_count //!< [in] Количество записей
+      , const size_t i_field //!< [in] Смещение поля в записи
+      , const size_t i_width //!< [in] Размер поля: 1, 2, 4 или 8 байт
+      , const ZppByteOrder i_order //!< [in] Порядок байт в данных
+      , void * o_data //!< [out] Массив, в который будут записаны значения поля
+    );
+
+    //! Прочитать поле записей подряд
+    /*!
+       \return Количество считанных записей
+       \return <0 Ошибка
+     */
+    template <class T>
+    ssize_t ReadColumn
+    (
+        const size_t i_first //!< [in] Номер первой записи
+      , const size_t i_count //!< [in] Количество записей
+      , const size_t i_field //!< [in] Смещение поля в записи
+      , T * o_data //!< [out] Массив, в который будут записаны значения поля
+      , const ZppByteOrder i_order = ZPP_ORDER_NATIVE //!< [in] Порядок байт в данных
+    );
+
+  protected:
+    ZppReader * m_reader = nullptr;
+    size_t m_record_size = 0;
+  };
+
+  template <class T>
+  ssize_t ZppRecordReader::ReadColumn(const size_t i_first, const size_t i_count, const size_t i_field, T * o_data, const ZppByteOrder i_order)
+  {
+    static_assert(std::is_arithmetic<T>::value, "the fields must be numbers");
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8, "unsupported field size");
+
+    return ReadColumn(i_first, i_count, i_field, sizeof(T), i_order, static_cast<void *>(o_data));
+  }
+}
+
+#endif // ZPPRECORD_HPP
@@ -0,0 +1,152 @@
+#ifndef ZPPREVERSE_HPP
+#define ZPPREVERSE_HPP
+
+#include "zpplib.hpp"
+
+namespace slx
+{
+  //! Класс чтения распакованных данных от конца к началу
+  /*!
+     Работает поверх открытого ZppReader с построенным индексом.
+     Каждый интервал между точками доступа распаковывается в буфер один
+     раз, байты и строки выдаются из буфера в обратном порядке. Пока
+     читается буфер, предыдущий интервал распаковывается в пуле потоков
+     объекта чтения
+   */
+  class ZppReverseReader
+  {
+  public:
+    //! Конструктор
+    ZppReverseReader() = default;
+
+    //! Конструктор
+    ZppReverseReader
+    (
+        ZppReader * i_reader //!< [in] Объект чтения сжатого файла
+      , const size_t i_pos = SIZE_MAX //!< [in] Позиция, перед которой начинается чтение
+    );
+
+    //! Деструктор
+    /*!
+       Дожидается завершения упреждающей распаковки
+     */
+    ~ZppReverseReader();
+
+    ZppReverseReader(const ZppReverseReader &) = delete;
+    ZppReverseReader & operator = (const ZppReverseReader &) = delete;
+
+    //! Задать объект чтения
+    /*!
+       Чтение начинается перед i_pos, по умолчанию - с конца данных
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Open
+    (
+        ZppReader * i_reader //!< [in] Объект чтения сжатого файла
+      , const size_t i_pos = SIZE_MAX //!< [in] Позиция, перед которой начинается чтение
+    );
+
+    //! Установить текущую позицию
+    /*!
+       Следующий считанный байт - байт перед позицией
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int SetPos
+    (
+        const size_t i_pos //!< [in] Позиция, не больше размера данных
+    );
+
+    //! Получить текущую позицию
+    /*!
+      \return Позиция
+     */
+    size_t GetPos();
+
+    //! Прочитать байт перед текущей позицией
+    /*!
+       Позиция уменьшается на 1
+
+       \return Значение байта
+       \return ZPP_END Достигнуто начало данных
+       \return <0 Ошибка
+     */
+    int ReadByte();
+
+    //! Прочитать данные перед текущей позицией
+    /*!
+       Считываются i_count байт, заканчивающихся перед текущей позицией,
+       в o_data они записываются в прямом порядке. Позиция уменьшается
+       на количество считанных байт
+
+       \return Количество считанных байт, 0 в начале данных
+       \return <0 Ошибка
+     */
+    ssize_t Read
+    (
+        uint8_t * o_data //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+    );
+
+    //! Прочитать строку перед текущей позицией
+    /*!
+       Строка считывается без '\n'. Разделитель непосредственно перед
+       позицией относится к считываемой строке, поэтому '\n' в конце данных
+       не даёт пустой строки. Позиция становится началом строки
+
+       \return Длина строки
+       \return ZPP_END Достигнуто начало данных
+       \return <0 Ошибка
+     */
+    ssize_t ReadLine
+    (
+        std::vector<uint8_t> & o_line //!< [out] Вектор, в который будет записана строка
+    );
+
+    //! Установить флаг упреждающей распаковки
+    /*!
+       По умолчанию включена
+     */
+    void SetFlagPrefetch
+    (
+        bool i_flag //!< [in] Флаг упреждающей распаковки предыдущего интервала
+    );
+
+    //! Получить флаг упреждающей распаковки
+    /*!
+      \return Флаг упреждающей распаковки
+     */
+    bool GetFlagPrefetch();
+
+    //! Получить количество распакованных интервалов
+    /*!
+      \return Количество интервалов, распакованных с момента Open()
+     */
+    size_t GetSpanCount();
+
+  protected:
+    int load(const size_t i_pos);
+
+    void prefetch();
+
+    void wait_prefetch();
+
+    ZppReader * m_reader = nullptr;
+    size_t m_pos = 0;
+    bool m_flag_prefetch = true;
+    size_t m_span_count = 0;
+
+    std::vector<uint8_t> m_buffer;      //!< Распакованный интервал
+    size_t m_buffer_beg = 0;            //!< Начало интервала в буфере
+
+    std::vector<uint8_t> m_prefetch;    //!< Предыдущий интервал, распаковываемый заранее
+    size_t m_prefetch_beg = 0;
+    std::future<ssize_t> m_pending;     //!< Результат упреждающей распаковки
+    ZppCancel m_cancel;
+  };
+}
+
+#endif // ZPPREVERSE_HPP
@@ -0,0 +1,233 @@
+#ifndef ZPPSINK_HPP
+#define ZPPSINK_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+namespace slx
+{
+  //! Приёмник сжатых данных
+  /*!
+     Данные записываются последовательно. Приёмник, который может отдать
+     место под данные (Reserve()), получает их без промежуточного буфера
+   */
+  class ZppSink
+  {
+  public:
+    virtual ~ZppSink() = default;
+
+    //! Записать данные
+    /*!
+       Записываются все i_size байт
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    virtual int Write
+    (
+        const uint8_t * i_data //!< [in] Данные
+      , const size_t i_size //!< [in] Размер данных
+    ) = 0;
+
+    //! Записать несколько участков подряд
+    /*!
+       По умолчанию участки записываются по одному через Write()
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    virtual int WriteVector
+    (
+        const struct iovec * i_parts //!< [in] Участки
+      , const int i_count //!< [in] Количество участков
+    );
+
+    //! Получить место под данные
+    /*!
+       Место действует до следующего вызова любого метода приёмника,
+       записанное в него добавляется вызовом Commit()
+
+       \return Указатель на не менее чем i_size байт
+       \return nullptr Приёмник не предоставляет место, нужен Write()
+     */
+    virtual uint8_t * Reserve
+    (
+        const size_t i_size //!< [in] Размер
+    );
+
+    //! Добавить данные, записанные в место из Reserve()
+    /*!
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    virtual int Commit
+    (
+        const size_t i_size //!< [in] Количество записанных байт
+    );
+
+    //! Передать буферизованные данные дальше
+    /*!
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    virtual int Flush();
+  };
+
+  //! Приёмник - поток stdio
+  class ZppFileSink : public ZppSink
+  {
+  public:
+    //! Конструктор
+    /*!
+       Поток не закрывается при уничтожении объекта
+     */
+    ZppFileSink
+    (
+        FILE * i_file //!< [in] Дескриптор файла
+    );
+
+    int Write
+    (
+        const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+    int Flush() override;
+
+  protected:
+    FILE * m_file = nullptr;
+  };
+
+  //! Приёмник - файловый дескриптор
+  /*!
+     Данные пишутся вызовами write() и writev() без буферизации,
+     группа блоков - одним вызовом writev()
+   */
+  class ZppFdSink : public ZppSink
+  {
+  public:
+    //! Конструктор
+    ZppFdSink
+    (
+        int i_fd //!< [in] Файловый дескриптор
+      , bool i_flag_own = false //!< [in] Флаг, закрывать ли дескриптор при уничтожении объекта
+    );
+
+    //! Деструктор
+    ~ZppFdSink();
+
+    ZppFdSink(const ZppFdSink &) = delete;
+    ZppFdSink & operator = (const ZppFdSink &) = delete;
+
+    int Write
+    (
+        const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+    int WriteVector
+    (
+        const struct iovec * i_parts
+      , const int i_count
+    ) override;
+
+  protected:
+    int m_fd = -1;
+    bool m_flag_own = false;
+  };
+
+  //! Приёмник в памяти
+  /*!
+     Буфер растёт по мере записи, сжатие пишет прямо в него. Результат
+     доступен через GetData() или забирается Release() без копирования
+   */
+  class ZppMemorySink : public ZppSink
+  {
+  public:
+    //! Конструктор
+    ZppMemorySink
+    (
+        const size_t i_capacity = 0 //!< [in] Начальный размер буфера
+    );
+
+    int Write
+    (
+        const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+    uint8_t * Reserve
+    (
+        const size_t i_size
+    ) override;
+
+    int Commit
+    (
+        const size_t i_size
+    ) override;
+
+    //! Получить записанные данные
+    /*!
+       Указатель действует до следующей записи
+
+      \return Данные
+     */
+    const uint8_t * GetData();
+
+    //! Получить размер записанных данных
+    /*!
+      \return Размер данных
+     */
+    size_t GetSize();
+
+    //! Забрать записанные данные
+    /*!
+       Приёмник становится пустым
+
+      \return Данные
+     */
+    std::vector<uint8_t> Release();
+
+    //! Очистить приёмник, сохранив выделенную память
+    void Clear();
+
+  protected:
+    std::vector<uint8_t> m_data;  //!< Буфер, размер - выделенное место
+    size_t m_size = 0;            //!< Записано байт
+  };
+
+  //! Приёмник с пользовательской функцией записи
+  class ZppCallbackSink : public ZppSink
+  {
+  public:
+    //! Функция записи
+    /*!
+       Принимает данные и их размер, должна принять все данные.
+       Возвращает Z_OK или <0 при ошибке. Указатель действует только
+       во время вызова
+     */
+    typedef std::function<int(const uint8_t *, size_t)> WriteFunc;
+
+    //! Конструктор
+    ZppCallbackSink
+    (
+        WriteFunc i_write //!< [in] Функция записи
+    );
+
+    int Write
+    (
+        const uint8_t * i_data
+      , const size_t i_size
+    ) override;
+
+  protected:
+    WriteFunc m_write;
+  };
+}
+
+#endif // ZPPSINK_HPP
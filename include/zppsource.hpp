@@ -0,0 +1,277 @@
+#ifndef ZPPSOURCE_HPP
+#define ZPPSOURCE_HPP
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+namespace slx
+{
+  //! Политика ввода-вывода файла
+  enum ZppIoPolicy
+  {
+    ZPP_IO_DEFAULT = 0, //!< Обычное чтение через кэш страниц
+    ZPP_IO_STREAM = 1,  //!< Последовательные чтения с упреждением, прочитанное вытесняется из кэша страниц
+    ZPP_IO_DIRECT = 2   //!< Чтение в обход кэша страниц (O_DIRECT) крупными выровненными блоками
+  };
+
+  //! Идентификатор файла
+  /*!
+     Устройство, inode, размер и время изменения файла
+   */
+  struct ZppFileId
+  {
+    uint64_t dev = 0; //!< Устройство
+    uint64_t ino = 0; //!< inode
+    uint64_t size = 0; //!< Размер в байтах
+    int64_t mtime = 0; //!< Время изменения в наносекундах
+
+    bool operator == (const ZppFileId & i_other) const;
+    bool operator < (const ZppFileId & i_other) const;
+
+    //! Получить хэш идентификатора
+    /*!
+      \return Хэш, отличный от 0
+     */
+    uint64_t Hash() const;
+
+    //! Получить идентификатор открытого файла
+    /*!
+      \return true Успех
+     */
+    static bool FromFd
+    (
+        int i_fd //!< [in] Файловый дескриптор
+      , ZppFileId & o_id //!< [out] Идентификатор
+    );
+
+    //! Получить идентификатор файла по имени
+    /*!
+      \return true Успех
+     */
+    static bool FromPath
+    (
+        const std::string & i_filename //!< [in] Имя файла
+      , ZppFileId & o_id //!< [out] Идентификатор
+    );
+  };
+
+  //! Источник сжатых данных
+  /*!
+     Чтение позиционное, без текущей позиции, поэтому один источник
+     может использоваться из нескольких потоков одновременно
+   */
+  class ZppSource
+  {
+  public:
+    virtual ~ZppSource() = default;
+
+    //! Прочитать данные по смещению
+    /*!
+       \return Количество считанных байт, меньше i_count только в конце данных
+       \return <0 Ошибка
+     */
+    virtual ssize_t ReadAt
+    (
+        uint8_t * o_data //!< [out] Массив, в который будут записаны данные
+      , const size_t i_count //!< [in] Количество байт для считывания
+      , const off_t i_offset //!< [in] Смещение
+    ) = 0;
+
+    //! Получить прямой доступ к данным
+    /*!
+       Позволяет читать данные без копирования, если они уже в памяти
+
+       \return Указатель на данные по смещению i_offset
+       \return nullptr Прямой доступ не поддерживается
+     */
+    virtual const uint8_t * Map
+    (
+        const off_t i_offset //!< [in] Смещение
+      , size_t & o_size //!< [out] Количество доступных байт
+    );
+
+    //! Получить идентификатор файла
+    /*!
+       Используется как ключ кэшей, разделяемых между объектами чтения
+
+       \return true Идентификатор известен
+       \return false Источник не связан с файлом
+     */
+    virtual bool GetFileId
+    (
+        ZppFileId & o_id //!< [out] Идентификатор
+    );
+  };
+
+  //! Источник данных из файла
+  class ZppFileSource : public ZppSource
+  {
+  public:
+    //! Конструктор
+    /*!
+       Открывает файл на чтение
+     */
+    ZppFileSource
+    (
+        const std::string & i_filename //!< [in] Имя файла
+    );
+
+    //! Конструктор
+    /*!
+       Файл не закрывается при уничтожении объекта
+     */
+    ZppFileSource
+    (
+        FILE * i_file //!< [in] Дескриптор файла
+    );
+
+    //! Конструктор
+    ZppFileSource
+    (
+        int i_fd //!< [in] Файловый дескриптор
+      , bool i_flag_own = false //!< [in] Флаг, закрывать ли дескриптор при уничтожении объекта
+    );
+
+    //! Деструктор
+    ~ZppFileSource();
+
+    ZppFileSource(const ZppFileSource &) = delete;
+    ZppFileSource & operator = (const ZppFileSource &) = delete;
+
+    ssize_t ReadAt
+    (
+        uint8_t * o_data
+      , const size_t i_count
+      , const off_t i_offset
+    ) override;
+
+    bool GetFileId
+    (
+        ZppFileId & o_id
+    ) override;
+
+    //! Получить статус готовности
+    /*!
+      \return Статус готовности
+     */
+    bool IsReady();
+
+    //! Получить файловый дескриптор
+    /*!
+      \return Файловый дескриптор, -1 если файл не открыт
+     */
+    int GetFd();
+
+    //! Установить политику ввода-вывода
+    /*!
+       ZPP_IO_STREAM подходит для просмотра файла целиком (построение
+       индекса, проверка, полная распаковка): при последовательных
+       чтениях запрашивается упреждающее чтение, а прочитанные страницы
+       вытесняются, не вытесняя данные соседних процессов.
+       ZPP_IO_DIRECT включает O_DIRECT на дескрипторе (для файла,
+       открытого не этим объектом, это влияет и на других его
+       пользователей); данные читаются блоками по DIRECT_BUFFER байт
+       в буфер потока
+
+       \return Z_OK Успех
+       \return Z_ERRNO Политика не поддерживается файловой системой
+     */
+    int SetIoPolicy
+    (
+        ZppIoPolicy i_policy //!< [in] Политика
+    );
+
+    //! Получить политику ввода-вывода
+    /*!
+      \return Политика
+     */
+    ZppIoPolicy GetIoPolicy();
+
+    //! Размер окна, после которого прочитанное вытесняется
+    static const size_t STREAM_WINDOW = 8 << 20;
+
+    //! Размер блока чтения в обход кэша страниц
+    static const size_t DIRECT_BUFFER = 1 << 20;
+
+  protected:
+    ssize_t read_direct(uint8_t * o_data, const size_t i_count, const off_t i_offset);
+
+    void advise(const off_t i_offset, const size_t i_count);
+
+    int m_fd = -1;
+    bool m_flag_own = false;
+
+    ZppIoPolicy m_policy = ZPP_IO_DEFAULT;
+    uint64_t m_serial = 0;      //!< Номер объекта для буферов потоков
+    std::mutex m_scan_mutex;
+    off_t m_scan_end = -1;      //!< Конец последнего чтения
+    off_t m_drop_from = 0;      //!< Начало ещё не вытесненной части просмотра
+  };
+
+  //! Источник данных из памяти
+  /*!
+     Данные не копируются и должны существовать, пока используется источник
+   */
+  class ZppMemorySource : public ZppSource
+  {
+  public:
+    //! Конструктор
+    ZppMemorySource
+    (
+        const uint8_t * i_data //!< [in] Сжатые данные
+      , const size_t i_size //!< [in] Размер данных
+    );
+
+    ssize_t ReadAt
+    (
+        uint8_t * o_data
+      , const size_t i_count
+      , const off_t i_offset
+    ) override;
+
+    const uint8_t * Map
+    (
+        const off_t i_offset
+      , size_t & o_size
+    ) override;
+
+  protected:
+    const uint8_t * m_data = nullptr;
+    size_t m_size = 0;
+  };
+
+  //! Источник данных с пользовательской функцией чтения
+  class ZppCallbackSource : public ZppSource
+  {
+  public:
+    //! Функция позиционного чтения
+    /*!
+       Принимает массив, количество байт и смещение.
+       Возвращает количество считанных байт или <0 при ошибке.
+       Может вызываться из нескольких потоков одновременно
+     */
+    typedef std::function<ssize_t(uint8_t *, size_t, off_t)> ReadFunc;
+
+    //! Конструктор
+    ZppCallbackSource
+    (
+        ReadFunc i_read //!< [in] Функция позиционного чтения
+    );
+
+    ssize_t ReadAt
+    (
+        uint8_t * o_data
+      , const size_t i_count
+      , const off_t i_offset
+    ) override;
+
+  protected:
+    ReadFunc m_read;
+  };
+}
+
+#endif // ZPPSOURCE_HPP
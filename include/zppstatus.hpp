@@ -0,0 +1,15 @@
+#ifndef ZPPSTATUS_HPP
+#define ZPPSTATUS_HPP
+
+namespace slx
+{
+  //! Коды ошибок библиотеки, дополняющие коды zlib
+  enum ZppStatus : int
+  {
+    ZPP_CANCELED = -100 //!< Операция отменена
+  , ZPP_QUEUE_FULL = -101 //!< Очередь пула потоков заполнена
+  , ZPP_END = -102 //!< Достигнута граница данных
+  };
+}
+
+#endif // ZPPSTATUS_HPP
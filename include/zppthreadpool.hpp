@@ -0,0 +1,140 @@
+#ifndef ZPPTHREADPOOL_HPP
+#define ZPPTHREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "zppstatus.hpp"
+
+namespace slx
+{
+  //! Признак отмены асинхронной операции
+  /*!
+     Копии объекта разделяют один признак
+   */
+  class ZppCancel
+  {
+  public:
+    //! Отменить операцию
+    void Cancel();
+
+    //! Получить признак отмены
+    /*!
+      \return true, если операция отменена
+     */
+    bool IsCanceled() const;
+
+  protected:
+    std::shared_ptr<std::atomic<bool>> m_flag = std::make_shared<std::atomic<bool>>(false);
+  };
+
+  //! Пул рабочих потоков с ограниченной очередью задач
+  class ZppThreadPool
+  {
+  public:
+    //! Конструктор
+    /*!
+       Запускает рабочие потоки
+     */
+    ZppThreadPool
+    (
+        size_t i_threads = 0 //!< [in] Количество потоков, 0 - по числу ядер
+      , size_t i_queue_limit = 1024 //!< [in] Максимальная длина очереди, 0 - без ограничений
+    );
+
+    //! Деструктор
+    /*!
+       Дожидается выполнения задач из очереди и останавливает потоки
+     */
+    ~ZppThreadPool();
+
+    ZppThreadPool(const ZppThreadPool &) = delete;
+    ZppThreadPool & operator = (const ZppThreadPool &) = delete;
+
+    //! Поставить задачу в очередь
+    /*!
+       Не блокирует вызывающий поток
+
+       \return Z_OK Успех
+       \return ZPP_QUEUE_FULL Очередь заполнена
+     */
+    int Submit
+    (
+        std::function<void()> i_task //!< [in] Задача
+    );
+
+    //! Выполнить задачи параллельно
+    /*!
+       Вызывает i_func для индексов от 0 до i_count - 1 и дожидается
+       завершения всех вызовов. Вызывающий поток тоже выполняет задачи,
+       поэтому метод можно вызывать из рабочих потоков пула и при
+       заполненной очереди. Если i_func выбрасывает исключение, остальные
+       индексы пропускаются, а первое исключение выбрасывается в вызывающем
+       потоке после завершения всех задач
+     */
+    void ParallelFor
+    (
+        size_t i_count //!< [in] Количество задач
+      , const std::function<void(size_t)> & i_func //!< [in] Задача, принимающая индекс
+    );
+
+    //! Получить количество потоков
+    /*!
+      \return Количество потоков
+     */
+    size_t GetThreadCount();
+
+    //! Получить количество задач в очереди
+    /*!
+      \return Количество задач, ожидающих выполнения
+     */
+    size_t GetQueueSize();
+
+    //! Получить максимальную длину очереди
+    /*!
+      \return Максимальная длина очереди, 0 - без ограничений
+     */
+    size_t GetQueueLimit();
+
+    //! Получить общий пул потоков процесса
+    /*!
+       Пул создается при первом обращении
+
+      \return Общий пул потоков
+     */
+    static ZppThreadPool & Shared();
+
+    //! Задать параметры общего пула потоков
+    /*!
+       Действует только до первого обращения к Shared()
+
+       \return Z_OK Успех
+       \return Z_ERRNO Общий пул уже создан
+     */
+    static int ConfigureShared
+    (
+        size_t i_threads //!< [in] Количество потоков, 0 - по числу ядер
+      , size_t i_queue_limit //!< [in] Максимальная длина очереди, 0 - без ограничений
+    );
+
+  protected:
+    void Work();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_queue;
+    size_t m_queue_limit = 0;
+    bool m_flag_stop = false;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+  };
+}
+
+#endif // ZPPTHREADPOOL_HPP
@@ -0,0 +1,134 @@
+#ifndef ZPPTRANSCODE_HPP
+#define ZPPTRANSCODE_HPP
+
+#include "zpplib.hpp"
+#include "zppsink.hpp"
+
+namespace slx
+{
+  //! Класс перепаковки сжатого файла в формат с произвольным доступом
+  /*!
+     Данные распаковываются по индексу ZppReader параллельно, по участкам
+     между точками доступа, и сжимаются заново независимыми блоками GZip
+     с размерами в заголовках или кадрами zstd с таблицей поиска. Следующая
+     группа участков распаковывается, пока сжимается текущая. Результат
+     читается gunzip (zstd), а ZppReader строит его индекс по заголовкам
+     без распаковки и без хранения окон
+   */
+  class ZppTranscoder
+  {
+  public:
+    //! Размер блока по умолчанию
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 1048576;
+
+    //! Конструктор
+    ZppTranscoder() = default;
+
+    //! Перепаковать данные
+    /*!
+       Перепаковываются данные, проиндексированные к моменту вызова.
+       Объект чтения не должен использоваться другими потоками
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Transcode
+    (
+        ZppReader * i_reader //!< [in] Объект чтения с построенным индексом
+      , ZppSink * o_sink //!< [out] Приёмник сжатых данных
+    );
+
+    //! Перепаковать данные в файл
+    /*!
+       При ошибке файл удаляется
+
+       \return Z_OK Успех
+       \return <0 Ошибка
+     */
+    int Transcode
+    (
+        ZppReader * i_reader //!< [in] Объект чтения с построенным индексом
+      , const std::string & i_filename //!< [in] Имя создаваемого файла
+    );
+
+    //! Получить размер блока
+    /*!
+      \return Размер блока или кадра zstd
+     */
+    size_t GetBlockSize();
+
+    //! Установить размер блока
+    /*!
+       0 - размер по умолчанию
+     */
+    void SetBlockSize
+    (
+        size_t i_size //!< [in] Размер блока или кадра zstd
+    );
+
+    //! Получить уровень сжатия
+    /*!
+      \return Уровень сжатия
+     */
+    int GetCompressionLevel();
+
+    //! Установить уровень сжатия
+    void SetCompressionLevel
+    (
+        int i_level //!< [in] Уровень сжатия
+    );
+
+    //! Получить формат результата
+    /*!
+      \return Формат сжатия
+     */
+    ZppFormat GetFormat();
+
+    //! Установить формат результата
+    /*!
+       ZPP_FORMAT_DEFLATE - независимые блоки GZip
+     */
+    void SetFormat
+    (
+        ZppFormat i_format //!< [in] Формат сжатия
+    );
+
+    //! Задать пул потоков сжатия
+    /*!
+       По умолчанию используется общий пул процесса. Распаковка выполняется
+       в пуле объекта чтения
+     */
+    void SetThreadPool
+    (
+        ZppThreadPool * i_pool //!< [in] Пул потоков, nullptr - общий пул
+    );
+
+    //! Получить размер перепакованных данных
+    /*!
+      \return Количество несжатых байт последнего вызова Transcode()
+     */
+    size_t GetTotalIn();
+
+    //! Получить размер результата
+    /*!
+      \return Количество сжатых байт последнего вызова Transcode()
+     */
+    size_t GetTotalOut();
+
+  protected:
+    struct group;
+
+    int start_group(ZppReader * i_reader, group & io_group, size_t i_offset, size_t i_size);
+
+    int finish_group(ZppReader * i_reader, group & io_group);
+
+    size_t m_block_size = DEFAULT_BLOCK_SIZE;
+    int m_compression_level = Z_DEFAULT_COMPRESSION;
+    ZppFormat m_format = ZPP_FORMAT_DEFLATE;
+    ZppThreadPool * m_pool = nullptr;
+    size_t m_total_in = 0;
+    size_t m_total_out = 0;
+  };
+}
+
+#endif // ZPPTRANSCODE_HPP
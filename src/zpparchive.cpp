@@ -0,0 +1,279 @@
+#include "zpparchive.hpp"
+
+namespace slx
+{
+  //! Источник данных файла архива, открывающий файл по требованию
+  class ZppArchive::Source : public ZppSource
+  {
+  public:
+    Source(ZppArchive * i_archive, const std::string & i_filename, const ZppFileId & i_id)
+      : archive(i_archive)
+      , filename(i_filename)
+      , id(i_id)
+    {
+    }
+
+    ssize_t ReadAt(uint8_t * o_data, const size_t i_count, const off_t i_offset) override
+    {
+      ZppFileSource * source = archive->Acquire(this);
+      if (source == nullptr)
+      {
+        return Z_ERRNO;
+      }
+
+      ssize_t ret_val = source->ReadAt(o_data, i_count, i_offset);
+      archive->Release(this);
+
+      return ret_val;
+    }
+
+    bool GetFileId(ZppFileId & o_id) override
+    {
+      o_id = id;
+      return true;
+    }
+
+    ZppArchive * archive;
+    std::string filename;
+    ZppFileId id;
+
+    /* guarded by the handle mutex of the archive */
+    std::unique_ptr<ZppFileSource> file;
+    size_t pins = 0;
+    std::list<Source *>::iterator lru;
+  };
+
+  ZppArchive::ZppArchive(const size_t i_max_open_files, const size_t i_cache_size)
+    : m_max_open_files(i_max_open_files)
+    , m_cache(i_cache_size)
+  {
+  }
+
+  ZppArchive::~ZppArchive()
+  {
+    /* readers go first, they read through the sources */
+    for (auto & entry : m_entries)
+    {
+      entry.second->reader.reset();
+      CloseSource(entry.second->source.get());
+    }
+  }
+
+  int ZppArchive::Add(const std::string & i_filename)
+  {
+    ZppFileId id;
+    if (ZppFileId::FromPath(i_filename, id) == false)
+    {
+      return Z_ERRNO;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_entries.count(i_filename) != 0)
+    {
+      return Z_OK;
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    entry->source.reset(new Source(this, i_filename, id));
+    m_entries[i_filename] = std::move(entry);
+
+    return Z_OK;
+  }
+
+  void ZppArchive::Remove(const std::string & i_filename)
+  {
+    std::unique_ptr<Entry> entry;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      auto it = m_entries.find(i_filename);
+      if (it == m_entries.end())
+      {
+        return;
+      }
+
+      entry = std::move(it->second);
+      m_entries.erase(it);
+    }
+
+    entry->reader.reset();
+    CloseSource(entry->source.get());
+  }
+
+  size_t ZppArchive::GetFileCount()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries.size();
+  }
+
+  ZppReader * ZppArchive::GetReader(const std::string & i_filename)
+  {
+    Entry * entry = FindEntry(i_filename);
+    if (entry == nullptr)
+    {
+      return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(entry->mutex);
+    if (entry->flag_indexed == false)
+    {
+      std::unique_ptr<ZppReader> reader(new ZppReader());
+      reader->SetSpanCache(&m_cache);
+      if (reader->Open(entry->source.get()) < 0)
+      {
+        return nullptr;
+      }
+
+      entry->reader = std::move(reader);
+      entry->flag_indexed = true;
+    }
+
+    return entry->reader.get();
+  }
+
+  ssize_t ZppArchive::ReadOffset(const std::string & i_filename, uint8_t * o_data, const size_t i_count, const size_t i_offset)
+  {
+    ZppReader * reader = GetReader(i_filename);
+    if (reader == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    return reader->ReadOffset(o_data, i_count, i_offset);
+  }
+
+  ssize_t ZppArchive::ReadOffset(const std::string & i_filename, std::vector<uint8_t> & o_data, const size_t i_count, const size_t i_offset)
+  {
+    o_data.resize(i_count);
+    ssize_t ret_val = ReadOffset(i_filename, o_data.data(), i_count, i_offset);
+    if (ret_val < 0)
+    {
+      o_data.clear();
+      return ret_val;
+    }
+
+    o_data.resize(static_cast<size_t>(ret_val));
+    return ret_val;
+  }
+
+  size_t ZppArchive::GetSize(const std::string & i_filename)
+  {
+    ZppReader * reader = GetReader(i_filename);
+    if (reader == nullptr)
+    {
+      return 0;
+    }
+
+    return reader->GetSize();
+  }
+
+  void ZppArchive::SetMaxOpenFiles(const size_t i_count)
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+    m_max_open_files = i_count;
+    if (m_max_open_files != 0)
+    {
+      Trim(m_max_open_files);
+    }
+  }
+
+  size_t ZppArchive::GetMaxOpenFiles()
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+    return m_max_open_files;
+  }
+
+  size_t ZppArchive::GetOpenFileCount()
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+    return m_open.size();
+  }
+
+  ZppLruSpanCache & ZppArchive::GetSpanCache()
+  {
+    return m_cache;
+  }
+
+  ZppArchive::Entry * ZppArchive::FindEntry(const std::string & i_filename)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_entries.find(i_filename);
+    if (it == m_entries.end())
+    {
+      return nullptr;
+    }
+
+    return it->second.get();
+  }
+
+  ZppFileSource * ZppArchive::Acquire(ZppArchive::Source * i_source)
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+
+    if (i_source->file == nullptr)
+    {
+      /* make room for one more handle */
+      if (m_max_open_files != 0)
+      {
+        Trim(m_max_open_files - 1);
+      }
+
+      std::unique_ptr<ZppFileSource> file(new ZppFileSource(i_source->filename));
+      if (file->IsReady() == false)
+      {
+        return nullptr;
+      }
+
+      /* the index is valid only for the same file */
+      ZppFileId id;
+      if (file->GetFileId(id) == false || (id == i_source->id) == false)
+      {
+        return nullptr;
+      }
+
+      i_source->file = std::move(file);
+      m_open.push_front(i_source);
+      i_source->lru = m_open.begin();
+    }
+    else
+    {
+      m_open.splice(m_open.begin(), m_open, i_source->lru);
+    }
+
+    ++i_source->pins;
+    return i_source->file.get();
+  }
+
+  void ZppArchive::Release(ZppArchive::Source * i_source)
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+    --i_source->pins;
+  }
+
+  void ZppArchive::CloseSource(ZppArchive::Source * i_source)
+  {
+    std::lock_guard<std::mutex> lock(m_handle_mutex);
+    if (i_source->file != nullptr)
+    {
+      m_open.erase(i_source->lru);
+      i_source->file.reset();
+    }
+  }
+
+  void ZppArchive::Trim(const size_t i_limit)
+  {
+    /* close the least recently used files not being read from */
+    std::list<Source *>::iterator it = m_open.end();
+    while (m_open.size() > i_limit && it != m_open.begin())
+    {
+      --it;
+      Source * source = *it;
+      if (source->pins != 0)
+      {
+        continue;
+      }
+
+      it = m_open.erase(it);
+      source->file.reset();
+    }
+  }
+}
@@ -0,0 +1,540 @@
+#include "zppcache.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace slx
+{
+  bool ZppSpanKey::operator == (const ZppSpanKey & i_other) const
+  {
+    return file == i_other.file && offset == i_other.offset;
+  }
+
+  void ZppSpanCache::Cancel(const ZppSpanKey & /*i_key*/)
+  {
+  }
+
+  size_t ZppLruSpanCache::KeyHash::operator () (const ZppSpanKey & i_key) const
+  {
+    return static_cast<size_t>(i_key.file ^ (i_key.offset * 0x9e3779b97f4a7c15ULL));
+  }
+
+  ZppLruSpanCache::ZppLruSpanCache(const size_t i_limit)
+    : m_limit(i_limit)
+  {
+  }
+
+  bool ZppLruSpanCache::Lookup(const ZppSpanKey & i_key, const size_t i_offset, uint8_t * o_data, const size_t i_count)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_map.find(i_key);
+    if (it == m_map.end())
+    {
+      return false;
+    }
+
+    const std::vector<uint8_t> & data = it->second->second;
+    if (i_offset > data.size() || i_count > data.size() - i_offset)
+    {
+      return false;
+    }
+
+    memcpy(o_data, data.data() + i_offset, i_count);
+    m_spans.splice(m_spans.begin(), m_spans, it->second);
+
+    return true;
+  }
+
+  void ZppLruSpanCache::Insert(const ZppSpanKey & i_key, const uint8_t * i_data, const size_t i_size)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (i_size > m_limit)
+    {
+      return;
+    }
+
+    auto it = m_map.find(i_key);
+    if (it != m_map.end())
+    {
+      m_usage -= it->second->second.size();
+      m_spans.erase(it->second);
+      m_map.erase(it);
+    }
+
+    m_spans.emplace_front(i_key, std::vector<uint8_t>(i_data, i_data + i_size));
+    m_map[i_key] = m_spans.begin();
+    m_usage += i_size;
+
+    Trim();
+  }
+
+  void ZppLruSpanCache::SetLimit(const size_t i_limit)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_limit = i_limit;
+    Trim();
+  }
+
+  size_t ZppLruSpanCache::GetLimit()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+  }
+
+  size_t ZppLruSpanCache::GetUsage()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usage;
+  }
+
+  void ZppLruSpanCache::Clear()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_spans.clear();
+    m_map.clear();
+    m_usage = 0;
+  }
+
+  void ZppLruSpanCache::Trim()
+  {
+    while (m_usage > m_limit && m_spans.empty() == false)
+    {
+      m_usage -= m_spans.back().second.size();
+      m_map.erase(m_spans.back().first);
+      m_spans.pop_back();
+    }
+  }
+
+  namespace
+  {
+    /* "ZPPSHC" and the layout version */
+    const uint64_t SHM_MAGIC = 0x5A50505348430001ULL;
+    const size_t SHM_ALIGN = 4096;
+
+    size_t round_up(size_t i_size, size_t i_align)
+    {
+      return (i_size + i_align - 1) / i_align * i_align;
+    }
+  }
+
+  /* The segment starts with the header, then the slot table and the slot
+     data. It is zero filled by ftruncate(), which is a valid empty state
+     for every field; magic is published last by the creator. */
+  struct ZppShmSpanCache::header
+  {
+    std::atomic<uint64_t> magic;
+    uint64_t slot_count;
+    uint64_t slot_size;
+    uint64_t data_offset;
+    std::atomic<uint32_t> clock;  /* bumped on every insert, ages the slots */
+  };
+
+  /* seq is even while the slot is stable and odd while a writer owns it;
+     a reader copies the data and accepts it if seq did not change */
+  struct alignas(64) ZppShmSpanCache::slot
+  {
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> file;   /* 0 - empty */
+    std::atomic<uint64_t> offset;
+    std::atomic<uint64_t> size;
+    std::atomic<uint32_t> stamp;  /* clock of the last use */
+    std::atomic<int32_t> writer;  /* process that owns an odd seq */
+  };
+
+  static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock-free atomics");
+
+  ZppShmSpanCache::ZppShmSpanCache(const std::string & i_name, const size_t i_limit, const size_t i_slot_size, const mode_t i_mode, const size_t i_wait)
+    : m_wait(i_wait)
+  {
+    attach(i_name, i_limit, i_slot_size, i_mode);
+  }
+
+  ZppShmSpanCache::~ZppShmSpanCache()
+  {
+    if (m_header != nullptr)
+    {
+      munmap(m_header, m_mapped);
+    }
+  }
+
+  int ZppShmSpanCache::attach(const std::string & i_name, const size_t i_limit, const size_t i_slot_size, const mode_t i_mode)
+  {
+    size_t slot_size = round_up(i_slot_size, 64);
+    size_t count = slot_size != 0 ? i_limit / slot_size / WAYS * WAYS : 0;
+
+    int fd = shm_open(i_name.c_str(), O_RDWR | O_CREAT | O_EXCL, i_mode);
+    if (fd >= 0)
+    {
+      /* the creator sizes and publishes the segment */
+      if (count == 0)
+      {
+        close(fd);
+        shm_unlink(i_name.c_str());
+        return -1;
+      }
+
+      const size_t data_offset = round_up(round_up(sizeof(header), alignof(slot)) + count * sizeof(slot), SHM_ALIGN);
+      const size_t total = data_offset + count * slot_size;
+      void * addr = MAP_FAILED;
+      if (ftruncate(fd, static_cast<off_t>(total)) == 0)
+      {
+        addr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      }
+      close(fd);
+      if (addr == MAP_FAILED)
+      {
+        shm_unlink(i_name.c_str());
+        return -1;
+      }
+
+      m_header = static_cast<header *>(addr);
+      m_header->slot_count = count;
+      m_header->slot_size = slot_size;
+      m_header->data_offset = data_offset;
+      m_header->magic.store(SHM_MAGIC, std::memory_order_release);
+      m_mapped = total;
+      m_data = static_cast<uint8_t *>(addr) + data_offset;
+    }
+    else
+    {
+      if (errno != EEXIST)
+      {
+        return -1;
+      }
+
+      fd = shm_open(i_name.c_str(), O_RDWR, 0);
+      if (fd < 0)
+      {
+        return -1;
+      }
+
+      /* wait for the creator to publish the layout */
+      void * addr = MAP_FAILED;
+      for (int attempt = 0; attempt < 1000 && addr == MAP_FAILED; ++attempt)
+      {
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+          break;
+        }
+
+        if (static_cast<size_t>(st.st_size) >= sizeof(header))
+        {
+          addr = mmap(nullptr, sizeof(header), PROT_READ, MAP_SHARED, fd, 0);
+          if (addr != MAP_FAILED
+              && static_cast<header *>(addr)->magic.load(std::memory_order_acquire) != SHM_MAGIC)
+          {
+            munmap(addr, sizeof(header));
+            addr = MAP_FAILED;
+          }
+        }
+
+        if (addr == MAP_FAILED)
+        {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+      if (addr == MAP_FAILED)
+      {
+        close(fd);
+        return -1;
+      }
+
+      /* the layout written by another process is checked against the
+         segment before anything is placed by it */
+      const header * layout = static_cast<header *>(addr);
+      count = layout->slot_count;
+      slot_size = layout->slot_size;
+      const size_t data_offset = layout->data_offset;
+      munmap(addr, sizeof(header));
+
+      struct stat st;
+      if (fstat(fd, &st) != 0)
+      {
+        close(fd);
+        return -1;
+      }
+
+      const size_t size = static_cast<size_t>(st.st_size);
+      const size_t table = round_up(sizeof(header), alignof(slot));
+      if (size < table || count == 0 || count % WAYS != 0 || count > (size - table) / sizeof(slot)
+          || slot_size == 0 || slot_size % 64 != 0
+          || data_offset < table + count * sizeof(slot) || data_offset > size
+          || slot_size > (size - data_offset) / count)
+      {
+        close(fd);
+        return -1;
+      }
+
+      const size_t total = data_offset + count * slot_size;
+      addr = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      close(fd);
+      if (addr == MAP_FAILED)
+      {
+        return -1;
+      }
+
+      m_header = static_cast<header *>(addr);
+      m_mapped = total;
+      m_data = static_cast<uint8_t *>(addr) + data_offset;
+    }
+
+    m_slots = reinterpret_cast<slot *>(reinterpret_cast<uint8_t *>(m_header) + round_up(sizeof(header), alignof(slot)));
+    m_slot_count = count;
+    m_slot_size = slot_size;
+
+    return 0;
+  }
+
+  ZppShmSpanCache::slot * ZppShmSpanCache::find_set(const ZppSpanKey & i_key)
+  {
+    uint64_t hash = i_key.file ^ (i_key.offset * 0x9e3779b97f4a7c15ULL);
+    hash ^= hash >> 29;
+    const size_t sets = m_slot_count / WAYS;
+
+    return m_slots + (hash % sets) * WAYS;
+  }
+
+  bool ZppShmSpanCache::Lookup(const ZppSpanKey & i_key, const size_t i_offset, uint8_t * o_data, const size_t i_count)
+  {
+    if (m_header == nullptr || i_key.file == 0)
+    {
+      return false;
+    }
+
+    /* while another process decodes the span, wait for it instead of
+       decoding the same data again, then decode it here after all */
+    slot * set = find_set(i_key);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(m_wait);
+    for (;;)
+    {
+      bool pending = false;
+      for (size_t way = 0; way < WAYS; ++way)
+      {
+        slot & s = set[way];
+        const uint64_t seq = s.seq.load(std::memory_order_acquire);
+        if (s.file.load(std::memory_order_relaxed) != i_key.file
+            || s.offset.load(std::memory_order_relaxed) != i_key.offset)
+        {
+          continue;
+        }
+
+        if ((seq & 1) != 0)
+        {
+          pending = is_alive(s);
+          continue;
+        }
+
+        const size_t size = s.size.load(std::memory_order_relaxed);
+        if (size > m_slot_size || i_offset > size || i_count > size - i_offset)
+        {
+          continue;
+        }
+
+        const size_t index = static_cast<size_t>(&s - m_slots);
+        memcpy(o_data, m_data + index * m_slot_size + i_offset, i_count);
+
+        /* a writer took the slot during the copy */
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) != seq)
+        {
+          pending = true;
+          continue;
+        }
+
+        /* the stamp line is shared by all processes, rewrite it only when stale */
+        const uint32_t now = m_header->clock.load(std::memory_order_relaxed);
+        if (s.stamp.load(std::memory_order_relaxed) != now)
+        {
+          s.stamp.store(now, std::memory_order_relaxed);
+        }
+
+        return true;
+      }
+
+      /* the caller decodes the span and passes it to Insert() */
+      if (pending == false && take_slot(i_key, set) != nullptr)
+      {
+        return false;
+      }
+
+      if (std::chrono::steady_clock::now() >= deadline)
+      {
+        break;
+      }
+      std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int>(WAIT_STEP)));
+    }
+
+    return false;
+  }
+
+  void ZppShmSpanCache::Insert(const ZppSpanKey & i_key, const uint8_t * i_data, const size_t i_size)
+  {
+    if (m_header == nullptr || i_key.file == 0)
+    {
+      return;
+    }
+
+    slot * set = find_set(i_key);
+    slot * target = find_claim(i_key, set);
+    if (i_size > m_slot_size)
+    {
+      if (target != nullptr)
+      {
+        release(*target);
+      }
+      return;
+    }
+
+    if (target == nullptr)
+    {
+      target = take_slot(i_key, set);
+      if (target == nullptr)
+      {
+        return;
+      }
+    }
+
+    const size_t index = static_cast<size_t>(target - m_slots);
+    memcpy(m_data + index * m_slot_size, i_data, i_size);
+    target->size.store(i_size, std::memory_order_relaxed);
+    target->stamp.store(m_header->clock.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    target->seq.store(target->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  void ZppShmSpanCache::Cancel(const ZppSpanKey & i_key)
+  {
+    if (m_header == nullptr || i_key.file == 0)
+    {
+      return;
+    }
+
+    slot * target = find_claim(i_key, find_set(i_key));
+    if (target != nullptr)
+    {
+      release(*target);
+    }
+  }
+
+  ZppShmSpanCache::slot * ZppShmSpanCache::take_slot(const ZppSpanKey & i_key, slot * io_set)
+  {
+    /* the same span, an empty slot or the oldest one */
+    const uint32_t now = m_header->clock.load(std::memory_order_relaxed);
+    slot * victim = nullptr;
+    uint32_t victim_age = 0;
+    for (size_t way = 0; way < WAYS; ++way)
+    {
+      slot & s = io_set[way];
+      const uint64_t file = s.file.load(std::memory_order_relaxed);
+      if (file == i_key.file && s.offset.load(std::memory_order_relaxed) == i_key.offset)
+      {
+        victim = &s;
+        break;
+      }
+
+      /* a stamp newer than the clock read above counts as fresh */
+      uint32_t age = now - s.stamp.load(std::memory_order_relaxed);
+      if (file == 0)
+      {
+        age = UINT32_MAX;
+      }
+      else if (age > UINT32_MAX / 2)
+      {
+        age = 0;
+      }
+      if (victim == nullptr || age > victim_age)
+      {
+        victim = &s;
+        victim_age = age;
+      }
+    }
+
+    /* a slot left odd by a dead process is taken over */
+    uint64_t seq = victim->seq.load(std::memory_order_relaxed);
+    uint64_t owned = seq + 1;
+    if ((seq & 1) != 0)
+    {
+      if (is_alive(*victim) == true)
+      {
+        return nullptr;
+      }
+      owned = seq + 2;
+    }
+    if (victim->seq.compare_exchange_strong(seq, owned, std::memory_order_acq_rel) == false)
+    {
+      return nullptr;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    victim->writer.store(getpid(), std::memory_order_relaxed);
+    victim->size.store(0, std::memory_order_relaxed);
+    victim->file.store(i_key.file, std::memory_order_relaxed);
+    victim->offset.store(i_key.offset, std::memory_order_relaxed);
+    victim->stamp.store(now, std::memory_order_relaxed);
+
+    return victim;
+  }
+
+  ZppShmSpanCache::slot * ZppShmSpanCache::find_claim(const ZppSpanKey & i_key, slot * io_set)
+  {
+    const pid_t self = getpid();
+    for (size_t way = 0; way < WAYS; ++way)
+    {
+      slot & s = io_set[way];
+      if ((s.seq.load(std::memory_order_acquire) & 1) != 0
+          && s.writer.load(std::memory_order_relaxed) == self
+          && s.file.load(std::memory_order_relaxed) == i_key.file
+          && s.offset.load(std::memory_order_relaxed) == i_key.offset)
+      {
+        return &s;
+      }
+    }
+
+    return nullptr;
+  }
+
+  void ZppShmSpanCache::release(slot & io_slot)
+  {
+    io_slot.file.store(0, std::memory_order_relaxed);
+    io_slot.seq.store(io_slot.seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool ZppShmSpanCache::is_alive(slot & i_slot)
+  {
+    const pid_t writer = i_slot.writer.load(std::memory_order_relaxed);
+    return writer > 0 && (kill(writer, 0) == 0 || errno != ESRCH);
+  }
+
+  bool ZppShmSpanCache::IsReady()
+  {
+    return m_header != nullptr;
+  }
+
+  size_t ZppShmSpanCache::GetSlotSize()
+  {
+    return m_slot_size;
+  }
+
+  size_t ZppShmSpanCache::GetSlotCount()
+  {
+    return m_slot_count;
+  }
+
+  bool ZppShmSpanCache::Remove(const std::string & i_name)
+  {
+    return shm_unlink(i_name.c_str()) == 0;
+  }
+}
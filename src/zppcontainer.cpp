@@ -0,0 +1,655 @@
+#include "zppcontainer.hpp"
+
+#include <algorithm>
+#include <queue>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+
+#define HEADER_SIZE 20          /* magic, version, dictionary size, records per group */
+#define TRAILER_SIZE 32         /* table offset, record and group counts, magic */
+#define GROUP_ENTRY 16          /* group offset, compressed and uncompressed size */
+#define CONTAINER_VERSION 1
+
+namespace slx
+{
+  namespace
+  {
+    void put_le32(uint8_t * o_data, uint32_t i_value)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        o_data[i] = static_cast<uint8_t>(i_value >> (8 * i));
+      }
+    }
+
+    void put_le64(uint8_t * o_data, uint64_t i_value)
+    {
+      for (int i = 0; i < 8; ++i)
+      {
+        o_data[i] = static_cast<uint8_t>(i_value >> (8 * i));
+      }
+    }
+
+    uint32_t get_le32(const uint8_t * i_data)
+    {
+      uint32_t value = 0;
+      for (int i = 3; i >= 0; --i)
+      {
+        value = (value << 8) | i_data[i];
+      }
+      return value;
+    }
+
+    uint64_t get_le64(const uint8_t * i_data)
+    {
+      uint64_t value = 0;
+      for (int i = 7; i >= 0; --i)
+      {
+        value = (value << 8) | i_data[i];
+      }
+      return value;
+    }
+  }
+
+  ZppContainerWriter::ZppContainerWriter(const std::string & i_filename)
+  {
+    Open(i_filename);
+  }
+
+  ZppContainerWriter::~ZppContainerWriter()
+  {
+    Close();
+  }
+
+  int ZppContainerWriter::Open(const std::string & i_filename)
+  {
+    Close();
+
+    m_file = fopen(i_filename.c_str(), "wb");
+    if (m_file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    m_stream = {};
+    int ret_val = deflateInit2(&m_stream, m_compression_level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    if (ret_val != Z_OK)
+    {
+      fclose(m_file);
+      m_file = nullptr;
+      return ret_val;
+    }
+
+    uint8_t header[HEADER_SIZE];
+    memcpy(header, "ZPPCONT1", 8);
+    put_le32(header + 8, CONTAINER_VERSION);
+    put_le32(header + 12, static_cast<uint32_t>(m_dictionary.size()));
+    put_le32(header + 16, static_cast<uint32_t>(m_group_size));
+    if (fwrite(header, 1, HEADER_SIZE, m_file) != HEADER_SIZE
+        || (m_dictionary.empty() == false
+            && fwrite(m_dictionary.data(), 1, m_dictionary.size(), m_file) != m_dictionary.size()))
+    {
+      deflateEnd(&m_stream);
+      fclose(m_file);
+      m_file = nullptr;
+      return Z_ERRNO;
+    }
+
+    m_offset = HEADER_SIZE + m_dictionary.size();
+    m_group.clear();
+    m_table.clear();
+    m_ends.clear();
+    m_flag_error = false;
+    return Z_OK;
+  }
+
+  int ZppContainerWriter::Close()
+  {
+    if (m_file == nullptr)
+    {
+      return Z_OK;
+    }
+
+    /* the last group, unless it is complete and written already */
+    int ret_val = m_flag_error ? Z_ERRNO : Z_OK;
+    const size_t groups = (m_ends.size() + m_group_size - 1) / m_group_size;
+    while (ret_val == Z_OK && m_table.size() < groups * GROUP_ENTRY)
+    {
+      ret_val = compress_group();
+    }
+
+    if (ret_val == Z_OK)
+    {
+      std::vector<uint8_t> ends(m_ends.size() * 4);
+      for (size_t i = 0; i < m_ends.size(); ++i)
+      {
+        put_le32(ends.data() + i * 4, m_ends[i]);
+      }
+
+      uint8_t trailer[TRAILER_SIZE];
+      put_le64(trailer, m_offset);
+      put_le64(trailer + 8, m_ends.size());
+      put_le64(trailer + 16, groups);
+      memcpy(trailer + 24, "ZPPCEND1", 8);
+
+      if ((m_table.empty() == false
+           && fwrite(m_table.data(), 1, m_table.size(), m_file) != m_table.size())
+          || (ends.empty() == false
+              && fwrite(ends.data(), 1, ends.size(), m_file) != ends.size())
+          || fwrite(trailer, 1, TRAILER_SIZE, m_file) != TRAILER_SIZE)
+      {
+        ret_val = Z_ERRNO;
+      }
+    }
+
+    if (fclose(m_file) != 0 && ret_val == Z_OK)
+    {
+      ret_val = Z_ERRNO;
+    }
+
+    deflateEnd(&m_stream);
+    m_stream = {};
+    m_file = nullptr;
+    m_flag_error = true;
+    m_group.clear();
+    m_output.clear();
+    m_table.clear();
+    return ret_val;
+  }
+
+  ssize_t ZppContainerWriter::Write(const uint8_t * i_data, const size_t i_size)
+  {
+    if (IsReady() == false || (i_data == nullptr && i_size != 0))
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_size > UINT32_MAX - m_group.size())
+    {
+      return Z_BUF_ERROR;
+    }
+
+    m_group.insert(m_group.end(), i_data, i_data + i_size);
+    m_ends.push_back(static_cast<uint32_t>(m_group.size()));
+
+    const ssize_t index = static_cast<ssize_t>(m_ends.size() - 1);
+    if (m_ends.size() % m_group_size == 0)
+    {
+      int ret_val = compress_group();
+      if (ret_val != Z_OK)
+      {
+        return ret_val;
+      }
+    }
+
+    return index;
+  }
+
+  ssize_t ZppContainerWriter::Write(const std::vector<uint8_t> & i_data)
+  {
+    return Write(i_data.data(), i_data.size());
+  }
+
+  size_t ZppContainerWriter::GetRecordCount()
+  {
+    return m_ends.size();
+  }
+
+  int ZppContainerWriter::SetDictionary(const std::vector<uint8_t> & i_dictionary)
+  {
+    /* the header and the groups already written use the dictionary */
+    if (m_file != nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    size_t skip = i_dictionary.size() > MAX_DICTIONARY ? i_dictionary.size() - MAX_DICTIONARY : 0;
+    m_dictionary.assign(i_dictionary.begin() + skip, i_dictionary.end());
+    return Z_OK;
+  }
+
+  const std::vector<uint8_t> & ZppContainerWriter::GetDictionary()
+  {
+    return m_dictionary;
+  }
+
+  size_t ZppContainerWriter::GetGroupSize()
+  {
+    return m_group_size;
+  }
+
+  int ZppContainerWriter::SetGroupSize(size_t i_size)
+  {
+    if (m_file != nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_size == 0)
+    {
+      return Z_STREAM_ERROR;
+    }
+
+    m_group_size = i_size;
+    return Z_OK;
+  }
+
+  int ZppContainerWriter::GetCompressionLevel()
+  {
+    return m_compression_level;
+  }
+
+  void ZppContainerWriter::SetCompressionLevel(int i_level)
+  {
+    m_compression_level = i_level;
+  }
+
+  bool ZppContainerWriter::IsReady()
+  {
+    if (m_file == nullptr || ferror(m_file))
+    {
+      return false;
+    }
+
+    return m_flag_error == false;
+  }
+
+  int ZppContainerWriter::compress_group()
+  {
+    int ret_val = deflateReset(&m_stream);
+    if (ret_val == Z_OK && m_dictionary.empty() == false)
+    {
+      ret_val = deflateSetDictionary(&m_stream, m_dictionary.data(), static_cast<uInt>(m_dictionary.size()));
+    }
+    if (ret_val != Z_OK)
+    {
+      m_flag_error = true;
+      return ret_val;
+    }
+
+    m_output.resize(deflateBound(&m_stream, m_group.size()));
+    m_stream.next_in = m_group.data();
+    m_stream.avail_in = static_cast<uInt>(m_group.size());
+    m_stream.next_out = m_output.data();
+    m_stream.avail_out = static_cast<uInt>(m_output.size());
+
+    /* the output buffer holds deflateBound() bytes, one call finishes */
+    ret_val = deflate(&m_stream, Z_FINISH);
+    if (ret_val != Z_STREAM_END)
+    {
+      m_flag_error = true;
+      return ret_val == Z_OK ? Z_BUF_ERROR : ret_val;
+    }
+
+    const size_t size = m_output.size() - m_stream.avail_out;
+    if (fwrite(m_output.data(), 1, size, m_file) != size)
+    {
+      m_flag_error = true;
+      return Z_ERRNO;
+    }
+
+    uint8_t entry[GROUP_ENTRY];
+    put_le64(entry, m_offset);
+    put_le32(entry + 8, static_cast<uint32_t>(size));
+    put_le32(entry + 12, static_cast<uint32_t>(m_group.size()));
+    m_table.insert(m_table.end(), entry, entry + GROUP_ENTRY);
+
+    m_offset += size;
+    m_group.clear();
+    return Z_OK;
+  }
+
+  std::vector<uint8_t> ZppContainerWriter::TrainDictionary(const std::vector<std::vector<uint8_t>> & i_samples, const size_t i_size)
+  {
+    /* segments of SEGMENT bytes scored by the number of samples containing
+       each of their GRAM byte substrings, the greedy choice of the best
+       segment discounts its substrings from the remaining ones */
+    static const size_t GRAM = 8;
+    static const size_t SEGMENT = 64;
+    static const size_t STEP = 16;
+
+    const size_t size = i_size < MAX_DICTIONARY ? i_size : MAX_DICTIONARY;
+    auto gram = [](const uint8_t * i_data)
+    {
+      uint64_t value;
+      memcpy(&value, i_data, GRAM);
+      return value;
+    };
+
+    std::unordered_map<uint64_t, uint32_t> counts;
+    for (const std::vector<uint8_t> & sample : i_samples)
+    {
+      std::unordered_set<uint64_t> seen;
+      for (size_t i = 0; i + GRAM <= sample.size(); ++i)
+      {
+        if (seen.insert(gram(sample.data() + i)).second == true)
+        {
+          ++counts[gram(sample.data() + i)];
+        }
+      }
+    }
+
+    struct segment
+    {
+      uint64_t score;
+      size_t sample;
+      size_t offset;
+      size_t length;
+
+      bool operator < (const segment & i_other) const
+      {
+        return score < i_other.score;
+      }
+    };
+
+    auto score = [&](const segment & i_segment)
+    {
+      uint64_t value = 0;
+      const uint8_t * data = i_samples[i_segment.sample].data() + i_segment.offset;
+      for (size_t i = 0; i + GRAM <= i_segment.length; ++i)
+      {
+        auto it = counts.find(gram(data + i));
+        if (it != counts.end() && it->second > 1)
+        {
+          value += it->second;
+        }
+      }
+      return value;
+    };
+
+    std::priority_queue<segment> queue;
+    for (size_t s = 0; s < i_samples.size(); ++s)
+    {
+      for (size_t offset = 0; offset + GRAM <= i_samples[s].size(); offset += STEP)
+      {
+        segment item = {0, s, offset, std::min(SEGMENT, i_samples[s].size() - offset)};
+        item.score = score(item);
+        if (item.score != 0)
+        {
+          queue.push(item);
+        }
+      }
+    }
+
+    std::vector<segment> chosen;
+    size_t total = 0;
+    while (queue.empty() == false && total < size)
+    {
+      segment best = queue.top();
+      queue.pop();
+
+      /* scores only go down, a stale one is recomputed and queued again */
+      uint64_t current = score(best);
+      if (current != best.score)
+      {
+        best.score = current;
+        if (current != 0)
+        {
+          queue.push(best);
+        }
+        continue;
+      }
+
+      const uint8_t * data = i_samples[best.sample].data() + best.offset;
+      for (size_t i = 0; i + GRAM <= best.length; ++i)
+      {
+        counts.erase(gram(data + i));
+      }
+
+      best.length = std::min(best.length, size - total);
+      chosen.push_back(best);
+      total += best.length;
+    }
+
+    /* the best segments end up closest to the data */
+    std::vector<uint8_t> dictionary;
+    dictionary.reserve(total);
+    for (auto it = chosen.rbegin(); it != chosen.rend(); ++it)
+    {
+      const uint8_t * data = i_samples[it->sample].data() + it->offset;
+      dictionary.insert(dictionary.end(), data, data + it->length);
+    }
+
+    return dictionary;
+  }
+
+  ZppContainerReader::ZppContainerReader(const std::string & i_filename)
+  {
+    Open(i_filename);
+  }
+
+  int ZppContainerReader::Open(const std::string & i_filename)
+  {
+    Close();
+
+    ZppFileSource * source = new ZppFileSource(i_filename);
+    if (source->IsReady() == false)
+    {
+      delete source;
+      return Z_ERRNO;
+    }
+
+    int ret_val = Open(source);
+    m_own_source.reset(source);
+    if (ret_val != Z_OK)
+    {
+      Close();
+    }
+    return ret_val;
+  }
+
+  int ZppContainerReader::Open(ZppSource * i_source)
+  {
+    Close();
+
+    if (i_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    /* the table is found from the end of the data */
+    ZppFileId id;
+    if (i_source->GetFileId(id) == false && i_source->Map(0, id.size) == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    uint8_t header[HEADER_SIZE];
+    uint8_t trailer[TRAILER_SIZE];
+    if (id.size < HEADER_SIZE + TRAILER_SIZE
+        || i_source->ReadAt(header, HEADER_SIZE, 0) != HEADER_SIZE
+        || i_source->ReadAt(trailer, TRAILER_SIZE, static_cast<off_t>(id.size - TRAILER_SIZE)) != TRAILER_SIZE)
+    {
+      return Z_ERRNO;
+    }
+
+    if (memcmp(header, "ZPPCONT1", 8) != 0 || get_le32(header + 8) != CONTAINER_VERSION
+        || memcmp(trailer + 24, "ZPPCEND1", 8) != 0)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    const size_t dictionary = get_le32(header + 12);
+    const size_t group_size = get_le32(header + 16);
+    const uint64_t table = get_le64(trailer);
+    const uint64_t records = get_le64(trailer + 8);
+    const uint64_t groups = get_le64(trailer + 16);
+    /* the counts are bounded by the file size first, so that the sizes
+       computed from them cannot wrap around */
+    if (dictionary > ZppContainerWriter::MAX_DICTIONARY || group_size == 0
+        || table > id.size || records > id.size / 4 || groups > id.size / GROUP_ENTRY
+        || groups != (records + group_size - 1) / group_size
+        || table < HEADER_SIZE + dictionary
+        || table + groups * GROUP_ENTRY + records * 4 + TRAILER_SIZE != id.size)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    m_dictionary.resize(dictionary);
+    std::vector<uint8_t> data(groups * GROUP_ENTRY + records * 4);
+    if (i_source->ReadAt(m_dictionary.data(), dictionary, HEADER_SIZE) != static_cast<ssize_t>(dictionary)
+        || i_source->ReadAt(data.data(), data.size(), static_cast<off_t>(table)) != static_cast<ssize_t>(data.size()))
+    {
+      Close();
+      return Z_ERRNO;
+    }
+
+    m_groups.resize(groups);
+    for (size_t i = 0; i < groups; ++i)
+    {
+      const uint8_t * entry = data.data() + i * GROUP_ENTRY;
+      m_groups[i] = {get_le64(entry), get_le32(entry + 8), get_le32(entry + 12)};
+      if (m_groups[i].offset > table || m_groups[i].size > table - m_groups[i].offset)
+      {
+        Close();
+        return Z_DATA_ERROR;
+      }
+    }
+
+    m_ends.resize(records);
+    const uint8_t * ends = data.data() + groups * GROUP_ENTRY;
+    for (size_t i = 0; i < records; ++i)
+    {
+      m_ends[i] = get_le32(ends + i * 4);
+      const uint32_t start = i % group_size == 0 ? 0 : m_ends[i - 1];
+      if (m_ends[i] < start || m_ends[i] > m_groups[i / group_size].length)
+      {
+        Close();
+        return Z_DATA_ERROR;
+      }
+    }
+
+    m_group_size = group_size;
+    m_source = i_source;
+    return Z_OK;
+  }
+
+  void ZppContainerReader::Close()
+  {
+    m_source = nullptr;
+    m_own_source.reset();
+    m_dictionary.clear();
+    m_group_size = 0;
+    m_groups.clear();
+    m_ends.clear();
+  }
+
+  size_t ZppContainerReader::GetRecordCount()
+  {
+    return m_ends.size();
+  }
+
+  ssize_t ZppContainerReader::ReadRecord(const size_t i_index, std::vector<uint8_t> & o_data)
+  {
+    if (IsReady() == false || i_index >= m_ends.size())
+    {
+      return Z_ERRNO;
+    }
+
+    /* only the group up to the end of the record is decoded */
+    const uint32_t start = i_index % m_group_size == 0 ? 0 : m_ends[i_index - 1];
+    const uint32_t end = m_ends[i_index];
+    int ret_val = decode_group(i_index / m_group_size, end, o_data);
+    if (ret_val != Z_OK)
+    {
+      o_data.clear();
+      return ret_val;
+    }
+
+    o_data.erase(o_data.begin(), o_data.begin() + start);
+    return static_cast<ssize_t>(o_data.size());
+  }
+
+  ssize_t ZppContainerReader::ReadRecords(const size_t i_first, const size_t i_count, std::vector<std::vector<uint8_t>> & o_records)
+  {
+    o_records.clear();
+    if (IsReady() == false || i_first > m_ends.size())
+    {
+      return Z_ERRNO;
+    }
+
+    const size_t last = i_first + std::min(i_count, m_ends.size() - i_first);
+    std::vector<uint8_t> data;
+    size_t decoded = static_cast<size_t>(-1);
+    for (size_t i = i_first; i < last; ++i)
+    {
+      const size_t number = i / m_group_size;
+      if (number != decoded)
+      {
+        /* up to the last record needed from this group */
+        const size_t tail = std::min(last, (number + 1) * m_group_size) - 1;
+        int ret_val = decode_group(number, m_ends[tail], data);
+        if (ret_val != Z_OK)
+        {
+          o_records.clear();
+          return ret_val;
+        }
+        decoded = number;
+      }
+
+      const uint32_t start = i % m_group_size == 0 ? 0 : m_ends[i - 1];
+      o_records.emplace_back(data.begin() + start, data.begin() + m_ends[i]);
+    }
+
+    return static_cast<ssize_t>(o_records.size());
+  }
+
+  const std::vector<uint8_t> & ZppContainerReader::GetDictionary()
+  {
+    return m_dictionary;
+  }
+
+  bool ZppContainerReader::IsReady()
+  {
+    return m_source != nullptr;
+  }
+
+  int ZppContainerReader::decode_group(size_t i_group, size_t i_length, std::vector<uint8_t> & o_data)
+  {
+    const group & here = m_groups[i_group];
+    std::vector<uint8_t> input(here.size);
+    if (m_source->ReadAt(input.data(), input.size(), static_cast<off_t>(here.offset)) != static_cast<ssize_t>(input.size()))
+    {
+      return Z_ERRNO;
+    }
+
+    z_stream strm = {};
+    int ret_val = inflateInit2(&strm, -15);
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+
+    /* a raw stream takes its dictionary before the first inflate() */
+    if (m_dictionary.empty() == false)
+    {
+      ret_val = inflateSetDictionary(&strm, m_dictionary.data(), static_cast<uInt>(m_dictionary.size()));
+    }
+
+    o_data.resize(i_length);
+    strm.next_in = input.data();
+    strm.avail_in = static_cast<uInt>(input.size());
+    strm.next_out = o_data.data();
+    strm.avail_out = static_cast<uInt>(o_data.size());
+    if (ret_val == Z_OK && i_length != 0)
+    {
+      ret_val = inflate(&strm, Z_SYNC_FLUSH);
+      if (ret_val == Z_STREAM_END || (ret_val == Z_OK && strm.avail_out == 0))
+      {
+        ret_val = Z_OK;
+      }
+      else if (ret_val >= 0)
+      {
+        ret_val = Z_DATA_ERROR;
+      }
+    }
+    inflateEnd(&strm);
+
+    if (ret_val == Z_OK && strm.avail_out != 0)
+    {
+      ret_val = Z_DATA_ERROR;
+    }
+    return ret_val;
+  }
+}
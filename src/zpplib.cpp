@@ -1,10 +1,171 @@
 #include "zpplib.hpp"
+#include "zppsimd.hpp"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <map>
+#include <mutex>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef ZPP_WITH_ZSTD
+#include <zstd.h>
+#endif
 
 #define windowBits 15
 #define GZIP_ENCODING 16
+#define BLOCK_HEADER 24         /* gzip header with the block sizes field */
+#define BLOCK_TRAILER 8         /* gzip trailer */
+#define DEFLATE_MEMORY ((1 << (windowBits + 2)) + (1 << (8 + 9)))  /* deflate state, see zconf.h */
+#define INDEX_HEADER 64         /* header of a saved index */
+#define INDEX_POINT 20          /* access point of a saved index, without window */
+#define INDEX_VERSION 2
+#define SPLIT_HEADER 100        /* serialized split without window */
+#define SPLIT_VERSION 2
+#define SPLIT_CHECK 4096        /* compressed bytes covered by the check of a split */
+#define GZIP_BLOCKS 1           /* index of independent gzip members */
+#define ZSTD_FRAMES 2           /* index of zstd frames */
+#define ZSTD_FRAME_SIZE 1048576 /* default uncompressed size of a zstd frame */
+#define SEEK_HEADER 8           /* skippable frame header of the seek table */
+#define SEEK_ENTRY 8            /* seek table entry without checksum */
+#define SEEK_FOOTER 9           /* number of frames, descriptor and magic */
+#define SEEK_TABLE_MAGIC 0x184D2A5EU
+#define SEEKABLE_MAGIC 0x8F92EAB1U
+#define ZSTD_FRAME_MAGIC 0xFD2FB528U
 
 namespace slx
 {
+  namespace
+  {
+    /* guards the LRU list of windows and the windows of all indexes */
+    std::mutex window_mutex;
+
+    /* complete indexes of files by identity, shared by the readers of a file */
+    std::mutex registry_mutex;
+    std::map<std::pair<ZppFileId, off_t>, std::weak_ptr<void>> registry;
+
+    void put_le32(unsigned char * o_data, uint32_t i_value)
+    {
+      o_data[0] = static_cast<unsigned char>(i_value);
+      o_data[1] = static_cast<unsigned char>(i_value >> 8);
+      o_data[2] = static_cast<unsigned char>(i_value >> 16);
+      o_data[3] = static_cast<unsigned char>(i_value >> 24);
+    }
+
+    uint32_t get_le32(const unsigned char * i_data)
+    {
+      return static_cast<uint32_t>(i_data[0])
+          | (static_cast<uint32_t>(i_data[1]) << 8)
+          | (static_cast<uint32_t>(i_data[2]) << 16)
+          | (static_cast<uint32_t>(i_data[3]) << 24);
+    }
+
+    void put_le64(unsigned char * o_data, uint64_t i_value)
+    {
+      put_le32(o_data, static_cast<uint32_t>(i_value));
+      put_le32(o_data + 4, static_cast<uint32_t>(i_value >> 32));
+    }
+
+    uint64_t get_le64(const unsigned char * i_data)
+    {
+      return get_le32(i_data) | (static_cast<uint64_t>(get_le32(i_data + 4)) << 32);
+    }
+
+    /* CRC-32 of the compressed data a split starts with, the same on any
+       copy of the file, unlike its device and inode */
+    int split_check(ZppSource * i_source, uint64_t i_offset, uint32_t & o_check)
+    {
+      unsigned char data[SPLIT_CHECK];
+      ssize_t got = i_source->ReadAt(data, SPLIT_CHECK, static_cast<off_t>(i_offset));
+      if (got < 0)
+      {
+        return Z_ERRNO;
+      }
+
+      o_check = static_cast<uint32_t>(crc32_z(crc32_z(0L, Z_NULL, 0), data, static_cast<size_t>(got)));
+      return Z_OK;
+    }
+
+    /* gzip member header of a block: FEXTRA with one 'ZP' subfield holding
+       the member size and the uncompressed size, little endian */
+    void put_block_header(unsigned char * o_header, uint32_t i_csize, uint32_t i_usize)
+    {
+      static const unsigned char fixed[16] =
+      {
+        0x1f, 0x8b, 8, 4,       /* magic, deflate, FEXTRA */
+        0, 0, 0, 0, 0, 255,     /* no mtime, no xfl, unknown os */
+        12, 0,                  /* XLEN */
+        'Z', 'P', 8, 0          /* subfield id and length */
+      };
+      memcpy(o_header, fixed, sizeof(fixed));
+      put_le32(o_header + 16, i_csize);
+      put_le32(o_header + 20, i_usize);
+    }
+
+    bool get_block_header(const unsigned char * i_header, uint32_t & o_csize, uint32_t & o_usize)
+    {
+      if (i_header[0] != 0x1f || i_header[1] != 0x8b || i_header[2] != 8
+          || i_header[3] != 4 || i_header[10] != 12 || i_header[11] != 0
+          || i_header[12] != 'Z' || i_header[13] != 'P'
+          || i_header[14] != 8 || i_header[15] != 0)
+      {
+        return false;
+      }
+
+      o_csize = get_le32(i_header + 16);
+      o_usize = get_le32(i_header + 20);
+      return o_csize >= BLOCK_HEADER + BLOCK_TRAILER;
+    }
+
+#ifdef ZPP_WITH_ZSTD
+    /* decompression contexts are kept per thread between cursors */
+    struct zstd_contexts
+    {
+      std::vector<ZSTD_DCtx *> free;
+
+      ~zstd_contexts()
+      {
+        for (ZSTD_DCtx * dctx : free)
+        {
+          ZSTD_freeDCtx(dctx);
+        }
+      }
+    };
+
+    thread_local zstd_contexts zstd_pool;
+
+    ZSTD_DCtx * take_dctx()
+    {
+      if (zstd_pool.free.empty() == true)
+      {
+        return ZSTD_createDCtx();
+      }
+
+      ZSTD_DCtx * dctx = zstd_pool.free.back();
+      zstd_pool.free.pop_back();
+      return dctx;
+    }
+
+    void give_dctx(ZSTD_DCtx * i_dctx)
+    {
+      ZSTD_DCtx_reset(i_dctx, ZSTD_reset_session_only);
+      zstd_pool.free.push_back(i_dctx);
+    }
+
+    int zstd_error(size_t i_code)
+    {
+      return ZSTD_getErrorCode(i_code) == ZSTD_error_memory_allocation ? Z_MEM_ERROR : Z_DATA_ERROR;
+    }
+#endif
+  }
+
+  ZppReader::window_lru ZppReader::lru = {NULL, NULL, 0, 0};
+
   ZppReader::ZppReader(const std::string & i_filename)
   {
     Open(i_filename);
@@ -15,24 +176,149 @@ namespace slx
     Open(i_file);
   }
 
+  ZppReader::ZppReader(const uint8_t * i_data, const size_t i_size)
+  {
+    Open(i_data, i_size);
+  }
+
+  ZppReader::ZppReader(ZppReader && io_other)
+  {
+    *this = std::move(io_other);
+  }
+
   ZppReader::~ZppReader()
   {
     Close();
   }
 
+  ZppReader & ZppReader::operator = (ZppReader && io_other)
+  {
+    if (this == &io_other)
+    {
+      return *this;
+    }
+
+    Close();
+    io_other.WaitAsync();
+
+    m_filename = std::move(io_other.m_filename);
+    m_source = io_other.m_source;
+    m_own_source = std::move(io_other.m_own_source);
+    m_cur_pos = io_other.m_cur_pos;
+    m_index = io_other.m_index;
+    m_index_owner = std::move(io_other.m_index_owner);
+    m_buffsize_backward = io_other.m_buffsize_backward;
+    m_buffsize_forward = io_other.m_buffsize_forward;
+    m_flag_align_buffer = io_other.m_flag_align_buffer;
+    m_span = io_other.m_span;
+    m_buffer = std::move(io_other.m_buffer);
+    m_buffer_beg = io_other.m_buffer_beg;
+    m_pool = io_other.m_pool;
+    m_cache = io_other.m_cache;
+    m_file_key = io_other.m_file_key;
+    m_flag_follow = io_other.m_flag_follow;
+    m_io_policy = io_other.m_io_policy;
+    m_builder = io_other.m_builder;
+    m_lines = std::move(io_other.m_lines);
+    m_line_count = io_other.m_line_count;
+
+    /* the index and the builder belong to this object now */
+    io_other.m_index = nullptr;
+    io_other.m_builder = nullptr;
+    io_other.Close();
+
+    return *this;
+  }
+
+  ZppReader ZppReader::Clone()
+  {
+    ZppReader clone;
+    clone.m_buffsize_backward = m_buffsize_backward;
+    clone.m_buffsize_forward = m_buffsize_forward;
+    clone.m_flag_align_buffer = m_flag_align_buffer;
+    clone.m_span = m_span;
+    clone.m_pool = m_pool;
+    clone.m_cache = m_cache;
+    clone.m_flag_follow = m_flag_follow;
+    clone.m_io_policy = m_io_policy;
+
+    if (IsReady() == false)
+    {
+      return clone;
+    }
+
+    /* a file gets its own descriptor, other sources are shared */
+    std::shared_ptr<ZppSource> source = m_own_source;
+    ZppFileSource * file = dynamic_cast<ZppFileSource *>(m_source);
+    if (m_filename.empty() == false)
+    {
+      file = new ZppFileSource(m_filename);
+      source.reset(file);
+    }
+    else if (file != nullptr)
+    {
+      file = new ZppFileSource(dup(file->GetFd()), true);
+      source.reset(file);
+    }
+
+    if (file != nullptr && file->IsReady() == false)
+    {
+      return clone;
+    }
+    if (file != nullptr)
+    {
+      clone.ApplyIoPolicy(file);
+    }
+
+    /* a source passed to Open() by pointer is not owned and is shared as is */
+    ZppSource * shared = (source != nullptr) ? source.get() : m_source;
+
+    /* the index of a growing file changes, the clone builds its own */
+    if (m_index_owner == nullptr)
+    {
+      clone.m_filename = m_filename;
+      clone.m_own_source = source;
+      clone.m_source = shared;
+      clone.BuildIndex();
+      return clone;
+    }
+
+    /* the file must not have been replaced since the index was built */
+    ZppFileId id;
+    if (m_file_key != 0
+        && (shared->GetFileId(id) == false || id.Hash() != m_file_key))
+    {
+      return clone;
+    }
+
+    clone.m_filename = m_filename;
+    clone.m_own_source = source;
+    clone.m_source = shared;
+    clone.m_index = m_index;
+    clone.m_index_owner = m_index_owner;
+    clone.m_file_key = m_file_key;
+    clone.m_lines = m_lines;
+    clone.m_line_count = m_line_count;
+    return clone;
+  }
+
   int ZppReader::Open(const std::string & i_filename, bool i_build_index)
   {
     Close();
 
     m_cur_pos = 0;
 
-    m_file = fopen(i_filename.c_str(), "rb");
-    if (m_file == nullptr)
+    ZppFileSource * source = new ZppFileSource(i_filename);
+    m_own_source.reset(source);
+    if (source->IsReady() == false)
     {
+      m_own_source.reset();
       return Z_ERRNO;
     }
 
+    m_source = source;
     m_filename = i_filename;
+    ApplyIoPolicy(source);
 
     if (i_build_index == true)
     {
@@ -48,7 +334,15 @@ namespace slx
 
     m_cur_pos = 0;
 
-    m_file = i_file;
+    if (i_file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    ZppFileSource * source = new ZppFileSource(i_file);
+    m_own_source.reset(source);
+    m_source = source;
+    ApplyIoPolicy(source);
 
     if (i_build_index == true)
     {
@@ -58,24 +352,66 @@ namespace slx
     return Z_OK;
   }
 
-  void ZppReader::Close()
+  int ZppReader::Open(const uint8_t * i_data, const size_t i_size, bool i_build_index)
   {
-    if (m_index != nullptr)
+    Close();
+
+    m_cur_pos = 0;
+
+    if (i_data == nullptr)
     {
-      free_index(m_index);
-      m_index = nullptr;
+      return Z_ERRNO;
     }
 
-    if (m_file != nullptr && m_filename.empty() == false)
+    m_own_source.reset(new ZppMemorySource(i_data, i_size));
+    m_source = m_own_source.get();
+
+    if (i_build_index == true)
     {
-      fclose(m_file);
+      return BuildIndex();
     }
 
-    m_file = nullptr;
+    return Z_OK;
+  }
+
+  int ZppReader::Open(ZppSource * i_source, bool i_build_index)
+  {
+    Close();
+
+    m_cur_pos = 0;
+
+    if (i_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    m_source = i_source;
+
+    if (i_build_index == true)
+    {
+      return BuildIndex();
+    }
+
+    return Z_OK;
+  }
+
+  void ZppReader::Close()
+  {
+    /* asynchronous reads still use the file and the index */
+    WaitAsync();
+
+    ReleaseIndex();
+    close_buffer_cursor();
+
+    m_source = nullptr;
+    m_own_source.reset();
+    m_file_key = 0;
     m_filename.clear();
     m_cur_pos = 0;
     m_buffer.clear();
     m_buffer_beg = 0;
+    m_lines.clear();
+    m_line_count = 0;
   }
 
   ssize_t ZppReader::Read(std::vector<uint8_t> & o_data)
@@ -138,10 +474,22 @@ namespace slx
       return Z_ERRNO;
     }
 
+    /* a followed file may not have the rest of the stream yet */
+    if (i_offset >= m_index->uncompressed_size)
+    {
+      return 0;
+    }
+    const size_t count = std::min(i_count, m_index->uncompressed_size - i_offset);
+
+    if (m_cache != nullptr && m_file_key != 0)
+    {
+      return ReadCached(o_data, count, i_offset);
+    }
+
     ssize_t ret = 0;
 
-    ret = extract(m_file, m_index, static_cast<off_t>(i_offset)
-                  , o_data, static_cast<int>(i_count));
+    ret = extract(m_source, m_index, static_cast<off_t>(i_offset)
+                  , o_data, static_cast<int>(count));
 
     if (ret < 0)
     {
@@ -151,494 +499,3292 @@ namespace slx
     return ret;
   }
 
-  int ZppReader::SetPos(const size_t i_pos)
+  std::future<ssize_t> ZppReader::ReadOffsetAsync(uint8_t * o_data, const size_t i_count, const size_t i_offset, const ZppCancel & i_cancel)
   {
-    if (m_index == nullptr)
+    std::shared_ptr<std::promise<ssize_t>> promise = std::make_shared<std::promise<ssize_t>>();
+    std::future<ssize_t> result = promise->get_future();
+
+    int ret = ReadOffsetAsync(o_data, i_count, i_offset
+                              , [promise](ssize_t i_ret) { promise->set_value(i_ret); }
+                              , i_cancel);
+    if (ret != Z_OK)
     {
-      return Z_ERRNO;
+      promise->set_value(ret);
     }
 
-    if (i_pos > m_index->uncompressed_size /*|| i_pos < 0*/)
+    return result;
+  }
+
+  int ZppReader::ReadOffsetAsync(uint8_t * o_data, const size_t i_count, const size_t i_offset, std::function<void(ssize_t)> i_callback, const ZppCancel & i_cancel)
+  {
+    if (IsReady() == false || o_data == nullptr)
     {
       return Z_ERRNO;
     }
 
-    m_cur_pos = i_pos;
+    {
+      std::lock_guard<std::mutex> lock(m_async_mutex);
+      ++m_async_pending;
+    }
 
-    return Z_OK;
-  }
+    int ret = GetThreadPool().Submit([this, o_data, i_count, i_offset, i_callback, i_cancel]()
+    {
+      ssize_t ret_val = ZPP_CANCELED;
+      if (i_cancel.IsCanceled() == false)
+      {
+        ret_val = ReadOffset(o_data, i_count, i_offset);
+      }
 
-  size_t ZppReader::GetPos()
-  {
-    return m_cur_pos;
-  }
+      /* the reader may be closed as soon as the lock is released, so the
+         waiter is woken while it is still held */
+      {
+        std::lock_guard<std::mutex> lock(m_async_mutex);
+        --m_async_pending;
+        m_async_cond.notify_all();
+      }
 
-  size_t ZppReader::GetSize()
-  {
-    if (m_index == nullptr)
+      i_callback(ret_val);
+    });
+
+    if (ret != Z_OK)
     {
-      return 0;
+      std::lock_guard<std::mutex> lock(m_async_mutex);
+      --m_async_pending;
+      m_async_cond.notify_all();
     }
 
-    return m_index->uncompressed_size;
+    return ret;
   }
 
-  int ZppReader::SetBufferSize(const size_t i_size_backward, const size_t i_size_forward)
+  ssize_t ZppReader::ReadOffsets(const std::vector<std::pair<size_t, size_t>> & i_ranges, uint8_t * o_data)
   {
-    m_buffsize_backward = i_size_backward;
-    m_buffsize_forward = i_size_forward;
+    if (IsReady() == false || o_data == nullptr)
+    {
+      return Z_ERRNO;
+    }
 
-    return 0;
-  }
+    /* part of a range lying between two access points */
+    struct piece
+    {
+      size_t offset;
+      size_t count;
+      size_t dest;
+      int point;
+    };
+
+    std::vector<piece> pieces;
+    size_t dest = 0;
+    for (const std::pair<size_t, size_t> & range : i_ranges)
+    {
+      size_t offset = range.first;
+      size_t count = range.second;
+      if (offset > m_index->uncompressed_size || count > m_index->uncompressed_size - offset)
+      {
+        return Z_ERRNO;
+      }
 
-  size_t ZppReader::GetBufferSize()
-  {
-    return m_buffsize_backward + m_buffsize_forward + 1;
-  }
+      int point = find_point(m_index, static_cast<off_t>(offset));
+      while (count != 0)
+      {
+        size_t next = m_index->uncompressed_size;
+        if (point + 1 < m_index->have)
+        {
+          next = static_cast<size_t>(m_index->list[point + 1].out);
+        }
 
-  bool ZppReader::GetFlagAllignBuffer()
-  {
-    return m_flag_align_buffer;
-  }
+        size_t part = std::min(count, next - offset);
+        pieces.push_back({offset, part, dest, point});
+        offset += part;
+        count -= part;
+        dest += part;
+        ++point;
+      }
+    }
 
-  void ZppReader::SetFlagAllignBuffer(bool i_flag)
-  {
-    m_flag_align_buffer = i_flag;
-  }
+    std::stable_sort(pieces.begin(), pieces.end()
+                     , [](const piece & i_a, const piece & i_b) { return i_a.offset < i_b.offset; });
 
-  int ZppReader::BuildIndex()
-  {
-    if (m_index != nullptr)
+    /* pieces of one span are decoded by one task */
+    std::vector<std::pair<size_t, size_t>> groups;
+    for (size_t i = 0; i < pieces.size(); ++i)
     {
-      free_index(m_index);
-      m_index = nullptr;
+      if (i == 0 || pieces[i].point != pieces[i - 1].point)
+      {
+        groups.emplace_back(i, i);
+      }
+      groups.back().second = i + 1;
     }
 
-    return build_index(m_file, SPAN, &m_index);
-  }
+    std::vector<int> status(groups.size(), Z_OK);
+    GetThreadPool().ParallelFor(groups.size(), [&](size_t i_task)
+    {
+      struct cursor cur;
+      size_t first = groups[i_task].first;
+      int ret = cursor_open(m_source, m_index, static_cast<off_t>(pieces[first].offset), &cur);
 
-  const std::string &ZppReader::GetFilename()
-  {
-    return m_filename;
-  }
+      for (size_t i = first; i < groups[i_task].second && ret >= 0; ++i)
+      {
+        const piece & here = pieces[i];
 
-  bool ZppReader::IsReady()
-  {
-    if (m_file == nullptr || m_index == nullptr || ferror(m_file))
+        /* overlapping ranges need to go back */
+        if (static_cast<size_t>(cur.out) > here.offset)
+        {
+          cursor_close(&cur);
+          ret = cursor_open(m_source, m_index, static_cast<off_t>(here.offset), &cur);
+          if (ret < 0)
+          {
+            break;
+          }
+        }
+
+        ret = cursor_skip(&cur, static_cast<off_t>(here.offset));
+        if (ret < 0)
+        {
+          break;
+        }
+
+        ret = cursor_read(&cur, o_data + here.dest, static_cast<int>(here.count));
+        if (ret >= 0 && static_cast<size_t>(ret) != here.count)
+        {
+          ret = Z_DATA_ERROR;
+        }
+      }
+
+      cursor_close(&cur);
+      status[i_task] = ret < 0 ? ret : Z_OK;
+    });
+
+    for (int ret : status)
     {
-      return false;
+      if (ret < 0)
+      {
+        return ret;
+      }
     }
 
-    return true;
+    return static_cast<ssize_t>(dest);
   }
 
-  uint8_t ZppReader::operator [](const size_t i_pos)
+  ssize_t ZppReader::DecompressRange(uint8_t * o_data, const size_t i_count, const size_t i_offset)
   {
-    if (m_index == nullptr || m_file == nullptr)
+    if (IsReady() == false || o_data == nullptr)
     {
-      return 0x00;
+      return Z_ERRNO;
     }
 
-    if (/*i_pos < 0 ||*/ i_pos >= m_index->uncompressed_size)
+    if (i_offset >= m_index->uncompressed_size)
     {
-      return 0x00;
+      return 0;
     }
 
-    if (m_flag_align_buffer == true)
+    const size_t count = std::min(i_count, m_index->uncompressed_size - i_offset);
+    std::vector<std::pair<size_t, size_t>> spans;
+    GetSpans(i_offset, i_offset + count, spans);
+
+    std::vector<ssize_t> status(spans.size(), Z_OK);
+    GetThreadPool().ParallelFor(spans.size(), [&](size_t i_task)
     {
-      if (PopulateBufferAlign(i_pos) != Z_OK)
+      const size_t beg = spans[i_task].first;
+      const size_t size = spans[i_task].second - beg;
+
+      ssize_t ret = ReadOffset(o_data + (beg - i_offset), size, beg);
+      if (ret >= 0 && static_cast<size_t>(ret) != size)
       {
-        return 0x00;
+        ret = Z_DATA_ERROR;
       }
-    }
-    else
+      status[i_task] = ret;
+    });
+
+    for (ssize_t ret : status)
     {
-      if (PopulateBuffer(i_pos) != Z_OK)
+      if (ret < 0)
       {
-        return 0x00;
+        return ret;
       }
     }
 
-    if (i_pos - m_buffer_beg < m_buffer.size())
-    {
-      return m_buffer[i_pos - m_buffer_beg];
-    }
+    return static_cast<ssize_t>(count);
+  }
 
-    return 0x00;
+  ssize_t ZppReader::ReadArray(void * o_data, const size_t i_width, const size_t i_count, const size_t i_offset, const ZppByteOrder i_order)
+  {
+    return ReadColumn(o_data, i_width, i_count, i_offset, i_width, i_order);
   }
 
-  void ZppReader::free_index(ZppReader::access * index)
+  ssize_t ZppReader::ReadColumn(void * o_data, const size_t i_width, const size_t i_count, const size_t i_offset, const size_t i_stride, const ZppByteOrder i_order)
   {
-    if (index != NULL)
+    if (IsReady() == false || o_data == nullptr || i_stride < i_width
+        || (i_width != 1 && i_width != 2 && i_width != 4 && i_width != 8))
     {
-      free(index->list);
-      free(index);
+      return Z_ERRNO;
     }
-  }
 
-  ZppReader::access *ZppReader::addpoint(ZppReader::access * index, int bits, off_t in, off_t out, unsigned left, unsigned char * window)
-  {
-    struct point *next;
+    const size_t size = m_index->uncompressed_size;
+    if (i_offset >= size || size - i_offset < i_width)
+    {
+      return 0;
+    }
 
-    /* if list is empty, create it (start with eight points) */
-    if (index == NULL)
+    const size_t count = std::min(i_count, (size - i_offset - i_width) / i_stride + 1);
+    if (count == 0)
     {
-      index = (struct access*)malloc(sizeof(struct access));
-      if (index == NULL) return NULL;
-      index->list = (struct point*)malloc(sizeof(struct point) << 3);
-      if (index->list == NULL)
-      {
-        free(index);
-        return NULL;
-      }
-      index->size = 8;
-      index->have = 0;
+      return 0;
     }
 
-    /* if list is full, make it bigger */
-    else if (index->have == index->size)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const bool swap = i_order == ZPP_ORDER_BIG;
+#else
+    const bool swap = i_order == ZPP_ORDER_LITTLE;
+#endif
+
+    /* every interval takes the elements that start in it, so an element on
+       a boundary is decoded by one task */
+    const size_t end = i_offset + (count - 1) * i_stride + i_width;
+    std::vector<std::pair<size_t, size_t>> spans;
+    GetSpans(i_offset, end, spans);
+
+    uint8_t * data = static_cast<uint8_t *>(o_data);
+    std::vector<ssize_t> status(spans.size(), Z_OK);
+    GetThreadPool().ParallelFor(spans.size(), [&](size_t i_task)
     {
-      index->size <<= 1;
-      next = (struct point*)realloc(index->list, sizeof(struct point) * index->size);
-      if (next == NULL)
+      const size_t first = (spans[i_task].first - i_offset + i_stride - 1) / i_stride;
+      const size_t last = std::min(count, (spans[i_task].second - i_offset + i_stride - 1) / i_stride);
+      if (first >= last)
       {
-        free_index(index);
-        return NULL;
+        return;
       }
-      index->list = next;
-    }
 
-    /* fill in entry and increment how many we have */
-    next = index->list + index->have;
-    next->bits = bits;
-    next->in = in;
-    next->out = out;
-    if (left)
-    {
-      memcpy(next->window, window + WINSIZE - left, left);
-    }
-    if (left < WINSIZE)
+      /* contiguous elements are decoded in place, records through a buffer
+         that stays with the worker thread */
+      const size_t bytes = (last - first - 1) * i_stride + i_width;
+      uint8_t * out = data + first * i_width;
+      uint8_t * in = out;
+      thread_local std::vector<uint8_t> records;
+      if (i_stride != i_width)
+      {
+        records.resize(bytes);
+        in = records.data();
+      }
+
+      ssize_t ret = ReadOffset(in, bytes, i_offset + first * i_stride);
+      if (ret >= 0 && static_cast<size_t>(ret) != bytes)
+      {
+        ret = Z_DATA_ERROR;
+      }
+      else if (ret >= 0 && in != out)
+      {
+        simd::gather(in, i_stride, i_width, last - first, out, swap);
+      }
+      else if (ret >= 0 && swap == true)
+      {
+        simd::byteswap(out, last - first, i_width);
+      }
+      status[i_task] = ret;
+    });
+
+    for (ssize_t ret : status)
     {
-      memcpy(next->window + left, window, WINSIZE - left);
+      if (ret < 0)
+      {
+        return ret;
+      }
     }
-    index->have++;
 
-    /* return list, possibly reallocated */
-    return index;
+    return static_cast<ssize_t>(count);
   }
 
-  int ZppReader::build_index(FILE * in, off_t span, ZppReader::access ** built)
+  ssize_t ZppReader::DecompressRange(const std::string & i_filename, const size_t i_count, const size_t i_offset)
   {
-    fseek(in, 0, SEEK_SET);
-    int ret;
-    off_t totin, totout;        /* our own total counters to avoid 4GB limit */
-    off_t last;                 /* totout value of last access point */
-    struct access *index;       /* access points being generated */
-    z_stream strm;
-    unsigned char input[CHUNK];
-    unsigned char window[WINSIZE];
+    if (IsReady() == false)
+    {
+      return Z_ERRNO;
+    }
 
-    /* initialize inflate */
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = 0;
-    strm.next_in = Z_NULL;
-    ret = inflateInit2(&strm, 47);      /* automatic zlib or gzip decoding */
-    if (ret != Z_OK)
+    size_t count = 0;
+    if (i_offset < m_index->uncompressed_size)
     {
-      return ret;
+      count = std::min(i_count, m_index->uncompressed_size - i_offset);
     }
 
-    /* inflate the input, maintain a sliding window, and build an index -- this
-         also validates the integrity of the compressed data using the check
-         information at the end of the gzip or zlib stream */
-    totin = totout = last = 0;
-    index = NULL;               /* will be allocated by first addpoint() */
-    strm.avail_out = 0;
-    do
+    int fd = open(i_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    ssize_t ret = static_cast<ssize_t>(count);
+    if (count != 0)
     {
-      /* get some compressed data from input file */
-      strm.avail_in = fread(input, 1, CHUNK, in);
-      if (ferror(in))
+      void * data = MAP_FAILED;
+      if (ftruncate(fd, static_cast<off_t>(count)) == 0)
       {
-        ret = Z_ERRNO;
-        goto build_index_error;
+        data = mmap(nullptr, count, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
       }
-      if (strm.avail_in == 0)
+
+      if (data == MAP_FAILED)
       {
-        ret = Z_DATA_ERROR;
-        goto build_index_error;
+        ret = Z_ERRNO;
       }
-      strm.next_in = input;
-
-      /* process all of that, or until end of stream */
-      do
+      else
       {
-        /* reset sliding window if necessary */
-        if (strm.avail_out == 0)
-        {
-          strm.avail_out = WINSIZE;
-          strm.next_out = window;
-        }
-
-        /* inflate until out of input, output, or at end of block --
-                 update the total input and output counters */
-        totin += strm.avail_in;
-        totout += strm.avail_out;
-        ret = inflate(&strm, Z_BLOCK);      /* return at end of block */
-        totin -= strm.avail_in;
-        totout -= strm.avail_out;
-        if (ret == Z_NEED_DICT)
-        {
-          ret = Z_DATA_ERROR;
-        }
-        if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
-        {
-          goto build_index_error;
-        }
-        if (ret == Z_STREAM_END)
-        {
-          break;
-        }
+        ret = DecompressRange(static_cast<uint8_t *>(data), count, i_offset);
+        munmap(data, count);
+      }
+    }
 
-        /* if at end of block, consider adding an index entry (note that if
-         data_type indicates an end-of-block, then all of the
-         uncompressed data from that block has been delivered, and none
-         of the compressed data after that block has been consumed,
-         except for up to seven bits) -- the totout == 0 provides an
-         entry point after the zlib or gzip header, and assures that the
-         index always has at least one access point; we avoid creating an
-         access point after the last block by checking bit 6 of data_type */
-        if ((strm.data_type & 128)
-            && !(strm.data_type & 64)
-            && (totout == 0 || totout - last > span))
-        {
-          index = addpoint(index, strm.data_type & 7, totin,
-                           totout, strm.avail_out, window);
-          if (index == NULL)
-          {
-            ret = Z_MEM_ERROR;
-            goto build_index_error;
-          }
-          last = totout;
-        }
-      } while (strm.avail_in != 0);
-    } while (ret != Z_STREAM_END);
-
-    /* clean up and return index (release unused entries in list) */
-    index->compressed_size = strm.total_in;
-    index->uncompressed_size = strm.total_out;
-    (void)inflateEnd(&strm);
-    index->list = (struct point*)realloc(index->list, sizeof(struct point) * index->have);
-    index->size = index->have;
-    *built = index;
-    return index->size;
+    if (close(fd) != 0 && ret >= 0)
+    {
+      ret = Z_ERRNO;
+    }
 
-    /* return error */
-build_index_error:
-    (void)inflateEnd(&strm);
-    if (index != NULL)
+    if (ret < 0)
     {
-      free_index(index);
+      unlink(i_filename.c_str());
     }
+
     return ret;
   }
 
-  int ZppReader::extract(FILE * in, ZppReader::access * index, off_t offset, unsigned char * buf, int len)
+  ssize_t ZppReader::DecompressRange(int i_fd, const size_t i_count, const size_t i_offset)
   {
-    int ret, skip;
-    z_stream strm;
-    struct point *here;
-    unsigned char input[CHUNK];
-    unsigned char discard[WINSIZE];
-
-    /* proceed only if something reasonable to do */
-    if (len < 0)
+    if (IsReady() == false || i_fd < 0)
     {
-      return 0;
+      return Z_ERRNO;
     }
 
-    /* find where in stream to start */
-    here = index->list;
-    ret = index->have;
-    while (--ret && here[1].out <= offset)
+    if (i_offset >= m_index->uncompressed_size)
     {
-      here++;
+      return 0;
     }
 
-    /* initialize file and inflate state to start there */
-    strm.zalloc = Z_NULL;
-    strm.zfree = Z_NULL;
-    strm.opaque = Z_NULL;
-    strm.avail_in = 0;
-    strm.next_in = Z_NULL;
-    ret = inflateInit2(&strm, -15);         /* raw inflate */
-    if (ret != Z_OK)
-    {
-      return ret;
-    }
-    ret = fseeko(in, here->in - (here->bits ? 1 : 0), SEEK_SET);
-    if (ret == -1)
-    {
-      goto extract_ret;
-    }
-    if (here->bits)
-    {
-      ret = getc(in);
-      if (ret == -1)
-      {
-        ret = ferror(in) ? Z_ERRNO : Z_DATA_ERROR;
-        goto extract_ret;
-      }
-      (void)inflatePrime(&strm, here->bits, ret >> (8 - here->bits));
-    }
-    (void)inflateSetDictionary(&strm, here->window, WINSIZE);
+    const size_t count = std::min(i_count, m_index->uncompressed_size - i_offset);
+    std::vector<std::pair<size_t, size_t>> spans;
+    GetSpans(i_offset, i_offset + count, spans);
 
-    /* skip uncompressed bytes until offset reached, then satisfy request */
-    offset -= here->out;
-    strm.avail_in = 0;
-    skip = 1;                               /* while skipping to offset */
-    do
+    /* a group of spans is decoded in parallel, then written in order */
+    ZppThreadPool & pool = GetThreadPool();
+    const size_t group = 2 * (pool.GetThreadCount() + 1);
+    std::vector<std::vector<uint8_t>> data(std::min(group, spans.size()));
+    std::vector<ssize_t> status(data.size());
+
+    for (size_t first = 0; first < spans.size(); first += group)
     {
-      /* define where to put uncompressed data, and how much */
-      if (offset == 0 && skip) /* at offset now */
+      const size_t tasks = std::min(group, spans.size() - first);
+      pool.ParallelFor(tasks, [&](size_t i_task)
       {
-        strm.avail_out = len;
-        strm.next_out = buf;
-        skip = 0;                       /* only do this once */
-      }
-      if (offset > WINSIZE) /* skip WINSIZE bytes */
-      {
-        strm.avail_out = WINSIZE;
-        strm.next_out = discard;
-        offset -= WINSIZE;
-      }
-      else if (offset != 0) /* last skip */
-      {
-        strm.avail_out = (unsigned)offset;
-        strm.next_out = discard;
-        offset = 0;
-      }
+        const std::pair<size_t, size_t> & span = spans[first + i_task];
+        data[i_task].resize(span.second - span.first);
 
-      /* uncompress until avail_out filled, or end of stream */
-      do
-      {
-        if (strm.avail_in == 0)
-        {
-          strm.avail_in = fread(input, 1, CHUNK, in);
-          if (ferror(in))
-          {
-            ret = Z_ERRNO;
-            goto extract_ret;
-          }
-          if (strm.avail_in == 0)
-          {
-            ret = Z_DATA_ERROR;
-            goto extract_ret;
-          }
-          strm.next_in = input;
-        }
-        ret = inflate(&strm, Z_NO_FLUSH);       /* normal inflate */
-        if (ret == Z_NEED_DICT)
+        ssize_t ret = ReadOffset(data[i_task], span.first);
+        if (ret >= 0 && static_cast<size_t>(ret) != data[i_task].size())
         {
           ret = Z_DATA_ERROR;
         }
-        if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+        status[i_task] = ret;
+      });
+
+      for (size_t i = 0; i < tasks; ++i)
+      {
+        if (status[i] < 0)
         {
-          goto extract_ret;
+          return status[i];
         }
-        if (ret == Z_STREAM_END)
+
+        const uint8_t * cur = data[i].data();
+        size_t left = data[i].size();
+        while (left != 0)
         {
-          break;
+          ssize_t done = write(i_fd, cur, left);
+          if (done < 0 && errno == EINTR)
+          {
+            continue;
+          }
+          if (done <= 0)
+          {
+            return Z_ERRNO;
+          }
+          cur += done;
+          left -= static_cast<size_t>(done);
         }
-      } while (strm.avail_out != 0);
-
-      /* if reach end of stream, then don't keep trying to get more */
-      if (ret == Z_STREAM_END)
-      {
-        break;
       }
+    }
 
-      /* do until offset reached and requested data read, or stream ends */
-    } while (skip);
+    return static_cast<ssize_t>(count);
+  }
 
-    /* compute number of uncompressed bytes read after offset */
-    ret = skip ? 0 : len - strm.avail_out;
+  ssize_t ZppReader::DecompressAll(uint8_t * o_data)
+  {
+    return DecompressRange(o_data, GetSize(), 0);
+  }
 
-    /* clean up and return bytes read or error */
-extract_ret:
-    (void)inflateEnd(&strm);
-    return ret;
+  ssize_t ZppReader::DecompressAll(const std::string & i_filename)
+  {
+    return DecompressRange(i_filename, GetSize(), 0);
   }
 
-  int ZppReader::PopulateBuffer(const size_t i_pos)
+  ssize_t ZppReader::DecompressAll(int i_fd)
   {
-    if (m_buffer.empty() == true
-        || m_buffer_beg > i_pos
-        || (m_buffer_beg + m_buffer.size()) <= i_pos)
+    return DecompressRange(i_fd, GetSize(), 0);
+  }
+
+  int ZppReader::Verify(size_t & o_offset, size_t & o_in)
+  {
+    if (IsReady() == false || m_builder != nullptr)
     {
-      size_t new_buff_size = 1;
-      if (m_buffsize_backward < i_pos)
-      {
-        m_buffer_beg = i_pos - m_buffsize_backward;
-        new_buff_size += m_buffsize_backward;
-      }
-      else
-      {
-        m_buffer_beg = 0;
-        new_buff_size += m_buffsize_backward - (i_pos + 1);
-      }
+      return Z_ERRNO;
+    }
 
-      if (m_buffsize_forward < m_index->uncompressed_size - i_pos)
-      {
-        new_buff_size += m_buffsize_forward;
-      }
-      else
-      {
-        new_buff_size += m_buffsize_forward - (m_index->uncompressed_size - i_pos);
-      }
+    struct access * index = m_index;
+    unsigned char trailer[BLOCK_HEADER];
 
-      m_buffer.resize(new_buff_size);
-      if (ReadOffset(m_buffer, m_buffer_beg) < 0)
+    /* a stream starting with the gzip magic carries CRC32 and ISIZE, a zlib
+       stream Adler-32 */
+    bool gzip = false;
+    if (index->blocks == 0)
+    {
+      if (m_source->ReadAt(trailer, 2, 0) != 2)
       {
         return Z_ERRNO;
       }
+      gzip = trailer[0] == 0x1f && trailer[1] == 0x8b;
     }
+    const bool adler = index->blocks == 0 && gzip == false;
 
-    return Z_OK;
-  }
+    struct span_check
+    {
+      int status = Z_OK;
+      uLong check = 0;
+      size_t count = 0;
+    };
 
-  int ZppReader::PopulateBufferAlign(const size_t i_pos)
-  {
-    if (m_buffer.empty() == true
-        || m_buffer_beg > i_pos
-        || (m_buffer_beg + m_buffer.size()) <= i_pos)
+    std::vector<span_check> result(static_cast<size_t>(index->have));
+    GetThreadPool().ParallelFor(result.size(), [&](size_t i_task)
     {
-      size_t new_buff_size = 0;
-      struct point * here = m_index->list;
-      int ret = m_index->have;
-      while (--ret && here[1].out <= static_cast<off_t>(i_pos))
+      span_check & res = result[i_task];
+      const int point = static_cast<int>(i_task);
+      const size_t beg = static_cast<size_t>(index->list[point].out);
+      size_t end = index->uncompressed_size;
+      if (point + 1 < index->have)
       {
-        here++;
+        end = static_cast<size_t>(index->list[point + 1].out);
       }
 
-      if (ret == 0)
+      res.count = end - beg;
+      res.check = adler ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+
+      struct cursor cur;
+      int ret = cursor_open(m_source, index, static_cast<off_t>(beg), &cur);
+      std::vector<unsigned char> data(std::min<size_t>(res.count, CHUNK * 4));
+      size_t left = res.count;
+      while (ret >= 0 && left != 0)
       {
-        new_buff_size = m_index->uncompressed_size - static_cast<size_t>(here[0].out);
+        const int want = static_cast<int>(std::min(left, data.size()));
+        ret = cursor_read(&cur, data.data(), want);
+        if (ret >= 0 && ret != want)
+        {
+          ret = Z_DATA_ERROR;
+        }
+        if (ret < 0)
+        {
+          break;
+        }
+
+        res.check = adler ? adler32(res.check, data.data(), static_cast<uInt>(ret))
+                          : crc32(res.check, data.data(), static_cast<uInt>(ret));
+        left -= static_cast<size_t>(ret);
       }
-      else
+      cursor_close(&cur);
+
+      /* every block ends with its own trailer */
+      if (ret >= 0 && index->blocks == GZIP_BLOCKS)
       {
-        new_buff_size = static_cast<size_t>(here[1].out - here[0].out);
+        uint32_t csize, usize;
+        const off_t in = index->list[point].in;
+        ret = Z_DATA_ERROR;
+        if (m_source->ReadAt(trailer, BLOCK_HEADER, in) == BLOCK_HEADER
+            && get_block_header(trailer, csize, usize))
+        {
+          unsigned char block[BLOCK_TRAILER];
+          if (m_source->ReadAt(block, BLOCK_TRAILER, in + csize - BLOCK_TRAILER) == BLOCK_TRAILER
+              && get_le32(block) == static_cast<uint32_t>(res.check)
+              && get_le32(block + 4) == static_cast<uint32_t>(res.count))
+          {
+            ret = Z_OK;
+          }
+        }
       }
 
-      m_buffer_beg = static_cast<size_t>(here[0].out);
+      res.status = ret < 0 ? ret : Z_OK;
+    });
 
-      m_buffer.resize(new_buff_size);
-      if (ReadOffset(m_buffer, m_buffer_beg) < 0)
+    uLong check = adler ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+      if (result[i].status < 0)
       {
-        return Z_ERRNO;
+        /* decoding errors within a span are corruption, not I/O failures */
+        if (result[i].status == Z_ERRNO || result[i].status == Z_MEM_ERROR)
+        {
+          return result[i].status;
+        }
+
+        o_offset = static_cast<size_t>(index->list[i].out);
+        o_in = static_cast<size_t>(index->list[i].in);
+        return Z_DATA_ERROR;
       }
+
+      check = adler ? adler32_combine(check, result[i].check, static_cast<z_off_t>(result[i].count))
+                    : crc32_combine(check, result[i].check, static_cast<z_off_t>(result[i].count));
+    }
+
+    if (index->blocks)
+    {
+      return Z_OK;
+    }
+
+    /* the stream trailer: CRC32 and ISIZE little endian, or Adler-32 big endian */
+    const size_t length = adler ? 4 : BLOCK_TRAILER;
+    const size_t in = index->compressed_size - length;
+    bool match = index->compressed_size >= length
+        && m_source->ReadAt(trailer, length, static_cast<off_t>(in)) == static_cast<ssize_t>(length);
+    if (match == true && adler == true)
+    {
+      match = ((static_cast<uLong>(trailer[0]) << 24) | (static_cast<uLong>(trailer[1]) << 16)
+               | (static_cast<uLong>(trailer[2]) << 8) | trailer[3]) == check;
+    }
+    else if (match == true)
+    {
+      match = get_le32(trailer) == static_cast<uint32_t>(check)
+          && get_le32(trailer + 4) == static_cast<uint32_t>(index->uncompressed_size);
+    }
+
+    if (match == false)
+    {
+      o_offset = index->uncompressed_size;
+      o_in = in;
+      return Z_DATA_ERROR;
+    }
+
+    return Z_OK;
+  }
+
+  int ZppReader::Verify()
+  {
+    size_t offset, in;
+    return Verify(offset, in);
+  }
+
+  void ZppReader::SetSpanCache(ZppSpanCache * i_cache)
+  {
+    m_cache = i_cache;
+    m_buffer.clear();
+  }
+
+  void ZppReader::SetThreadPool(ZppThreadPool * i_pool)
+  {
+    m_pool = i_pool;
+  }
+
+  void ZppReader::SetIoPolicy(ZppIoPolicy i_policy)
+  {
+    m_io_policy = i_policy;
+  }
+
+  ZppIoPolicy ZppReader::GetIoPolicy()
+  {
+    return m_io_policy;
+  }
+
+  void ZppReader::ApplyIoPolicy(ZppFileSource * io_source)
+  {
+    if (m_io_policy == ZPP_IO_DEFAULT)
+    {
+      return;
+    }
+
+    /* file systems without O_DIRECT still get the streaming hints */
+    if (io_source->SetIoPolicy(m_io_policy) != Z_OK && m_io_policy == ZPP_IO_DIRECT)
+    {
+      io_source->SetIoPolicy(ZPP_IO_STREAM);
+    }
+  }
+
+  int ZppReader::Find(const std::vector<uint8_t> & i_pattern, size_t & o_offset, const size_t i_from)
+  {
+    std::vector<size_t> offsets;
+    ssize_t ret = Search(i_pattern, false, i_from, 1, offsets);
+    if (ret <= 0)
+    {
+      return static_cast<int>(ret);
+    }
+
+    o_offset = offsets[0];
+    return 1;
+  }
+
+  ssize_t ZppReader::FindAll(const std::vector<uint8_t> & i_pattern, std::vector<size_t> & o_offsets, const size_t i_from, const size_t i_max)
+  {
+    return Search(i_pattern, false, i_from, i_max, o_offsets);
+  }
+
+  int ZppReader::FindFirstOf(const std::vector<uint8_t> & i_set, size_t & o_offset, const size_t i_from)
+  {
+    std::vector<size_t> offsets;
+    ssize_t ret = Search(i_set, true, i_from, 1, offsets);
+    if (ret <= 0)
+    {
+      return static_cast<int>(ret);
+    }
+
+    o_offset = offsets[0];
+    return 1;
+  }
+
+  int ZppReader::BuildLineIndex(const size_t i_step)
+  {
+    m_lines.clear();
+    m_line_count = 0;
+
+    if (IsReady() == false || i_step == 0)
+    {
+      return Z_ERRNO;
+    }
+
+    struct span_lines
+    {
+      ssize_t status = Z_OK;
+      size_t count = 0;               /* newlines in the span */
+      std::vector<line_point> points; /* numbered from the span start */
+      bool last_newline = false;      /* the span ends with a newline */
+    };
+
+    std::vector<std::pair<size_t, size_t>> spans;
+    GetSpans(0, m_index->uncompressed_size, spans);
+    std::vector<span_lines> result(spans.size());
+
+    GetThreadPool().ParallelFor(spans.size(), [&](size_t i_task)
+    {
+      span_lines & res = result[i_task];
+      const size_t beg = spans[i_task].first;
+      std::vector<uint8_t> data(spans[i_task].second - beg);
+
+      res.status = ReadOffset(data, beg);
+      if (res.status < 0)
+      {
+        return;
+      }
+
+      /* remember the start of every i_step-th line */
+      const uint8_t * cur = data.data();
+      const uint8_t * stop = data.data() + data.size();
+      while (cur < stop)
+      {
+        size_t left = i_step;
+        const uint8_t * hit = simd::find_nth(cur, static_cast<size_t>(stop - cur), '\n', left);
+        if (hit == NULL)
+        {
+          res.count += i_step - left;
+          break;
+        }
+
+        res.count += i_step;
+        res.points.push_back({res.count, beg + static_cast<size_t>(hit + 1 - data.data())});
+        cur = hit + 1;
+      }
+
+      res.last_newline = data.empty() == false && data.back() == '\n';
+    });
+
+    size_t base = 0;
+    for (size_t i = 0; i < result.size(); ++i)
+    {
+      if (result[i].status < 0)
+      {
+        m_lines.clear();
+        return static_cast<int>(result[i].status);
+      }
+
+      m_lines.push_back({base, spans[i].first});
+      for (const line_point & point : result[i].points)
+      {
+        m_lines.push_back({base + point.line, point.offset});
+      }
+      base += result[i].count;
+    }
+
+    /* the last line may have no newline at its end */
+    m_line_count = base;
+    if (result.empty() == false && result.back().last_newline == false)
+    {
+      ++m_line_count;
+    }
+
+    if (m_lines.empty() == true)
+    {
+      m_lines.push_back({0, 0});
+    }
+
+    return Z_OK;
+  }
+
+  size_t ZppReader::GetLineCount()
+  {
+    return m_line_count;
+  }
+
+  int ZppReader::GetLineOffset(const size_t i_line, size_t & o_offset)
+  {
+    ssize_t ret = ScanLines(i_line, 0, o_offset, nullptr);
+    if (ret < 0)
+    {
+      return static_cast<int>(ret);
+    }
+
+    return Z_OK;
+  }
+
+  ssize_t ZppReader::ReadLine(const size_t i_line, std::vector<uint8_t> & o_data)
+  {
+    ssize_t ret = ReadLines(i_line, 1, o_data);
+    if (ret < 0)
+    {
+      return ret;
+    }
+
+    if (o_data.empty() == false && o_data.back() == '\n')
+    {
+      o_data.pop_back();
+    }
+
+    return static_cast<ssize_t>(o_data.size());
+  }
+
+  ssize_t ZppReader::ReadLines(const size_t i_first, const size_t i_count, std::vector<uint8_t> & o_data)
+  {
+    size_t offset = 0;
+    return ScanLines(i_first, i_count, offset, &o_data);
+  }
+
+  int ZppReader::SetPos(const size_t i_pos)
+  {
+    if (m_index == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_pos > m_index->uncompressed_size /*|| i_pos < 0*/)
+    {
+      return Z_ERRNO;
+    }
+
+    m_cur_pos = i_pos;
+
+    return Z_OK;
+  }
+
+  size_t ZppReader::GetPos()
+  {
+    return m_cur_pos;
+  }
+
+  size_t ZppReader::GetSize()
+  {
+    if (m_index == nullptr)
+    {
+      return 0;
+    }
+
+    return m_index->uncompressed_size;
+  }
+
+  int ZppReader::GetSpan(const size_t i_pos, size_t & o_begin, size_t & o_end)
+  {
+    if (IsReady() == false || i_pos >= m_index->uncompressed_size)
+    {
+      return Z_ERRNO;
+    }
+
+    const int point = find_point(m_index, static_cast<off_t>(i_pos));
+    o_begin = static_cast<size_t>(m_index->list[point].out);
+    o_end = m_index->uncompressed_size;
+    if (point + 1 < m_index->have)
+    {
+      o_end = static_cast<size_t>(m_index->list[point + 1].out);
+    }
+
+    return Z_OK;
+  }
+
+  ssize_t ZppReader::PlanSplits(const size_t i_count, std::vector<ZppSplit> & o_splits, const size_t i_record_size, const bool i_flag_lines)
+  {
+    o_splits.clear();
+
+    if (IsReady() == false || m_builder != nullptr || i_count == 0)
+    {
+      return Z_ERRNO;
+    }
+
+    const size_t total = static_cast<size_t>(m_index->uncompressed_size);
+
+    /* a cut at the access point nearest to each equal share of the data */
+    std::vector<size_t> bounds(1, 0);
+    for (size_t k = 1; k < i_count && total != 0; ++k)
+    {
+      const size_t target = (total / i_count) * k + (total % i_count) * k / i_count;
+      const int point = find_point(m_index, static_cast<off_t>(target));
+      size_t cut = static_cast<size_t>(m_index->list[point].out);
+      if (point + 1 < m_index->have
+          && static_cast<size_t>(m_index->list[point + 1].out) - target < target - cut)
+      {
+        cut = static_cast<size_t>(m_index->list[point + 1].out);
+      }
+
+      /* a boundary moves forward to the start of a record or a line */
+      if (i_record_size != 0 && cut % i_record_size != 0)
+      {
+        cut += i_record_size - cut % i_record_size;
+      }
+      if (i_flag_lines == true && cut != 0 && cut < total)
+      {
+        size_t separator = 0;
+        int ret = FindFirstOf(std::vector<uint8_t>(1, '\n'), separator, cut - 1);
+        if (ret < 0)
+        {
+          return ret;
+        }
+        cut = (ret == 1) ? separator + 1 : total;
+      }
+
+      if (cut > bounds.back() && cut < total)
+      {
+        bounds.push_back(cut);
+      }
+    }
+    if (total != 0)
+    {
+      bounds.push_back(total);
+    }
+
+    ZppFileId id;
+    m_source->GetFileId(id);
+
+    for (size_t i = 0; i + 1 < bounds.size(); ++i)
+    {
+      ZppSplit split;
+      split.file = id;
+      split.format = m_index->blocks;
+      split.begin = bounds[i];
+      split.end = bounds[i + 1];
+
+      const int point = find_point(m_index, static_cast<off_t>(split.begin));
+      const struct point & here = m_index->list[point];
+      split.bits = here.bits;
+      split.point = static_cast<uint64_t>(here.out);
+      split.compressed_begin = static_cast<uint64_t>(here.in);
+      if (split_check(m_source, split.compressed_begin, split.check) != Z_OK)
+      {
+        o_splits.clear();
+        return Z_ERRNO;
+      }
+
+      /* the decoder stops before the access point at or after the end */
+      int last = find_point(m_index, static_cast<off_t>(split.end));
+      if (m_index->list[last].out < static_cast<off_t>(split.end))
+      {
+        ++last;
+      }
+      split.compressed_end = (last < m_index->have)
+        ? static_cast<uint64_t>(m_index->list[last].in)
+        : static_cast<uint64_t>(m_index->compressed_size);
+
+      if (m_index->blocks == 0)
+      {
+        split.window.resize(WINSIZE);
+        int ret = load_window(m_index, point, split.window.data());
+        if (ret != Z_OK)
+        {
+          o_splits.clear();
+          return ret;
+        }
+      }
+
+      o_splits.push_back(std::move(split));
+    }
+
+    return static_cast<ssize_t>(o_splits.size());
+  }
+
+  int ZppReader::SetBufferSize(const size_t i_size_backward, const size_t i_size_forward)
+  {
+    m_buffsize_backward = i_size_backward;
+    m_buffsize_forward = i_size_forward;
+
+    return 0;
+  }
+
+  size_t ZppReader::GetBufferSize()
+  {
+    return m_buffsize_backward + m_buffsize_forward + 1;
+  }
+
+  bool ZppReader::GetFlagAllignBuffer()
+  {
+    return m_flag_align_buffer;
+  }
+
+  void ZppReader::SetFlagAllignBuffer(bool i_flag)
+  {
+    m_flag_align_buffer = i_flag;
+  }
+
+  int ZppReader::BuildIndex()
+  {
+    ReleaseIndex();
+
+    m_lines.clear();
+    m_line_count = 0;
+
+    if (m_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    ZppFileId id;
+    const bool flag_id = m_source->GetFileId(id);
+    m_file_key = flag_id ? id.Hash() : 0;
+
+    if (m_flag_follow == false)
+    {
+      /* another reader of the same file may have built it already */
+      if (flag_id == true)
+      {
+        m_index_owner = find_index(id, m_span);
+        if (m_index_owner != nullptr)
+        {
+          m_index = m_index_owner.get();
+          return m_index->have;
+        }
+      }
+
+      int ret = build_index(m_source, m_span, &m_index);
+      if (ret < 0)
+      {
+        return ret;
+      }
+
+      m_index_owner.reset(m_index, free_index);
+      if (flag_id == true)
+      {
+        share_index(id, m_span, m_index_owner);
+      }
+      return ret;
+    }
+
+    /* the file keeps changing, its spans must not be shared */
+    m_file_key = 0;
+
+    m_builder = new builder;
+    int ret = build_begin(m_builder);
+    if (ret != Z_OK)
+    {
+      delete m_builder;
+      m_builder = nullptr;
+      return ret;
+    }
+
+    m_builder->blocks = -1;
+    ret = BuildStep();
+    if (ret >= 0 && m_index == nullptr)
+    {
+      /* not even the header is there yet */
+      m_index = alloc_index();
+      if (m_index == nullptr)
+      {
+        ret = Z_MEM_ERROR;
+      }
+    }
+
+    if (ret < 0 || ret == Z_STREAM_END)
+    {
+      build_end(m_builder);
+      delete m_builder;
+      m_builder = nullptr;
+    }
+
+    if (ret < 0)
+    {
+      if (m_index != nullptr)
+      {
+        free_index(m_index);
+        m_index = nullptr;
+      }
+      return ret;
+    }
+
+    return m_index->have;
+  }
+
+  int ZppReader::SaveIndex(const std::string & i_filename)
+  {
+    if (IsReady() == false || m_builder != nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    /* header: magic, version, format, point count, sizes, data file, span */
+    ZppFileId id;
+    m_source->GetFileId(id);
+
+    unsigned char header[INDEX_HEADER];
+    memcpy(header, "ZPPINDEX", 8);
+    put_le32(header + 8, INDEX_VERSION);
+    put_le32(header + 12, static_cast<uint32_t>(m_index->blocks));
+    put_le64(header + 16, static_cast<uint64_t>(m_index->have));
+    put_le64(header + 24, static_cast<uint64_t>(m_index->compressed_size));
+    put_le64(header + 32, static_cast<uint64_t>(m_index->uncompressed_size));
+    put_le64(header + 40, id.size);
+    put_le64(header + 48, static_cast<uint64_t>(id.mtime));
+    put_le64(header + 56, static_cast<uint64_t>(m_index->span));
+
+    FILE * file = fopen(i_filename.c_str(), "wb");
+    if (file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    int ret = Z_OK;
+    if (fwrite(header, 1, INDEX_HEADER, file) != INDEX_HEADER)
+    {
+      ret = Z_ERRNO;
+    }
+
+    std::vector<unsigned char> window(WINSIZE);
+    for (int i = 0; i < m_index->have && ret == Z_OK; ++i)
+    {
+      const struct point & here = m_index->list[i];
+      unsigned char entry[INDEX_POINT];
+      put_le64(entry, static_cast<uint64_t>(here.out));
+      put_le64(entry + 8, static_cast<uint64_t>(here.in));
+      put_le32(entry + 16, static_cast<uint32_t>(here.bits));
+      if (fwrite(entry, 1, INDEX_POINT, file) != INDEX_POINT)
+      {
+        ret = Z_ERRNO;
+        break;
+      }
+
+      if (m_index->blocks == 0)
+      {
+        ret = load_window(m_index, i, window.data());
+        if (ret == Z_OK && fwrite(window.data(), 1, WINSIZE, file) != WINSIZE)
+        {
+          ret = Z_ERRNO;
+        }
+      }
+    }
+
+    if (fclose(file) != 0 && ret == Z_OK)
+    {
+      ret = Z_ERRNO;
+    }
+
+    if (ret != Z_OK)
+    {
+      unlink(i_filename.c_str());
+    }
+
+    return ret;
+  }
+
+  int ZppReader::LoadIndex(const std::string & i_filename)
+  {
+    if (m_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    FILE * file = fopen(i_filename.c_str(), "rb");
+    if (file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    unsigned char header[INDEX_HEADER];
+    if (fread(header, 1, INDEX_HEADER, file) != INDEX_HEADER
+        || memcmp(header, "ZPPINDEX", 8) != 0
+        || get_le32(header + 8) != INDEX_VERSION
+        || get_le32(header + 12) > ZSTD_FRAMES
+        || get_le64(header + 16) < 1
+        || get_le64(header + 16) > 0x7fffffff
+        || static_cast<off_t>(get_le64(header + 56)) <= 0)
+    {
+      fclose(file);
+      return Z_DATA_ERROR;
+    }
+
+    const int blocks = static_cast<int>(get_le32(header + 12));
+    const int have = static_cast<int>(get_le64(header + 16));
+    const off_t compressed_size = static_cast<off_t>(get_le64(header + 24));
+    const off_t uncompressed_size = static_cast<off_t>(get_le64(header + 32));
+    const off_t span = static_cast<off_t>(get_le64(header + 56));
+
+    /* the data file must be the one indexed */
+    ZppFileId id;
+    if (m_source->GetFileId(id) == true
+        && (id.size != get_le64(header + 40)
+            || id.mtime != static_cast<int64_t>(get_le64(header + 48))
+            || static_cast<uint64_t>(compressed_size) > id.size))
+    {
+      fclose(file);
+      return Z_DATA_ERROR;
+    }
+
+    struct access * index = alloc_index();
+    if (index == NULL)
+    {
+      fclose(file);
+      return Z_MEM_ERROR;
+    }
+    index->blocks = blocks;
+    index->span = span;
+
+    int ret = Z_OK;
+    off_t last_out = 0, last_in = 0;
+    std::vector<unsigned char> window(WINSIZE);
+    for (int i = 0; i < have; ++i)
+    {
+      unsigned char entry[INDEX_POINT];
+      if (fread(entry, 1, INDEX_POINT, file) != INDEX_POINT
+          || (blocks == 0 && fread(window.data(), 1, WINSIZE, file) != WINSIZE))
+      {
+        ret = Z_DATA_ERROR;
+        break;
+      }
+
+      const off_t out = static_cast<off_t>(get_le64(entry));
+      const off_t in = static_cast<off_t>(get_le64(entry + 8));
+      const uint32_t bits = get_le32(entry + 16);
+      if ((i == 0 && out != 0) || out < last_out || out > uncompressed_size
+          || in < last_in || in > compressed_size || bits > 7)
+      {
+        ret = Z_DATA_ERROR;
+        break;
+      }
+      last_out = out;
+      last_in = in;
+
+      index = addpoint(index, static_cast<int>(bits), in, out, 0, blocks ? NULL : window.data());
+      if (index == NULL)
+      {
+        ret = Z_MEM_ERROR;
+        break;
+      }
+    }
+    fclose(file);
+
+    if (ret != Z_OK)
+    {
+      if (index != NULL)
+      {
+        free_index(index);
+      }
+      return ret;
+    }
+
+    index->compressed_size = compressed_size;
+    index->uncompressed_size = uncompressed_size;
+
+    ReleaseIndex();
+
+    m_index = index;
+    m_index_owner.reset(index, free_index);
+    m_file_key = 0;
+    if (m_source->GetFileId(id) == true)
+    {
+      m_file_key = id.Hash();
+      share_index(id, span, m_index_owner);
+    }
+    m_lines.clear();
+    m_line_count = 0;
+    m_buffer.clear();
+
+    return m_index->have;
+  }
+
+  void ZppReader::WaitAsync()
+  {
+    std::unique_lock<std::mutex> lock(m_async_mutex);
+    m_async_cond.wait(lock, [this] { return m_async_pending == 0; });
+  }
+
+  void ZppReader::ReleaseIndex()
+  {
+    /* a shared index is freed by its last reader */
+    if (m_index_owner != nullptr)
+    {
+      m_index_owner.reset();
+    }
+    else if (m_index != nullptr)
+    {
+      free_index(m_index);
+    }
+    m_index = nullptr;
+
+    if (m_builder != nullptr)
+    {
+      build_end(m_builder);
+      delete m_builder;
+      m_builder = nullptr;
+    }
+  }
+
+  std::shared_ptr<ZppReader::access> ZppReader::find_index(const ZppFileId & i_id, off_t i_span)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto it = registry.find(std::make_pair(i_id, i_span));
+    if (it == registry.end())
+    {
+      return nullptr;
+    }
+
+    return std::static_pointer_cast<access>(it->second.lock());
+  }
+
+  void ZppReader::share_index(const ZppFileId & i_id, off_t i_span, const std::shared_ptr<access> & i_index)
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    /* drop the entries of indexes no longer used */
+    for (auto it = registry.begin(); it != registry.end(); )
+    {
+      if (it->second.expired() == true)
+      {
+        it = registry.erase(it);
+      }
+      else
+      {
+        ++it;
+      }
+    }
+
+    registry[std::make_pair(i_id, i_span)] = i_index;
+  }
+
+  bool ZppReader::GetFlagFollow()
+  {
+    return m_flag_follow;
+  }
+
+  void ZppReader::SetFlagFollow(bool i_flag)
+  {
+    m_flag_follow = i_flag;
+  }
+
+  int ZppReader::BuildStep()
+  {
+    /* the format is known once the first header is complete */
+    if (m_builder->blocks < 0)
+    {
+      m_builder->blocks = is_blocks(m_source);
+      if (m_builder->blocks < 0)
+      {
+        return Z_OK;
+      }
+
+      /* zstd frames are indexed only complete */
+      if (m_builder->blocks == 0 && is_zstd(m_source) == 1)
+      {
+        return Z_VERSION_ERROR;
+      }
+    }
+
+    if (m_builder->blocks)
+    {
+      return build_blocks(m_source, &m_index, &m_builder->pos, 1);
+    }
+
+    return build_step(m_source, m_span, &m_index, m_builder, 1);
+  }
+
+  ssize_t ZppReader::Refresh()
+  {
+    if (m_index == nullptr || m_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_builder == nullptr)
+    {
+      return 0;
+    }
+
+    const size_t before = m_index->uncompressed_size;
+    int ret = BuildStep();
+    if (ret < 0 || ret == Z_STREAM_END)
+    {
+      build_end(m_builder);
+      delete m_builder;
+      m_builder = nullptr;
+    }
+
+    if (ret < 0)
+    {
+      if (m_index != nullptr)
+      {
+        free_index(m_index);
+        m_index = nullptr;
+      }
+      return ret;
+    }
+
+    /* the last span may have grown */
+    m_buffer.clear();
+
+    return static_cast<ssize_t>(m_index->uncompressed_size - before);
+  }
+
+  int ZppReader::WaitForData(const int i_timeout)
+  {
+    if (m_builder == nullptr || m_filename.empty() == true)
+    {
+      return Z_ERRNO;
+    }
+
+    int fd = inotify_init1(IN_CLOEXEC);
+    if (fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    if (inotify_add_watch(fd, m_filename.c_str(), IN_MODIFY | IN_CLOSE_WRITE) < 0)
+    {
+      close(fd);
+      return Z_ERRNO;
+    }
+
+    /* data written before the watch was set up */
+    struct stat st;
+    if (stat(m_filename.c_str(), &st) == 0 && st.st_size > m_builder->pos)
+    {
+      close(fd);
+      return 1;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret = poll(&pfd, 1, i_timeout);
+    close(fd);
+
+    if (ret < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    return ret > 0 ? 1 : 0;
+  }
+
+  bool ZppReader::IsComplete()
+  {
+    return m_index != nullptr && m_builder == nullptr;
+  }
+
+  void ZppReader::SetIndexMemoryLimit(const size_t i_limit)
+  {
+    std::lock_guard<std::mutex> lock(window_mutex);
+
+    lru.limit = i_limit;
+    while (lru.limit != 0 && lru.usage > lru.limit && lru.tail != NULL)
+    {
+      if (evict_window(lru.tail) != Z_OK)
+      {
+        break;
+      }
+    }
+  }
+
+  size_t ZppReader::GetIndexMemoryLimit()
+  {
+    std::lock_guard<std::mutex> lock(window_mutex);
+    return lru.limit;
+  }
+
+  size_t ZppReader::GetIndexMemoryUsage()
+  {
+    std::lock_guard<std::mutex> lock(window_mutex);
+    return lru.usage;
+  }
+
+  const std::string &ZppReader::GetFilename()
+  {
+    return m_filename;
+  }
+
+  bool ZppReader::IsReady()
+  {
+    if (m_source == nullptr || m_index == nullptr)
+    {
+      return false;
+    }
+
+    return true;
+  }
+
+  uint8_t ZppReader::operator [](const size_t i_pos)
+  {
+    if (m_index == nullptr || m_source == nullptr)
+    {
+      return 0x00;
+    }
+
+    if (/*i_pos < 0 ||*/ i_pos >= m_index->uncompressed_size)
+    {
+      return 0x00;
+    }
+
+    if (m_flag_align_buffer == true)
+    {
+      if (PopulateBufferAlign(i_pos) != Z_OK)
+      {
+        return 0x00;
+      }
+    }
+    else
+    {
+      if (PopulateBuffer(i_pos) != Z_OK)
+      {
+        return 0x00;
+      }
+    }
+
+    if (i_pos - m_buffer_beg < m_buffer.size())
+    {
+      return m_buffer[i_pos - m_buffer_beg];
+    }
+
+    return 0x00;
+  }
+
+  void ZppReader::free_index(ZppReader::access * index)
+  {
+    if (index != NULL)
+    {
+      {
+        std::lock_guard<std::mutex> lock(window_mutex);
+        for (int i = 0; i < index->have; ++i)
+        {
+          struct window *win = index->list[i].window;
+          if (win == NULL)
+          {
+            continue;
+          }
+
+          if (win->prev != NULL) win->prev->next = win->next;
+          else lru.head = win->next;
+          if (win->next != NULL) win->next->prev = win->prev;
+          else lru.tail = win->prev;
+          lru.usage -= sizeof(struct window);
+          free(win);
+        }
+      }
+
+      if (index->spill != NULL)
+      {
+        fclose(index->spill);
+      }
+      free(index->list);
+      free(index);
+    }
+  }
+
+  void ZppReader::touch_window(ZppReader::window * win)
+  {
+    /* unlink if already in the list */
+    if (win->prev != NULL || lru.head == win)
+    {
+      if (win->prev != NULL) win->prev->next = win->next;
+      else lru.head = win->next;
+      if (win->next != NULL) win->next->prev = win->prev;
+      else lru.tail = win->prev;
+    }
+
+    /* link as most recently used */
+    win->prev = NULL;
+    win->next = lru.head;
+    if (lru.head != NULL) lru.head->prev = win;
+    lru.head = win;
+    if (lru.tail == NULL) lru.tail = win;
+
+    /* keep within the budget, never evicting the window just used */
+    while (lru.limit != 0 && lru.usage > lru.limit && lru.tail != win)
+    {
+      if (evict_window(lru.tail) != Z_OK)
+      {
+        break;
+      }
+    }
+  }
+
+  int ZppReader::evict_window(ZppReader::window * win)
+  {
+    struct access *index = win->index;
+    struct point *here = index->list + win->point;
+
+    /* windows never change, so each one is written out at most once */
+    if (here->spilled == 0)
+    {
+      if (index->spill == NULL)
+      {
+        index->spill = tmpfile();
+        if (index->spill == NULL)
+        {
+          return Z_ERRNO;
+        }
+      }
+
+      if (pwrite(fileno(index->spill), win->data, WINSIZE,
+                 static_cast<off_t>(win->point) * WINSIZE) != WINSIZE)
+      {
+        return Z_ERRNO;
+      }
+      here->spilled = 1;
+    }
+
+    if (win->prev != NULL) win->prev->next = win->next;
+    else lru.head = win->next;
+    if (win->next != NULL) win->next->prev = win->prev;
+    else lru.tail = win->prev;
+    lru.usage -= sizeof(struct window);
+
+    here->window = NULL;
+    free(win);
+    return Z_OK;
+  }
+
+  int ZppReader::load_window(ZppReader::access * index, int point, unsigned char * window)
+  {
+    std::unique_lock<std::mutex> lock(window_mutex);
+
+    struct point *here = index->list + point;
+    struct window *win = here->window;
+    if (win != NULL)
+    {
+      memcpy(window, win->data, WINSIZE);
+      touch_window(win);
+      return Z_OK;
+    }
+
+    /* fault the window back in from the spill file, reading it without
+       the lock: a spilled window is never written again and the file
+       lives as long as the index */
+    if (here->spilled == 0 || index->spill == NULL)
+    {
+      return Z_DATA_ERROR;
+    }
+    const int fd = fileno(index->spill);
+    lock.unlock();
+
+    win = (struct window*)malloc(sizeof(struct window));
+    if (win == NULL)
+    {
+      return Z_MEM_ERROR;
+    }
+
+    if (pread(fd, win->data, WINSIZE, static_cast<off_t>(point) * WINSIZE) != WINSIZE)
+    {
+      free(win);
+      return Z_ERRNO;
+    }
+    memcpy(window, win->data, WINSIZE);
+
+    /* the list may have grown meanwhile, and another reader may have
+       faulted the same window in first */
+    lock.lock();
+    here = index->list + point;
+    if (here->window != NULL)
+    {
+      free(win);
+      touch_window(here->window);
+      return Z_OK;
+    }
+
+    win->prev = NULL;
+    win->next = NULL;
+    win->index = index;
+    win->point = point;
+    here->window = win;
+    lru.usage += sizeof(struct window);
+    touch_window(win);
+    return Z_OK;
+  }
+
+  ZppReader::access *ZppReader::alloc_index()
+  {
+    struct access *index;
+
+    /* start with eight points */
+    index = (struct access*)malloc(sizeof(struct access));
+    if (index == NULL)
+    {
+      return NULL;
+    }
+    index->list = (struct point*)malloc(sizeof(struct point) << 3);
+    if (index->list == NULL)
+    {
+      free(index);
+      return NULL;
+    }
+    index->size = 8;
+    index->have = 0;
+    index->compressed_size = 0;
+    index->uncompressed_size = 0;
+    index->spill = NULL;
+    index->blocks = 0;
+    index->span = 0;
+    return index;
+  }
+
+  ZppReader::access *ZppReader::addpoint(ZppReader::access * index, int bits, off_t in, off_t out, unsigned left, unsigned char * window)
+  {
+    struct point *next;
+    struct window *win;
+
+    /* copy the window before taking the lock */
+    win = NULL;
+    if (window != NULL)
+    {
+      win = (struct window*)malloc(sizeof(struct window));
+      if (win == NULL)
+      {
+        free_index(index);
+        return NULL;
+      }
+      if (left)
+      {
+        memcpy(win->data, window + WINSIZE - left, left);
+      }
+      if (left < WINSIZE)
+      {
+        memcpy(win->data + left, window, WINSIZE - left);
+      }
+    }
+
+    /* if list is empty, create it */
+    if (index == NULL)
+    {
+      index = alloc_index();
+      if (index == NULL)
+      {
+        free(win);
+        return NULL;
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(window_mutex);
+
+    /* if list is full, make it bigger -- under the lock, since eviction of
+       windows of this index may touch the list from other threads */
+    if (index->have == index->size)
+    {
+      index->size <<= 1;
+      next = (struct point*)realloc(index->list, sizeof(struct point) * index->size);
+      if (next == NULL)
+      {
+        lock.unlock();
+        free(win);
+        free_index(index);
+        return NULL;
+      }
+      index->list = next;
+    }
+
+    /* fill in entry and increment how many we have */
+    next = index->list + index->have;
+    next->bits = bits;
+    next->in = in;
+    next->out = out;
+    next->window = win;
+    next->spilled = 0;
+    if (win != NULL)
+    {
+      win->prev = NULL;
+      win->next = NULL;
+      win->index = index;
+      win->point = index->have;
+      lru.usage += sizeof(struct window);
+    }
+    index->have++;
+    if (win != NULL)
+    {
+      touch_window(win);
+    }
+
+    /* return list, possibly reallocated */
+    return index;
+  }
+
+  int ZppReader::build_index(ZppSource * in, off_t span, ZppReader::access ** built)
+  {
+    int ret;
+    struct access *index;       /* access points being generated */
+    struct builder state;
+
+    /* independent blocks are indexed from their headers */
+    index = NULL;
+    if (is_blocks(in) == 1)
+    {
+      off_t pos = 0;
+      ret = build_blocks(in, &index, &pos, 0);
+    }
+    else if (is_zstd(in) == 1)
+    {
+      ret = build_zstd(in, &index);
+    }
+    else
+    {
+      ret = build_begin(&state);
+      if (ret != Z_OK)
+      {
+        return ret;
+      }
+
+      /* inflate the whole input, end of input before the end of the stream is
+         an error */
+      ret = build_step(in, span, &index, &state, 0);
+      build_end(&state);
+    }
+    if (ret != Z_STREAM_END)
+    {
+      if (index != NULL)
+      {
+        free_index(index);
+      }
+      return ret;
+    }
+
+    /* release unused entries in list */
+    if (index->have != 0)
+    {
+      std::lock_guard<std::mutex> lock(window_mutex);
+      index->list = (struct point*)realloc(index->list, sizeof(struct point) * index->have);
+      index->size = index->have;
+    }
+    index->span = span;
+    *built = index;
+    return index->size;
+  }
+
+  int ZppReader::build_begin(ZppReader::builder * state)
+  {
+    /* initialize inflate */
+    state->strm.zalloc = Z_NULL;
+    state->strm.zfree = Z_NULL;
+    state->strm.opaque = Z_NULL;
+    state->strm.avail_in = 0;
+    state->strm.next_in = Z_NULL;
+    state->strm.avail_out = 0;
+    state->pos = state->totin = state->totout = state->last = 0;
+    state->blocks = 0;
+    return inflateInit2(&state->strm, 47);      /* automatic zlib or gzip decoding */
+  }
+
+  int ZppReader::build_step(ZppSource * in, off_t span, ZppReader::access ** built, ZppReader::builder * state, int follow)
+  {
+    int ret = Z_OK;
+    ssize_t got;
+    struct access *index = *built;
+    z_stream &strm = state->strm;
+
+    /* inflate the input, maintain a sliding window, and build an index -- this
+         also validates the integrity of the compressed data using the check
+         information at the end of the gzip or zlib stream */
+    do
+    {
+      /* get some compressed data from input */
+      got = fill_input(in, state->pos, state->input, &strm);
+      if (got < 0)
+      {
+        ret = Z_ERRNO;
+        break;
+      }
+      if (got == 0)
+      {
+        /* when following a growing file, wait for more input */
+        ret = follow ? Z_OK : Z_DATA_ERROR;
+        break;
+      }
+      state->pos += got;
+
+      /* process all of that, or until end of stream */
+      do
+      {
+        /* reset sliding window if necessary */
+        if (strm.avail_out == 0)
+        {
+          strm.avail_out = WINSIZE;
+          strm.next_out = state->window;
+        }
+
+        /* inflate until out of input, output, or at end of block --
+                 update the total input and output counters */
+        state->totin += strm.avail_in;
+        state->totout += strm.avail_out;
+        ret = inflate(&strm, Z_BLOCK);      /* return at end of block */
+        state->totin -= strm.avail_in;
+        state->totout -= strm.avail_out;
+        if (ret == Z_NEED_DICT)
+        {
+          ret = Z_DATA_ERROR;
+        }
+        if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+        {
+          break;
+        }
+        if (ret == Z_STREAM_END)
+        {
+          break;
+        }
+
+        /* if at end of block, consider adding an index entry (note that if
+         data_type indicates an end-of-block, then all of the
+         uncompressed data from that block has been delivered, and none
+         of the compressed data after that block has been consumed,
+         except for up to seven bits) -- the totout == 0 provides an
+         entry point after the zlib or gzip header, and assures that the
+         index always has at least one access point; we avoid creating an
+         access point after the last block by checking bit 6 of data_type */
+        if ((strm.data_type & 128)
+            && !(strm.data_type & 64)
+            && (state->totout == 0 || state->totout - state->last > span))
+        {
+          index = addpoint(index, strm.data_type & 7, state->totin,
+                           state->totout, strm.avail_out, state->window);
+          *built = index;
+          if (index == NULL)
+          {
+            ret = Z_MEM_ERROR;
+            break;
+          }
+          state->last = state->totout;
+        }
+      } while (strm.avail_in != 0);
+    } while (ret != Z_STREAM_END && ret != Z_MEM_ERROR && ret != Z_DATA_ERROR);
+
+    /* sizes of the data indexed so far */
+    if (index != NULL)
+    {
+      index->compressed_size = strm.total_in;
+      index->uncompressed_size = strm.total_out;
+      index->span = span;
+    }
+    return ret;
+  }
+
+  void ZppReader::build_end(ZppReader::builder * state)
+  {
+    (void)inflateEnd(&state->strm);
+  }
+
+  int ZppReader::is_blocks(ZppSource * in)
+  {
+    static const unsigned char fixed[16] =
+    {
+      0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0, 12, 0, 'Z', 'P', 8, 0
+    };
+    unsigned char header[BLOCK_HEADER];
+    uint32_t csize, usize;
+
+    ssize_t got = in->ReadAt(header, BLOCK_HEADER, 0);
+    if (got == BLOCK_HEADER)
+    {
+      return get_block_header(header, csize, usize) ? 1 : 0;
+    }
+
+    /* too short to tell, unless what is there already differs */
+    for (ssize_t i = 0; i < got && i < 16; ++i)
+    {
+      if ((i < 4 || i >= 10) && header[i] != fixed[i])
+      {
+        return 0;
+      }
+    }
+    return got < 0 ? 0 : -1;
+  }
+
+  int ZppReader::build_blocks(ZppSource * in, ZppReader::access ** built, off_t * pos, int follow)
+  {
+    ssize_t got;
+    uint32_t csize, usize;
+    unsigned char byte;
+    unsigned char header[BLOCK_HEADER];
+    struct access *index = *built;
+
+    if (index == NULL)
+    {
+      index = alloc_index();
+      if (index == NULL)
+      {
+        return Z_MEM_ERROR;
+      }
+      *built = index;
+    }
+    index->blocks = GZIP_BLOCKS;
+
+    for (;;)
+    {
+      got = in->ReadAt(header, BLOCK_HEADER, *pos);
+      if (got < 0)
+      {
+        return Z_ERRNO;
+      }
+      if (got == 0 && !follow)
+      {
+        return Z_STREAM_END;
+      }
+      if (got < BLOCK_HEADER)
+      {
+        return follow ? Z_OK : Z_DATA_ERROR;
+      }
+      if (!get_block_header(header, csize, usize))
+      {
+        return Z_DATA_ERROR;
+      }
+
+      /* a member still being written */
+      if (follow)
+      {
+        got = in->ReadAt(&byte, 1, *pos + csize - 1);
+        if (got < 0)
+        {
+          return Z_ERRNO;
+        }
+        if (got == 0)
+        {
+          return Z_OK;
+        }
+      }
+
+      /* empty members hold no data, the writer ends the file with one */
+      if (usize != 0)
+      {
+        index = addpoint(index, 0, *pos, index->uncompressed_size, 0, NULL);
+        *built = index;
+        if (index == NULL)
+        {
+          return Z_MEM_ERROR;
+        }
+      }
+
+      *pos += csize;
+      index->compressed_size = *pos;
+      index->uncompressed_size += usize;
+
+      if (follow && usize == 0)
+      {
+        got = in->ReadAt(&byte, 1, *pos);
+        if (got < 0)
+        {
+          return Z_ERRNO;
+        }
+        if (got == 0)
+        {
+          return Z_STREAM_END;
+        }
+      }
+    }
+  }
+
+  int ZppReader::is_zstd(ZppSource * in)
+  {
+    unsigned char magic[4];
+    if (in->ReadAt(magic, 4, 0) != 4)
+    {
+      return 0;
+    }
+
+    /* a data frame, or the seek table of a file without data */
+    const uint32_t value = get_le32(magic);
+    return value == ZSTD_FRAME_MAGIC || value == SEEK_TABLE_MAGIC ? 1 : 0;
+  }
+
+  int ZppReader::build_zstd(ZppSource * in, ZppReader::access ** built)
+  {
+#ifdef ZPP_WITH_ZSTD
+    struct access *index = alloc_index();
+    if (index == NULL)
+    {
+      return Z_MEM_ERROR;
+    }
+    *built = index;
+    index->blocks = ZSTD_FRAMES;
+
+    /* the seek table at the end lists the frames, when the size of the
+       input is known and the table is consistent with it */
+    size_t size = 0;
+    ZppFileId id;
+    if (in->GetFileId(id) == true)
+    {
+      size = static_cast<size_t>(id.size);
+    }
+    else if (in->Map(0, size) == nullptr)
+    {
+      size = 0;
+    }
+
+    unsigned char footer[SEEK_FOOTER];
+    if (size >= SEEK_HEADER + SEEK_FOOTER
+        && in->ReadAt(footer, SEEK_FOOTER, static_cast<off_t>(size - SEEK_FOOTER)) == SEEK_FOOTER
+        && get_le32(footer + 5) == SEEKABLE_MAGIC
+        && (footer[4] & 0x7c) == 0)
+    {
+      const size_t count = get_le32(footer);
+      const size_t entry = (footer[4] & 0x80) ? SEEK_ENTRY + 4 : SEEK_ENTRY;
+      const size_t length = SEEK_HEADER + count * entry + SEEK_FOOTER;
+      std::vector<unsigned char> table;
+      if (length <= size)
+      {
+        table.resize(length);
+      }
+      if (table.empty() == false
+          && in->ReadAt(table.data(), length, static_cast<off_t>(size - length)) == static_cast<ssize_t>(length)
+          && get_le32(table.data()) == SEEK_TABLE_MAGIC
+          && get_le32(table.data() + 4) == length - SEEK_HEADER)
+      {
+        off_t pos = 0;
+        off_t out = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+          pos += get_le32(table.data() + SEEK_HEADER + i * entry);
+        }
+
+        /* the frames must fill the input up to the table */
+        if (static_cast<size_t>(pos) == size - length)
+        {
+          pos = 0;
+          for (size_t i = 0; i < count; ++i)
+          {
+            const unsigned char * item = table.data() + SEEK_HEADER + i * entry;
+            if (get_le32(item + 4) != 0)
+            {
+              index = addpoint(index, 0, pos, out, 0, NULL);
+              *built = index;
+              if (index == NULL)
+              {
+                return Z_MEM_ERROR;
+              }
+            }
+            pos += get_le32(item);
+            out += get_le32(item + 4);
+          }
+          index->compressed_size = size;
+          index->uncompressed_size = static_cast<size_t>(out);
+          return Z_STREAM_END;
+        }
+      }
+    }
+
+    /* without a seek table the frames are found by decoding them all */
+    ZSTD_DCtx * dctx = take_dctx();
+    if (dctx == NULL)
+    {
+      return Z_MEM_ERROR;
+    }
+
+    int ret = Z_OK;
+    ssize_t got;
+    z_stream strm = {};
+    unsigned char input[CHUNK];
+    std::vector<unsigned char> output(ZSTD_DStreamOutSize());
+    off_t pos = 0;          /* offset of the input after strm.next_in */
+    off_t out = 0;
+    int idle = 1;           /* no frame is partly decoded */
+    while (ret == Z_OK)
+    {
+      int eof = 0;
+      if (strm.avail_in == 0)
+      {
+        got = fill_input(in, pos, input, &strm);
+        if (got < 0)
+        {
+          ret = Z_ERRNO;
+          break;
+        }
+        pos += got;
+        eof = got == 0;
+      }
+      else if (idle && strm.avail_in < 4)
+      {
+        /* the magic of the next frame may be split by the refill, the
+           bytes left are moved before the next input */
+        const unsigned left = strm.avail_in;
+        memmove(input, strm.next_in, left);
+        got = in->ReadAt(input + left, CHUNK - left, pos);
+        if (got < 0)
+        {
+          ret = Z_ERRNO;
+          break;
+        }
+        pos += got;
+        strm.next_in = input;
+        strm.avail_in = left + static_cast<unsigned>(got);
+      }
+      if (eof && idle)
+      {
+        ret = Z_STREAM_END;
+        break;
+      }
+
+      /* a data frame starts here */
+      if (idle && strm.avail_in >= 4 && get_le32(strm.next_in) == ZSTD_FRAME_MAGIC)
+      {
+        index = addpoint(index, 0, pos - strm.avail_in, out, 0, NULL);
+        *built = index;
+        if (index == NULL)
+        {
+          ret = Z_MEM_ERROR;
+          break;
+        }
+      }
+
+      ZSTD_inBuffer zin = {strm.next_in, strm.avail_in, 0};
+      ZSTD_outBuffer zout = {output.data(), output.size(), 0};
+      size_t hint = ZSTD_decompressStream(dctx, &zout, &zin);
+      strm.next_in += zin.pos;
+      strm.avail_in -= static_cast<unsigned>(zin.pos);
+      if (ZSTD_isError(hint))
+      {
+        ret = zstd_error(hint);
+        break;
+      }
+      out += static_cast<off_t>(zout.pos);
+      idle = hint == 0;
+
+      if (eof && zout.pos == 0 && !idle)
+      {
+        ret = Z_DATA_ERROR;
+      }
+    }
+    give_dctx(dctx);
+
+    if (index != NULL)
+    {
+      index->compressed_size = static_cast<size_t>(pos);
+      index->uncompressed_size = static_cast<size_t>(out);
+    }
+    return ret;
+#else
+    (void)in;
+    (void)built;
+    return Z_VERSION_ERROR;
+#endif
+  }
+
+  ssize_t ZppReader::fill_input(ZppSource * in, off_t pos, unsigned char * input, z_stream * strm)
+  {
+    size_t size = 0;
+    const uint8_t * data = in->Map(pos, size);
+    if (data != nullptr)
+    {
+      /* no copy -- avail_in is limited to what fits in an unsigned */
+      if (size > (1U << 30))
+      {
+        size = 1U << 30;
+      }
+      strm->next_in = const_cast<unsigned char *>(data);
+      strm->avail_in = static_cast<unsigned>(size);
+      return static_cast<ssize_t>(size);
+    }
+
+    ssize_t got = in->ReadAt(input, CHUNK, pos);
+    if (got < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    strm->next_in = input;
+    strm->avail_in = static_cast<unsigned>(got);
+    return got;
+  }
+
+  int ZppReader::extract(ZppSource * in, ZppReader::access * index, off_t offset, unsigned char * buf, int len)
+  {
+    int ret;
+    struct cursor cur;
+
+    /* proceed only if something reasonable to do */
+    if (len < 0)
+    {
+      return 0;
+    }
+
+    ret = cursor_open(in, index, offset, &cur);
+    if (ret == Z_OK)
+    {
+      ret = cursor_read(&cur, buf, len);
+    }
+
+    cursor_close(&cur);
+    return ret;
+  }
+
+  int ZppReader::cursor_open(ZppSource * in, ZppReader::access * index, off_t offset, ZppReader::cursor * cur)
+  {
+    int ret;
+    ssize_t got;
+    struct point *here;
+    unsigned char byte;
+    unsigned char discard[WINSIZE];
+
+    cur->in = in;
+    cur->active = 0;
+    cur->end = 0;
+    cur->out = 0;
+    cur->blocks = index->blocks;
+    cur->zstd = NULL;
+    cur->idle = 1;
+
+    /* a followed file may have no access point yet */
+    if (index->have == 0)
+    {
+      cur->end = 1;
+      return Z_OK;
+    }
+
+    /* find where in stream to start */
+    here = index->list + find_point(index, offset);
+
+    /* a zstd frame is decoded without history */
+    if (index->blocks == ZSTD_FRAMES)
+    {
+#ifdef ZPP_WITH_ZSTD
+      cur->zstd = take_dctx();
+      if (cur->zstd == NULL)
+      {
+        return Z_MEM_ERROR;
+      }
+      cur->strm.avail_in = 0;
+      cur->strm.next_in = Z_NULL;
+      cur->pos = here->in;
+      cur->out = here->out;
+      return cursor_skip(cur, offset);
+#else
+      return Z_VERSION_ERROR;
+#endif
+    }
+
+    /* initialize file and inflate state to start there */
+    cur->strm.zalloc = Z_NULL;
+    cur->strm.zfree = Z_NULL;
+    cur->strm.opaque = Z_NULL;
+    cur->strm.avail_in = 0;
+    cur->strm.next_in = Z_NULL;
+    ret = inflateInit2(&cur->strm, index->blocks ? 31 : -15);  /* member or raw inflate */
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+    cur->active = 1;
+    cur->pos = here->in;
+    cur->out = here->out;
+
+    /* a member of a block file starts with its own header and no history */
+    if (index->blocks)
+    {
+      return cursor_skip(cur, offset);
+    }
+
+    if (here->bits)
+    {
+      got = in->ReadAt(&byte, 1, here->in - 1);
+      if (got != 1)
+      {
+        return got < 0 ? Z_ERRNO : Z_DATA_ERROR;
+      }
+      (void)inflatePrime(&cur->strm, here->bits, byte >> (8 - here->bits));
+    }
+    ret = load_window(index, static_cast<int>(here - index->list), discard);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+    (void)inflateSetDictionary(&cur->strm, discard, WINSIZE);
+
+    /* skip uncompressed bytes until offset reached, or the stream ends */
+    return cursor_skip(cur, offset);
+  }
+
+  int ZppReader::cursor_skip(ZppReader::cursor * cur, off_t offset)
+  {
+    int ret;
+    unsigned char discard[WINSIZE];
+
+    while (cur->out < offset && !cur->end)
+    {
+      int want = offset - cur->out > WINSIZE ? WINSIZE : (int)(offset - cur->out);
+      ret = cursor_read(cur, discard, want);
+      if (ret < 0)
+      {
+        return ret;
+      }
+    }
+
+    return Z_OK;
+  }
+
+  int ZppReader::find_point(ZppReader::access * index, off_t offset)
+  {
+    /* last access point at or before offset, the first one if none */
+    int lo = 0;
+    int hi = index->have - 1;
+    while (lo < hi)
+    {
+      int mid = lo + (hi - lo + 1) / 2;
+      if (index->list[mid].out <= offset)
+      {
+        lo = mid;
+      }
+      else
+      {
+        hi = mid - 1;
+      }
+    }
+
+    return lo;
+  }
+
+  int ZppReader::cursor_read(ZppReader::cursor * cur, unsigned char * buf, int len)
+  {
+    int ret;
+    ssize_t got;
+
+    if (cur->end || len <= 0)
+    {
+      return 0;
+    }
+
+    if (cur->blocks == ZSTD_FRAMES)
+    {
+      return cursor_read_zstd(cur, buf, len);
+    }
+
+    /* uncompress until len bytes delivered, or end of stream */
+    cur->strm.avail_out = len;
+    cur->strm.next_out = buf;
+    do
+    {
+      if (cur->strm.avail_in == 0)
+      {
+        got = fill_input(cur->in, cur->pos, cur->input, &cur->strm);
+        if (got < 0)
+        {
+          return Z_ERRNO;
+        }
+        if (got == 0)
+        {
+          return Z_DATA_ERROR;
+        }
+        cur->pos += got;
+      }
+      ret = inflate(&cur->strm, Z_NO_FLUSH);       /* normal inflate */
+      if (ret == Z_NEED_DICT)
+      {
+        ret = Z_DATA_ERROR;
+      }
+      if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR)
+      {
+        return ret;
+      }
+      if (ret == Z_STREAM_END)
+      {
+        /* a block file goes on with the next member, if any */
+        if (cur->blocks)
+        {
+          if (cur->strm.avail_in == 0)
+          {
+            got = fill_input(cur->in, cur->pos, cur->input, &cur->strm);
+            if (got < 0)
+            {
+              return Z_ERRNO;
+            }
+            cur->pos += got;
+          }
+          if (cur->strm.avail_in != 0)
+          {
+            (void)inflateReset(&cur->strm);
+            continue;
+          }
+        }
+        cur->end = 1;
+        break;
+      }
+    } while (cur->strm.avail_out != 0);
+
+    /* number of uncompressed bytes delivered */
+    ret = len - (int)cur->strm.avail_out;
+    cur->out += ret;
+    return ret;
+  }
+
+  int ZppReader::cursor_read_zstd(ZppReader::cursor * cur, unsigned char * buf, int len)
+  {
+#ifdef ZPP_WITH_ZSTD
+    ssize_t got;
+    ZSTD_outBuffer out = {buf, static_cast<size_t>(len), 0};
+
+    /* decode frames until len bytes delivered, or the input ends between
+       frames -- skippable frames such as the seek table produce nothing */
+    while (out.pos < out.size)
+    {
+      int eof = 0;
+      if (cur->strm.avail_in == 0)
+      {
+        got = fill_input(cur->in, cur->pos, cur->input, &cur->strm);
+        if (got < 0)
+        {
+          return Z_ERRNO;
+        }
+        cur->pos += got;
+        eof = got == 0;
+      }
+      if (eof && cur->idle)
+      {
+        cur->end = 1;
+        break;
+      }
+
+      ZSTD_inBuffer in = {cur->strm.next_in, cur->strm.avail_in, 0};
+      const size_t before = out.pos;
+      size_t ret = ZSTD_decompressStream(cur->zstd, &out, &in);
+      cur->strm.next_in += in.pos;
+      cur->strm.avail_in -= static_cast<unsigned>(in.pos);
+      if (ZSTD_isError(ret))
+      {
+        return zstd_error(ret);
+      }
+      cur->idle = ret == 0;
+
+      /* the input ends inside a frame */
+      if (eof && out.pos == before && !cur->idle)
+      {
+        return Z_DATA_ERROR;
+      }
+    }
+
+    cur->out += static_cast<off_t>(out.pos);
+    return static_cast<int>(out.pos);
+#else
+    (void)cur;
+    (void)buf;
+    (void)len;
+    return Z_VERSION_ERROR;
+#endif
+  }
+
+  void ZppReader::cursor_close(ZppReader::cursor * cur)
+  {
+#ifdef ZPP_WITH_ZSTD
+    if (cur->zstd != NULL)
+    {
+      give_dctx(cur->zstd);
+      cur->zstd = NULL;
+    }
+#endif
+    if (cur->active)
+    {
+      (void)inflateEnd(&cur->strm);
+      cur->active = 0;
+    }
+  }
+
+  int ZppReader::PopulateBuffer(const size_t i_pos)
+  {
+    if (m_buffer.empty() == false
+        && m_buffer_beg <= i_pos
+        && (m_buffer_beg + m_buffer.size()) > i_pos)
+    {
+      return Z_OK;
+    }
+
+    const size_t size = m_index->uncompressed_size;
+    const size_t new_beg = (i_pos > m_buffsize_backward) ? i_pos - m_buffsize_backward : 0;
+    size_t new_end = size;
+    if (m_buffsize_forward < size - i_pos - 1)
+    {
+      new_end = i_pos + 1 + m_buffsize_forward;
+    }
+
+    const size_t old_beg = m_buffer_beg;
+    const size_t old_end = m_buffer_beg + m_buffer.size();
+    int ret = Z_OK;
+
+    if (m_buffer.empty() == false && new_beg >= old_beg && new_beg <= old_end && new_end > old_end)
+    {
+      /* moving forward: the overlap is kept, the decoding goes on from the
+         end of the buffer */
+      const size_t keep = old_end - new_beg;
+      memmove(m_buffer.data(), m_buffer.data() + (new_beg - old_beg), keep);
+      m_buffer.resize(new_end - new_beg);
+      ret = fill_buffer(m_buffer.data() + keep, new_end - old_end, old_end);
+    }
+    else if (m_buffer.empty() == false && new_end >= old_beg && new_end <= old_end && new_beg < old_beg)
+    {
+      /* moving backward: the overlap is moved up, the part before it is
+         decoded from its access point */
+      const size_t keep = new_end - old_beg;
+      if (new_end - new_beg > m_buffer.size())
+      {
+        m_buffer.resize(new_end - new_beg);
+      }
+      memmove(m_buffer.data() + (old_beg - new_beg), m_buffer.data(), keep);
+      m_buffer.resize(new_end - new_beg);
+      close_buffer_cursor();
+      ssize_t got = ReadOffset(m_buffer.data(), old_beg - new_beg, new_beg);
+      if (got != static_cast<ssize_t>(old_beg - new_beg))
+      {
+        ret = Z_ERRNO;
+      }
+    }
+    else if (m_buffer.empty() == false && new_beg > old_end)
+    {
+      /* a jump forward skips on in the same stream */
+      m_buffer.resize(new_end - new_beg);
+      ret = fill_buffer(m_buffer.data(), m_buffer.size(), new_beg);
+    }
+    else
+    {
+      close_buffer_cursor();
+      m_buffer.resize(new_end - new_beg);
+      if (ReadOffset(m_buffer, new_beg) < 0)
+      {
+        ret = Z_ERRNO;
+      }
+    }
+
+    m_buffer_beg = new_beg;
+    if (ret != Z_OK)
+    {
+      m_buffer.clear();
+      return Z_ERRNO;
+    }
+
+    return Z_OK;
+  }
+
+  int ZppReader::fill_buffer(uint8_t * o_data, const size_t i_count, const size_t i_offset)
+  {
+    /* with a span cache the spans decoded by other readers are used, the
+       cursor would decode them again */
+    if (m_cache != nullptr && m_file_key != 0)
+    {
+      close_buffer_cursor();
+      ssize_t got = ReadOffset(o_data, i_count, i_offset);
+      if (got != static_cast<ssize_t>(i_count))
+      {
+        return (got < 0) ? static_cast<int>(got) : Z_DATA_ERROR;
+      }
+      return Z_OK;
+    }
+
+    /* the cursor is kept if no access point lies before the offset, then
+       skipping to it is cheaper than starting anew */
+    const off_t offset = static_cast<off_t>(i_offset);
+    if (m_buffer_cursor != nullptr
+        && (m_buffer_cursor->out > offset
+            || find_point(m_index, m_buffer_cursor->out) != find_point(m_index, offset)))
+    {
+      close_buffer_cursor();
+    }
+
+    if (m_buffer_cursor == nullptr)
+    {
+      std::unique_ptr<cursor> cur(new cursor);
+      int ret = cursor_open(m_source, m_index, offset, cur.get());
+      if (ret != Z_OK)
+      {
+        cursor_close(cur.get());
+        return ret;
+      }
+      m_buffer_cursor = std::move(cur);
+    }
+    else if (m_buffer_cursor->out != offset)
+    {
+      int ret = cursor_skip(m_buffer_cursor.get(), offset);
+      if (ret != Z_OK)
+      {
+        close_buffer_cursor();
+        return ret;
+      }
+    }
+
+    size_t done = 0;
+    while (done < i_count)
+    {
+      int len = INT_MAX;
+      if (i_count - done < static_cast<size_t>(INT_MAX))
+      {
+        len = static_cast<int>(i_count - done);
+      }
+
+      int ret = cursor_read(m_buffer_cursor.get(), o_data + done, len);
+      if (ret < 0)
+      {
+        close_buffer_cursor();
+        return ret;
+      }
+      if (ret == 0)
+      {
+        break;
+      }
+      done += static_cast<size_t>(ret);
+    }
+
+    /* the cursor stops at the end of the stream it has seen, a followed file
+       may have grown since */
+    if (done != i_count)
+    {
+      close_buffer_cursor();
+      ssize_t got = ReadOffset(o_data + done, i_count - done, i_offset + done);
+      if (got != static_cast<ssize_t>(i_count - done))
+      {
+        return (got < 0) ? static_cast<int>(got) : Z_DATA_ERROR;
+      }
+    }
+
+    return Z_OK;
+  }
+
+  void ZppReader::close_buffer_cursor()
+  {
+    if (m_buffer_cursor != nullptr)
+    {
+      cursor_close(m_buffer_cursor.get());
+      m_buffer_cursor.reset();
+    }
+  }
+
+  void ZppReader::GetSpans(size_t i_begin, size_t i_end, std::vector<std::pair<size_t, size_t>> & o_spans)
+  {
+    o_spans.clear();
+    if (m_index == nullptr)
+    {
+      return;
+    }
+
+    if (i_end > m_index->uncompressed_size)
+    {
+      i_end = m_index->uncompressed_size;
+    }
+
+    for (int i = 0; i < m_index->have; ++i)
+    {
+      size_t beg = static_cast<size_t>(m_index->list[i].out);
+      size_t end = m_index->uncompressed_size;
+      if (i + 1 < m_index->have)
+      {
+        end = static_cast<size_t>(m_index->list[i + 1].out);
+      }
+
+      if (end <= i_begin || beg >= i_end)
+      {
+        continue;
+      }
+
+      o_spans.emplace_back(std::max(beg, i_begin), std::min(end, i_end));
+    }
+  }
+
+  ssize_t ZppReader::Search(const std::vector<uint8_t> & i_pattern, bool i_flag_set, size_t i_from, size_t i_max, std::vector<size_t> & o_offsets)
+  {
+    o_offsets.clear();
+    if (IsReady() == false)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_pattern.empty() == true)
+    {
+      return 0;
+    }
+
+    /* a span is extended by the pattern size less one byte, so that matches
+       straddling its end are found by the span they start in */
+    const size_t overlap = i_flag_set ? 0 : i_pattern.size() - 1;
+    const size_t size = m_index->uncompressed_size;
+
+    std::vector<std::pair<size_t, size_t>> spans;
+    GetSpans(i_from, size, spans);
+
+    /* spans are processed in batches so that memory stays bounded and the
+       search stops early once enough matches are found */
+    ZppThreadPool & pool = GetThreadPool();
+    const size_t batch = pool.GetThreadCount() + 1;
+
+    for (size_t first = 0; first < spans.size(); first += batch)
+    {
+      const size_t count = std::min(batch, spans.size() - first);
+      std::vector<std::vector<size_t>> found(count);
+      std::vector<ssize_t> status(count, Z_OK);
+
+      pool.ParallelFor(count, [&](size_t i_task)
+      {
+        const size_t beg = spans[first + i_task].first;
+        const size_t end = spans[first + i_task].second;
+        std::vector<uint8_t> data(std::min(end + overlap, size) - beg);
+
+        ssize_t ret = ReadOffset(data, beg);
+        if (ret < 0)
+        {
+          status[i_task] = ret;
+          return;
+        }
+
+        const uint8_t * cur = data.data();
+        const uint8_t * stop = data.data() + data.size();
+        while (cur < stop)
+        {
+          const uint8_t * hit = i_flag_set
+              ? simd::find_any(cur, static_cast<size_t>(stop - cur), i_pattern.data(), i_pattern.size())
+              : simd::find(cur, static_cast<size_t>(stop - cur), i_pattern.data(), i_pattern.size());
+          if (hit == NULL || beg + static_cast<size_t>(hit - data.data()) >= end)
+          {
+            break;
+          }
+
+          found[i_task].push_back(beg + static_cast<size_t>(hit - data.data()));
+          if (i_max != 0 && found[i_task].size() >= i_max)
+          {
+            break;
+          }
+          cur = hit + 1;
+        }
+      });
+
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (status[i] < 0)
+        {
+          o_offsets.clear();
+          return status[i];
+        }
+
+        for (size_t offset : found[i])
+        {
+          o_offsets.push_back(offset);
+          if (i_max != 0 && o_offsets.size() >= i_max)
+          {
+            return static_cast<ssize_t>(o_offsets.size());
+          }
+        }
+      }
+    }
+
+    return static_cast<ssize_t>(o_offsets.size());
+  }
+
+  ssize_t ZppReader::ScanLines(size_t i_first, size_t i_count, size_t & o_offset, std::vector<uint8_t> * o_data)
+  {
+    if (o_data != nullptr)
+    {
+      o_data->clear();
+    }
+
+    if (IsReady() == false || m_lines.empty() == true || i_first >= m_line_count)
+    {
+      return Z_ERRNO;
+    }
+
+    /* the last checkpoint with fewer newlines before it than the line needs,
+       the line starts after the remaining newlines */
+    size_t skip = 0;
+    size_t offset = 0;
+    if (i_first != 0)
+    {
+      std::vector<line_point>::const_iterator it
+          = std::upper_bound(m_lines.begin(), m_lines.end(), i_first - 1
+                             , [](size_t i_line, const line_point & i_point) { return i_line < i_point.line; });
+      --it;
+      skip = i_first - it->line;
+      offset = it->offset;
+    }
+
+    struct cursor cur;
+    int ret = cursor_open(m_source, m_index, static_cast<off_t>(offset), &cur);
+    if (ret != Z_OK)
+    {
+      cursor_close(&cur);
+      return ret;
+    }
+
+    std::vector<uint8_t> chunk(WINSIZE * 2);
+    size_t lines = 0;
+    bool flag_found = (skip == 0);
+    o_offset = offset;
+
+    while (flag_found == false || lines < i_count)
+    {
+      const size_t chunk_beg = static_cast<size_t>(cur.out);
+      ret = cursor_read(&cur, chunk.data(), static_cast<int>(chunk.size()));
+      if (ret <= 0)
+      {
+        break;
+      }
+
+      const uint8_t * data = chunk.data();
+      size_t size = static_cast<size_t>(ret);
+
+      if (flag_found == false)
+      {
+        const uint8_t * hit = simd::find_nth(data, size, '\n', skip);
+        if (hit == NULL)
+        {
+          continue;
+        }
+
+        flag_found = true;
+        size -= static_cast<size_t>(hit + 1 - data);
+        data = hit + 1;
+        o_offset = chunk_beg + static_cast<size_t>(data - chunk.data());
+        if (i_count == 0)
+        {
+          break;
+        }
+      }
+
+      size_t left = i_count - lines;
+      const uint8_t * hit = simd::find_nth(data, size, '\n', left);
+      if (hit != NULL)
+      {
+        size = static_cast<size_t>(hit + 1 - data);
+      }
+      lines = i_count - left;
+
+      if (o_data != nullptr)
+      {
+        o_data->insert(o_data->end(), data, data + size);
+      }
+    }
+
+    cursor_close(&cur);
+    if (ret < 0)
+    {
+      if (o_data != nullptr)
+      {
+        o_data->clear();
+      }
+      return ret;
+    }
+
+    /* a last line without a newline */
+    if (lines < i_count && o_data != nullptr && o_data->empty() == false && o_data->back() != '\n')
+    {
+      ++lines;
+    }
+
+    return static_cast<ssize_t>(lines);
+  }
+
+  ssize_t ZppReader::ReadCached(uint8_t * o_data, const size_t i_count, const size_t i_offset)
+  {
+    const size_t size = m_index->uncompressed_size;
+    if (i_offset >= size)
+    {
+      return 0;
+    }
+
+    const size_t count = std::min(i_count, size - i_offset);
+    std::vector<uint8_t> span;
+    size_t done = 0;
+    while (done < count)
+    {
+      const size_t offset = i_offset + done;
+      const int point = find_point(m_index, static_cast<off_t>(offset));
+      const size_t beg = static_cast<size_t>(m_index->list[point].out);
+      size_t end = size;
+      if (point + 1 < m_index->have)
+      {
+        end = static_cast<size_t>(m_index->list[point + 1].out);
+      }
+
+      const size_t part = std::min(count - done, end - offset);
+      ZppSpanKey key;
+      key.file = m_file_key;
+      key.offset = beg;
+
+      /* on a miss the whole span is decoded and cached */
+      if (m_cache->Lookup(key, offset - beg, o_data + done, part) == false)
+      {
+        span.resize(end - beg);
+        int ret = extract(m_source, m_index, static_cast<off_t>(beg)
+                          , span.data(), static_cast<int>(span.size()));
+        if (ret < 0 || static_cast<size_t>(ret) != span.size())
+        {
+          m_cache->Cancel(key);
+          return ret < 0 ? ret : Z_DATA_ERROR;
+        }
+
+        m_cache->Insert(key, span.data(), span.size());
+        memcpy(o_data + done, span.data() + (offset - beg), part);
+      }
+
+      done += part;
+    }
+
+    return static_cast<ssize_t>(count);
+  }
+
+  ZppThreadPool & ZppReader::GetThreadPool()
+  {
+    return (m_pool != nullptr) ? *m_pool : ZppThreadPool::Shared();
+  }
+
+  int ZppReader::PopulateBufferAlign(const size_t i_pos)
+  {
+    if (m_buffer.empty() == true
+        || m_buffer_beg > i_pos
+        || (m_buffer_beg + m_buffer.size()) <= i_pos)
+    {
+      size_t new_buff_size = 0;
+      struct point * here = m_index->list;
+      int ret = m_index->have;
+      while (--ret && here[1].out <= static_cast<off_t>(i_pos))
+      {
+        here++;
+      }
+
+      if (ret == 0)
+      {
+        new_buff_size = m_index->uncompressed_size - static_cast<size_t>(here[0].out);
+      }
+      else
+      {
+        new_buff_size = static_cast<size_t>(here[1].out - here[0].out);
+      }
+
+      /* the next interval is decoded on from where the buffer ends */
+      const size_t new_beg = static_cast<size_t>(here[0].out);
+      const bool flag_next = m_buffer.empty() == false && m_buffer_beg + m_buffer.size() == new_beg;
+      m_buffer_beg = new_beg;
+
+      m_buffer.resize(new_buff_size);
+      if (flag_next == true)
+      {
+        if (fill_buffer(m_buffer.data(), m_buffer.size(), m_buffer_beg) != Z_OK)
+        {
+          m_buffer.clear();
+          return Z_ERRNO;
+        }
+      }
+      else
+      {
+        close_buffer_cursor();
+        if (ReadOffset(m_buffer, m_buffer_beg) < 0)
+        {
+          return Z_ERRNO;
+        }
+      }
+    }
+
+    return Z_OK;
+  }
+
+  std::vector<uint8_t> ZppSplit::Serialize() const
+  {
+    /* header: magic, version, format, bits, window size, offsets, data file,
+       check */
+    std::vector<uint8_t> data(SPLIT_HEADER + window.size());
+    unsigned char * header = data.data();
+    memcpy(header, "ZPPSPLIT", 8);
+    put_le32(header + 8, SPLIT_VERSION);
+    put_le32(header + 12, static_cast<uint32_t>(format));
+    put_le32(header + 16, static_cast<uint32_t>(bits));
+    put_le32(header + 20, static_cast<uint32_t>(window.size()));
+    put_le64(header + 24, point);
+    put_le64(header + 32, begin);
+    put_le64(header + 40, end);
+    put_le64(header + 48, compressed_begin);
+    put_le64(header + 56, compressed_end);
+    put_le64(header + 64, file.dev);
+    put_le64(header + 72, file.ino);
+    put_le64(header + 80, file.size);
+    put_le64(header + 88, static_cast<uint64_t>(file.mtime));
+    put_le32(header + 96, check);
+    if (window.empty() == false)
+    {
+      memcpy(header + SPLIT_HEADER, window.data(), window.size());
+    }
+
+    return data;
+  }
+
+  int ZppSplit::Deserialize(const uint8_t * i_data, const size_t i_size)
+  {
+    if (i_data == nullptr || i_size < SPLIT_HEADER
+        || memcmp(i_data, "ZPPSPLIT", 8) != 0
+        || get_le32(i_data + 8) != SPLIT_VERSION)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    const uint32_t new_format = get_le32(i_data + 12);
+    const uint32_t new_bits = get_le32(i_data + 16);
+    const uint32_t size = get_le32(i_data + 20);
+    const uint64_t new_point = get_le64(i_data + 24);
+    const uint64_t new_begin = get_le64(i_data + 32);
+    const uint64_t new_end = get_le64(i_data + 40);
+    const uint64_t new_compressed_begin = get_le64(i_data + 48);
+    const uint64_t new_compressed_end = get_le64(i_data + 56);
+
+    /* only a deflate stream needs the window before the access point */
+    if (new_format > ZSTD_FRAMES || new_bits > 7
+        || size != (new_format == 0 ? ZppReader::WINSIZE : 0)
+        || i_size != SPLIT_HEADER + size
+        || new_point > new_begin || new_begin > new_end
+        || new_compressed_begin > new_compressed_end)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    format = static_cast<int>(new_format);
+    bits = static_cast<int>(new_bits);
+    point = new_point;
+    begin = new_begin;
+    end = new_end;
+    compressed_begin = new_compressed_begin;
+    compressed_end = new_compressed_end;
+    file.dev = get_le64(i_data + 64);
+    file.ino = get_le64(i_data + 72);
+    file.size = get_le64(i_data + 80);
+    file.mtime = static_cast<int64_t>(get_le64(i_data + 88));
+    check = get_le32(i_data + 96);
+    window.assign(i_data + SPLIT_HEADER, i_data + SPLIT_HEADER + size);
+
+    return Z_OK;
+  }
+
+  ZppSplitReader::ZppSplitReader(const std::string & i_filename, const ZppSplit & i_split)
+  {
+    Open(i_filename, i_split);
+  }
+
+  ZppSplitReader::~ZppSplitReader()
+  {
+    Close();
+  }
+
+  int ZppSplitReader::Open(const std::string & i_filename, const ZppSplit & i_split)
+  {
+    Close();
+
+    ZppFileSource * source = new ZppFileSource(i_filename);
+    if (source->IsReady() == false)
+    {
+      delete source;
+      return Z_ERRNO;
+    }
+
+    int ret_val = Open(source, i_split);
+    m_own_source.reset(source);
+    if (ret_val != Z_OK)
+    {
+      Close();
+    }
+    return ret_val;
+  }
+
+  int ZppSplitReader::Open(ZppSource * i_source, const ZppSplit & i_split)
+  {
+    Close();
+
+    if (i_source == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_split.format < 0 || i_split.format > ZSTD_FRAMES
+        || i_split.bits < 0 || i_split.bits > 7
+        || i_split.window.size() != (i_split.format == 0 ? ZppReader::WINSIZE : 0)
+        || i_split.point > i_split.begin || i_split.begin > i_split.end)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    /* the split is planned for one version of the file, which may be
+       a copy on another host: the size and the data are compared, not
+       the device, inode or time */
+    ZppFileId id;
+    if (i_split.file.size != 0 && i_source->GetFileId(id) == true && id.size != i_split.file.size)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    uint32_t check = 0;
+    int ret = split_check(i_source, i_split.compressed_begin, check);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+    if (check != i_split.check)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    /* an index of the single access point of the split, the cursor
+       takes the window when it starts and does not need it later */
+    std::vector<unsigned char> window(i_split.window);
+    ZppReader::access * index = ZppReader::alloc_index();
+    if (index == NULL)
+    {
+      return Z_MEM_ERROR;
+    }
+    index->blocks = i_split.format;
+    index = ZppReader::addpoint(index, i_split.bits, static_cast<off_t>(i_split.compressed_begin),
+                                static_cast<off_t>(i_split.point), 0, window.empty() ? NULL : window.data());
+    if (index == NULL)
+    {
+      return Z_MEM_ERROR;
+    }
+    index->compressed_size = static_cast<off_t>(i_split.compressed_end);
+    index->uncompressed_size = static_cast<off_t>(i_split.end);
+
+    m_cursor.reset(new ZppReader::cursor);
+    ret = ZppReader::cursor_open(i_source, index, static_cast<off_t>(i_split.begin), m_cursor.get());
+    ZppReader::free_index(index);
+    if (ret == Z_OK && m_cursor->out != static_cast<off_t>(i_split.begin))
+    {
+      ret = Z_DATA_ERROR;
+    }
+    if (ret != Z_OK)
+    {
+      ZppReader::cursor_close(m_cursor.get());
+      m_cursor.reset();
+      return ret;
+    }
+
+    m_source = i_source;
+    m_pos = static_cast<size_t>(i_split.begin);
+    m_end = static_cast<size_t>(i_split.end);
+    return Z_OK;
+  }
+
+  void ZppSplitReader::Close()
+  {
+    if (m_cursor != nullptr)
+    {
+      ZppReader::cursor_close(m_cursor.get());
+      m_cursor.reset();
+    }
+    m_source = nullptr;
+    m_own_source.reset();
+    m_pos = 0;
+    m_end = 0;
+    m_buffer.clear();
+    m_buffer_pos = 0;
+  }
+
+  ssize_t ZppSplitReader::Read(uint8_t * o_data, const size_t i_count)
+  {
+    if (m_cursor == nullptr || o_data == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    const size_t count = std::min(i_count, m_end - m_pos);
+
+    /* the data left by ReadLine() goes first */
+    size_t done = std::min(count, m_buffer.size() - m_buffer_pos);
+    if (done != 0)
+    {
+      memcpy(o_data, m_buffer.data() + m_buffer_pos, done);
+      m_buffer_pos += done;
+    }
+
+    while (done < count)
+    {
+      const int want = static_cast<int>(std::min(count - done, static_cast<size_t>(INT_MAX)));
+      int ret = ZppReader::cursor_read(m_cursor.get(), o_data + done, want);
+      if (ret < 0)
+      {
+        return ret;
+      }
+      if (ret < want)
+      {
+        /* the file ends before the split */
+        return Z_DATA_ERROR;
+      }
+      done += static_cast<size_t>(ret);
+    }
+
+    m_pos += count;
+    return static_cast<ssize_t>(count);
+  }
+
+  ssize_t ZppSplitReader::ReadLine(std::vector<uint8_t> & o_line)
+  {
+    o_line.clear();
+
+    if (m_cursor == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_pos == m_end)
+    {
+      return ZPP_END;
+    }
+
+    while (m_pos < m_end)
+    {
+      if (m_buffer_pos == m_buffer.size())
+      {
+        int ret = fill();
+        if (ret != Z_OK)
+        {
+          o_line.clear();
+          return ret;
+        }
+      }
+
+      const uint8_t * data = m_buffer.data() + m_buffer_pos;
+      const size_t size = m_buffer.size() - m_buffer_pos;
+      const uint8_t * separator = static_cast<const uint8_t *>(memchr(data, '\n', size));
+      const size_t length = (separator != nullptr) ? static_cast<size_t>(separator - data) : size;
+
+      o_line.insert(o_line.end(), data, data + length);
+      const size_t used = (separator != nullptr) ? length + 1 : length;
+      m_buffer_pos += used;
+      m_pos += used;
+
+      if (separator != nullptr)
+      {
+        break;
+      }
+    }
+
+    return static_cast<ssize_t>(o_line.size());
+  }
+
+  size_t ZppSplitReader::GetPos()
+  {
+    return m_pos;
+  }
+
+  bool ZppSplitReader::IsReady()
+  {
+    return m_cursor != nullptr;
+  }
+
+  int ZppSplitReader::fill()
+  {
+    /* the buffer never holds data past the end of the split */
+    const size_t size = std::min(m_end - m_pos, static_cast<size_t>(ZppReader::CHUNK * 4));
+    m_buffer.resize(size);
+    m_buffer_pos = 0;
+
+    int ret = ZppReader::cursor_read(m_cursor.get(), m_buffer.data(), static_cast<int>(size));
+    if (ret != static_cast<int>(size))
+    {
+      m_buffer.clear();
+      return (ret < 0) ? ret : Z_DATA_ERROR;
     }
 
     return Z_OK;
@@ -670,6 +3816,8 @@ extract_ret:
     }
 
     m_filename = i_filename;
+    m_own_sink.reset(new ZppFileSink(m_file));
+    m_sink = m_own_sink.get();
 
     int ret_val = InitZLib();
     if (ret_val != Z_OK)
@@ -685,84 +3833,400 @@ extract_ret:
   {
     Close();
 
+    if (i_file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
     m_file = i_file;
+    m_own_sink.reset(new ZppFileSink(m_file));
+    m_sink = m_own_sink.get();
+
+    int ret_val = InitZLib();
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+
+    m_flag_error = false;
+    return ret_val;
+  }
+
+  int ZppWriter::Open(ZppSink * i_sink)
+  {
+    Close();
+
+    if (i_sink == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    m_sink = i_sink;
+
+    int ret_val = InitZLib();
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+
+    m_flag_error = false;
+    return ret_val;
+  }
+
+  int ZppWriter::Close()
+  {
+    int ret_val = Z_OK;
+
+    /* a hibernated stream is finished as any other */
+    if (m_flag_hibernated == true)
+    {
+      ret_val = Resume();
+    }
+
+    if (m_sink != nullptr)
+    {
+      int ret = EndZLib();
+      if (ret_val == Z_OK)
+      {
+        ret_val = ret;
+      }
+    }
+
+    if (m_file != nullptr && m_filename.empty() == false)
+    {
+      if (fclose(m_file) != 0 && ret_val == Z_OK)
+      {
+        ret_val = Z_ERRNO;
+      }
+    }
+
+    m_file = nullptr;
+    m_sink = nullptr;
+    m_own_sink.reset();
+    m_output = nullptr;
+    m_filename.clear();
+    m_buffer.clear();
+    m_blocks.clear();
+    m_block_output.clear();
+    m_block_count = 0;
+    m_stream = {};
+    m_flag_hibernated = false;
+    m_flag_resumed = false;
+    m_check = 0;
+    m_resumed_in = 0;
+    m_resumed_out = 0;
+
+    return ret_val;
+  }
+
+  int ZppWriter::Write(const std::vector<uint8_t> & i_data)
+  {
+    return Write(i_data.data(), i_data.size());
+  }
+
+  int ZppWriter::Write(const uint8_t * i_data, size_t i_size)
+  {
+    if (m_flag_hibernated == true)
+    {
+      int ret_val = Resume();
+      if (ret_val != Z_OK)
+      {
+        return ret_val;
+      }
+    }
+
+    if (IsReady() == false)
+    {
+      return Z_ERRNO;
+    }
+
+    return compress(i_data, i_size);
+  }
+
+  size_t ZppWriter::GetSize()
+  {
+    if (m_open_block != 0)
+    {
+      return m_total_out;
+    }
+
+    return m_resumed_out + m_stream.total_out;
+  }
+
+  int ZppWriter::Hibernate()
+  {
+    if (m_flag_hibernated == true)
+    {
+      return Z_OK;
+    }
+
+    if (IsReady() == false)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_open_block != 0)
+    {
+      /* a partly filled block becomes a shorter member or frame */
+      if (m_block_count != 0)
+      {
+        int ret_val = compress_blocks();
+        if (ret_val != Z_OK)
+        {
+          return ret_val;
+        }
+      }
+
+      for (z_stream & strm : m_block_streams)
+      {
+        deflateEnd(&strm);
+      }
+      m_block_streams.clear();
+#ifdef ZPP_WITH_ZSTD
+      for (ZSTD_CCtx * cctx : m_zstd_streams)
+      {
+        ZSTD_freeCCtx(cctx);
+      }
+      m_zstd_streams.clear();
+#endif
+      m_blocks = std::vector<std::vector<uint8_t>>();
+      m_block_output = std::vector<std::vector<uint8_t>>();
+    }
+    else
+    {
+      /* the full flush ends the data on a byte boundary and drops the
+         history, so a new raw deflate stream continues it without the
+         window and nothing of the stream is kept in memory */
+      m_stream.avail_in = 0;
+      m_stream.next_in = Z_NULL;
+      int deflate_res = Z_OK;
+      do
+      {
+        if (m_stream.avail_out == 0 && write_output(true) != Z_OK)
+        {
+          fail();
+          return Z_ERRNO;
+        }
+        deflate_res = deflate(&m_stream, Z_FULL_FLUSH);
+      }
+      while (deflate_res == Z_OK && m_stream.avail_out == 0);
+
+      if (deflate_res != Z_OK || write_output(false) != Z_OK)
+      {
+        fail();
+        return deflate_res != Z_OK ? deflate_res : Z_ERRNO;
+      }
+
+      if (m_flag_resumed == false)
+      {
+        m_check = m_stream.adler;
+      }
+      m_resumed_in += m_stream.total_in;
+      m_resumed_out += m_stream.total_out;
+
+      deflateEnd(&m_stream);
+      m_stream = {};
+      m_buffer = std::vector<uint8_t>();
+    }
+
+    if (m_sink->Flush() != Z_OK)
+    {
+      fail();
+      return Z_ERRNO;
+    }
+
+    /* only a file opened by name can be opened again */
+    if (m_filename.empty() == false)
+    {
+      m_own_sink.reset();
+      m_sink = nullptr;
+      if (fclose(m_file) != 0)
+      {
+        m_file = nullptr;
+        fail();
+        return Z_ERRNO;
+      }
+      m_file = nullptr;
+    }
+
+    m_flag_hibernated = true;
+    return Z_OK;
+  }
+
+  int ZppWriter::Resume()
+  {
+    if (m_flag_hibernated == false)
+    {
+      return IsReady() == true ? Z_OK : Z_ERRNO;
+    }
+
+    if (m_flag_error == true)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_sink == nullptr)
+    {
+      m_file = fopen(m_filename.c_str(), "ab");
+      if (m_file == nullptr)
+      {
+        m_flag_error = true;
+        return Z_ERRNO;
+      }
+
+      /* the continuation is valid only after the data written before, a
+         file rotated or truncated meanwhile is not appended to */
+      struct stat st;
+      const size_t written = (m_open_block != 0) ? m_total_out : m_resumed_out;
+      if (fstat(fileno(m_file), &st) != 0 || static_cast<size_t>(st.st_size) != written)
+      {
+        fclose(m_file);
+        m_file = nullptr;
+        m_flag_error = true;
+        return Z_DATA_ERROR;
+      }
+
+      m_own_sink.reset(new ZppFileSink(m_file));
+      m_sink = m_own_sink.get();
+    }
 
     int ret_val = InitZLib();
     if (ret_val != Z_OK)
     {
-      return ret_val;
+      fail();
+      return ret_val;
+    }
+
+    if (m_open_block == 0)
+    {
+      m_flag_resumed = true;
+    }
+    m_flag_hibernated = false;
+    return Z_OK;
+  }
+
+  bool ZppWriter::IsHibernated()
+  {
+    return m_flag_hibernated;
+  }
+
+  size_t ZppWriter::GetMemoryUsage()
+  {
+    size_t usage = m_buffer.capacity();
+    if (m_stream.state != Z_NULL)
+    {
+      usage += DEFLATE_MEMORY;
+    }
+    usage += m_block_streams.size() * DEFLATE_MEMORY;
+#ifdef ZPP_WITH_ZSTD
+    for (ZSTD_CCtx * cctx : m_zstd_streams)
+    {
+      usage += ZSTD_sizeof_CCtx(cctx);
+    }
+#endif
+    for (const std::vector<uint8_t> & block : m_blocks)
+    {
+      usage += block.capacity();
+    }
+    for (const std::vector<uint8_t> & block : m_block_output)
+    {
+      usage += block.capacity();
     }
 
-    m_flag_error = false;
-    return ret_val;
+    return usage;
   }
 
-  void ZppWriter::Close()
+  bool ZppWriter::GetFlagGzip()
   {
-    if (m_file != nullptr)
-    {
-      EndZLib();
-    }
+    return m_flag_gzip;
+  }
 
-    if (m_file != nullptr && m_filename.empty() == false)
+  int ZppWriter::SetFlagGzip(bool i_flag)
+  {
+    /* the stream of an open or hibernated writer keeps its settings */
+    if (m_sink != nullptr || m_flag_hibernated == true)
     {
-      fclose(m_file);
+      return Z_ERRNO;
     }
 
-    m_file = nullptr;
-    m_filename.clear();
-    m_buffer.clear();
-    m_stream = {};
+    m_flag_gzip = i_flag;
+    return Z_OK;
   }
 
-  int ZppWriter::Write(const std::vector<uint8_t> & i_data)
+  int ZppWriter::GetCompressionLevel()
   {
-    return Write(i_data.data(), i_data.size());
+    return m_compression_level;
   }
 
-  int ZppWriter::Write(const uint8_t * i_data, size_t i_size)
+  int ZppWriter::SetCompressionLevel(int i_level)
   {
-    if (IsReady() == false)
+    /* the stream of an open or hibernated writer keeps its settings */
+    if (m_sink != nullptr || m_flag_hibernated == true)
     {
       return Z_ERRNO;
     }
 
-    return compress(i_data, i_size);
+    m_compression_level = i_level;
+    return Z_OK;
   }
 
-  size_t ZppWriter::GetSize()
+  size_t ZppWriter::GetChunkSize()
+  {
+    return m_chunk_size;
+  }
+
+  void ZppWriter::SetChunkSize(size_t i_size)
   {
-    return m_stream.total_out;
+    m_chunk_size = i_size;
   }
 
-  bool ZppWriter::GetFlagGzip()
+  size_t ZppWriter::GetBlockSize()
   {
-    return m_flag_gzip;
+    return m_block_size;
   }
 
-  void ZppWriter::SetFlagGzip(bool i_flag)
+  int ZppWriter::SetBlockSize(size_t i_size)
   {
-    m_flag_gzip = i_flag;
+    /* the stream of an open or hibernated writer keeps its settings */
+    if (m_sink != nullptr || m_flag_hibernated == true)
+    {
+      return Z_ERRNO;
+    }
+
+    m_block_size = i_size < MAX_BLOCK_SIZE ? i_size : MAX_BLOCK_SIZE;
+    return Z_OK;
   }
 
-  int ZppWriter::GetCompressionLevel()
+  void ZppWriter::SetThreadPool(ZppThreadPool * i_pool)
   {
-    return m_compression_level;
+    m_pool = i_pool;
   }
 
-  void ZppWriter::SetCompressionLevel(int i_level)
+  ZppFormat ZppWriter::GetFormat()
   {
-    m_compression_level = i_level;
+    return m_format;
   }
 
-  size_t ZppWriter::GetChunkSize()
+  int ZppWriter::SetFormat(ZppFormat i_format)
   {
-    return m_chunk_size;
+    /* the stream of an open or hibernated writer keeps its settings */
+    if (m_sink != nullptr || m_flag_hibernated == true)
+    {
+      return Z_ERRNO;
+    }
+
+    m_format = i_format;
+    return Z_OK;
   }
 
-  void ZppWriter::SetChunkSize(size_t i_size)
+  void ZppWriter::SetIoPolicy(ZppIoPolicy i_policy)
   {
-    m_chunk_size = i_size;
+    m_io_policy = i_policy;
+  }
+
+  ZppIoPolicy ZppWriter::GetIoPolicy()
+  {
+    return m_io_policy;
   }
 
   const std::string &ZppWriter::GetFilename()
@@ -772,7 +4236,12 @@ extract_ret:
 
   bool ZppWriter::IsReady()
   {
-    if (m_file == nullptr || ferror(m_file))
+    if (m_flag_hibernated == true)
+    {
+      return m_flag_error == false;
+    }
+
+    if (m_sink == nullptr || (m_file != nullptr && ferror(m_file)))
     {
       return false;
     }
@@ -787,13 +4256,104 @@ extract_ret:
 
   int ZppWriter::InitZLib()
   {
+    m_drop_from = m_io_policy != ZPP_IO_DEFAULT && m_file != nullptr ? ftello(m_file) : -1;
+    if (m_drop_from >= 0)
+    {
+      posix_fadvise(fileno(m_file), 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
     m_stream = {};
     m_stream.zalloc = Z_NULL;
     m_stream.zfree = Z_NULL;
     m_stream.opaque = Z_NULL;
 
     int ret_val = Z_ERRNO;
-    if (m_flag_gzip == true)
+    m_open_block = m_block_size;
+    if (m_format == ZPP_FORMAT_ZSTD)
+    {
+#ifdef ZPP_WITH_ZSTD
+      /* frames of a group are compressed at once, the seek table is
+         written at the end */
+      m_open_block = m_block_size != 0 ? m_block_size : ZSTD_FRAME_SIZE;
+      const size_t group = m_pool != nullptr ? 2 * (m_pool->GetThreadCount() + 1) : 1;
+      const int level = m_compression_level == Z_DEFAULT_COMPRESSION ? 0 : m_compression_level;
+      m_zstd_streams = std::vector<ZSTD_CCtx *>(group, nullptr);
+      for (ZSTD_CCtx * & cctx : m_zstd_streams)
+      {
+        cctx = ZSTD_createCCtx();
+        if (cctx == nullptr
+            || ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level))
+            || ZSTD_isError(ZSTD_CCtx_setParameter(cctx, ZSTD_c_checksumFlag, 1)))
+        {
+          fail();
+          return cctx == nullptr ? Z_MEM_ERROR : Z_STREAM_ERROR;
+        }
+      }
+
+      m_blocks = std::vector<std::vector<uint8_t>>(group);
+      m_block_output = std::vector<std::vector<uint8_t>>(group, std::vector<uint8_t>(ZSTD_compressBound(m_open_block)));
+      for (std::vector<uint8_t> & block : m_blocks)
+      {
+        block.reserve(m_open_block);
+      }
+      m_block_count = 0;
+      if (m_flag_hibernated == false)
+      {
+        m_frames.clear();
+        m_total_out = 0;
+      }
+      return Z_OK;
+#else
+      m_open_block = 0;
+      return Z_VERSION_ERROR;
+#endif
+    }
+    else if (m_block_size != 0)
+    {
+      /* raw deflate, the member header and trailer are written by hand */
+      if (m_flag_gzip == false)
+      {
+        m_open_block = 0;
+        return Z_STREAM_ERROR;
+      }
+
+      /* one state and buffer per block of a group compressed at once */
+      const size_t group = m_pool != nullptr ? 2 * (m_pool->GetThreadCount() + 1) : 1;
+      m_block_streams = std::vector<z_stream>(group);
+      for (z_stream & strm : m_block_streams)
+      {
+        ret_val = deflateInit2(&strm, m_compression_level, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY);
+        if(ret_val != Z_OK)
+        {
+          fail();
+          return ret_val;
+        }
+      }
+
+      const size_t bound = BLOCK_HEADER + deflateBound(&m_block_streams[0], m_block_size) + BLOCK_TRAILER;
+      m_blocks = std::vector<std::vector<uint8_t>>(group);
+      m_block_output = std::vector<std::vector<uint8_t>>(group, std::vector<uint8_t>(bound));
+      for (std::vector<uint8_t> & block : m_blocks)
+      {
+        block.reserve(m_block_size);
+      }
+      m_block_count = 0;
+      if (m_flag_hibernated == false)
+      {
+        m_total_out = 0;
+      }
+      return ret_val;
+    }
+    else if (m_flag_hibernated == true)
+    {
+      /* the stream goes on without a header, the trailer is written by hand */
+      ret_val = deflateInit2(&m_stream, m_compression_level, Z_DEFLATED, -windowBits, 8, Z_DEFAULT_STRATEGY);
+      if (ret_val != Z_OK)
+      {
+        return ret_val;
+      }
+    }
+    else if (m_flag_gzip == true)
     {
       ret_val = deflateInit2(&m_stream, m_compression_level, Z_DEFLATED, windowBits | GZIP_ENCODING, 8, Z_DEFAULT_STRATEGY);
       if(ret_val != Z_OK)
@@ -811,15 +4371,65 @@ extract_ret:
     }
 
     m_buffer = std::vector<uint8_t>(m_chunk_size);
-
-    m_stream.next_out = m_buffer.data();
-    m_stream.avail_out = static_cast<unsigned int>(m_buffer.size());
+    next_output();
 
     return ret_val;
   }
 
   int ZppWriter::EndZLib()
   {
+    if (m_open_block != 0)
+    {
+      if (m_flag_error == true)
+      {
+        return Z_ERRNO;
+      }
+
+      /* the rest of the data and an empty member marking the end, or the
+         seek table of zstd frames */
+      int ret_val = compress_blocks();
+      if (ret_val == Z_OK && m_format == ZPP_FORMAT_ZSTD)
+      {
+        ret_val = write_seek_table();
+      }
+      else if (ret_val == Z_OK)
+      {
+        m_block_count = 1;
+        ret_val = compress_blocks();
+      }
+      if (ret_val == Z_OK && m_sink->Flush() != Z_OK)
+      {
+        ret_val = Z_ERRNO;
+      }
+      if (ret_val != Z_OK)
+      {
+        fail();
+        return ret_val;
+      }
+#ifdef ZPP_WITH_ZSTD
+      for (ZSTD_CCtx * cctx : m_zstd_streams)
+      {
+        ZSTD_freeCCtx(cctx);
+      }
+      m_zstd_streams.clear();
+#endif
+
+      for (z_stream & strm : m_block_streams)
+      {
+        deflateEnd(&strm);
+      }
+      m_block_streams.clear();
+      return Z_OK;
+    }
+
+    /* nothing to finish after a failed Open() or write */
+    if (m_flag_error == true)
+    {
+      deflateEnd(&m_stream);
+      m_stream = {};
+      return Z_ERRNO;
+    }
+
     int flush = Z_FINISH;
     std::vector<uint8_t> temp_data;
 
@@ -831,35 +4441,57 @@ extract_ret:
     {
       if (m_stream.avail_out == 0)
       {
-        if(fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()
-           || ferror(m_file))
+        if (write_output(true) != Z_OK)
         {
-          deflateEnd(&m_stream);
-          m_stream = {};
-          m_flag_error = true;
+          fail();
           return Z_ERRNO;
         }
-
-        m_stream.next_out = m_buffer.data();
-        m_stream.avail_out = static_cast<unsigned int>(m_buffer.size());
       }
       deflate_res = deflate(&m_stream, flush);
       if (deflate_res == Z_STREAM_ERROR)
       {
-        deflateEnd(&m_stream);
-        m_stream = {};
-        m_flag_error = true;
+        fail();
         return deflate_res;
       }
     }
 
-    size_t nbytes = m_buffer.size() - m_stream.avail_out;
-    if(fwrite(m_buffer.data(), 1, nbytes, m_file) != nbytes
-       || ferror(m_file))
+    if (write_output(false) != Z_OK)
     {
-      deflateEnd(&m_stream);
-      m_stream = {};
-      m_flag_error = true;
+      fail();
+      return Z_ERRNO;
+    }
+
+    /* the trailer of a resumed stream: CRC-32 and size for gzip,
+       big endian Adler-32 for zlib */
+    if (m_flag_resumed == true)
+    {
+      unsigned char trailer[8];
+      size_t length = 4;
+      if (m_flag_gzip == true)
+      {
+        put_le32(trailer, static_cast<uint32_t>(m_check));
+        put_le32(trailer + 4, static_cast<uint32_t>(m_resumed_in + m_stream.total_in));
+        length = 8;
+      }
+      else
+      {
+        for (int i = 0; i < 4; ++i)
+        {
+          trailer[i] = static_cast<unsigned char>(m_check >> (24 - 8 * i));
+        }
+      }
+
+      if (m_sink->Write(trailer, length) != Z_OK)
+      {
+        fail();
+        return Z_ERRNO;
+      }
+      m_resumed_out += length;
+    }
+
+    if (m_sink->Flush() != Z_OK)
+    {
+      fail();
       return Z_ERRNO;
     }
     deflateEnd(&m_stream);
@@ -875,8 +4507,41 @@ extract_ret:
       return Z_ERRNO;
     }
 
+    if (m_open_block != 0)
+    {
+      while (i_size != 0)
+      {
+        /* a full group is compressed once more data arrives */
+        if (m_block_count == 0 || m_blocks[m_block_count - 1].size() == m_open_block)
+        {
+          if (m_block_count == m_blocks.size())
+          {
+            int ret_val = compress_blocks();
+            if (ret_val != Z_OK)
+            {
+              return ret_val;
+            }
+          }
+          ++m_block_count;
+        }
+
+        std::vector<uint8_t> & block = m_blocks[m_block_count - 1];
+        size_t part = std::min(i_size, m_open_block - block.size());
+        block.insert(block.end(), i_data, i_data + part);
+        i_data += part;
+        i_size -= part;
+      }
+
+      return Z_OK;
+    }
+
     int flush = Z_NO_FLUSH;
 
+    if (m_flag_resumed == true)
+    {
+      m_check = m_flag_gzip ? crc32_z(m_check, i_data, i_size) : adler32_z(m_check, i_data, i_size);
+    }
+
     m_stream.avail_in = static_cast<unsigned int>(i_size);
     m_stream.next_in = const_cast<unsigned char *>(i_data);
 
@@ -893,20 +4558,220 @@ extract_ret:
 
       if (m_stream.avail_out == 0)
       {
-        if(fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()
-           || ferror(m_file))
+        if (write_output(true) != Z_OK)
         {
           deflateEnd(&m_stream);
           m_stream = {};
           m_flag_error = true;
           return Z_ERRNO;
         }
-        m_stream.next_out = m_buffer.data();
-        m_stream.avail_out = static_cast<unsigned int>(m_buffer.size());
+        drop_written();
       }
     }
 
     return Z_OK;
   }
-}
 
+  void ZppWriter::next_output()
+  {
+    /* the sink's own memory saves a copy of every chunk */
+    m_output = m_sink->Reserve(m_buffer.size());
+    if (m_output == nullptr)
+    {
+      m_output = m_buffer.data();
+    }
+
+    m_stream.next_out = m_output;
+    m_stream.avail_out = static_cast<unsigned int>(m_buffer.size());
+  }
+
+  int ZppWriter::write_output(bool i_more)
+  {
+    size_t nbytes = m_stream.next_out - m_output;
+    int ret_val = m_output == m_buffer.data() ? m_sink->Write(m_output, nbytes) : m_sink->Commit(nbytes);
+    if (ret_val != Z_OK)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_more == true)
+    {
+      next_output();
+    }
+    else
+    {
+      m_output = nullptr;
+    }
+
+    return Z_OK;
+  }
+
+  int ZppWriter::compress_blocks()
+  {
+    std::vector<int> status(m_block_count, Z_OK);
+    std::vector<size_t> sizes(m_block_count, 0);
+    auto task = [&](size_t i_task)
+    {
+      const std::vector<uint8_t> & data = m_blocks[i_task];
+      std::vector<uint8_t> & output = m_block_output[i_task];
+#ifdef ZPP_WITH_ZSTD
+      if (m_format == ZPP_FORMAT_ZSTD)
+      {
+        size_t ret = ZSTD_compress2(m_zstd_streams[i_task], output.data(), output.size(), data.data(), data.size());
+        if (ZSTD_isError(ret))
+        {
+          status[i_task] = ZSTD_getErrorCode(ret) == ZSTD_error_memory_allocation ? Z_MEM_ERROR : Z_STREAM_ERROR;
+          return;
+        }
+        sizes[i_task] = ret;
+        return;
+      }
+#endif
+      z_stream & strm = m_block_streams[i_task];
+      const uInt bound = static_cast<uInt>(output.size() - BLOCK_HEADER - BLOCK_TRAILER);
+
+      strm.next_in = const_cast<unsigned char *>(data.data());
+      strm.avail_in = static_cast<uInt>(data.size());
+      strm.next_out = output.data() + BLOCK_HEADER;
+      strm.avail_out = bound;
+
+      /* the output buffer holds deflateBound() bytes, one call finishes */
+      int deflate_res = deflate(&strm, Z_FINISH);
+      deflateReset(&strm);
+      if (deflate_res != Z_STREAM_END)
+      {
+        status[i_task] = deflate_res == Z_OK ? Z_BUF_ERROR : deflate_res;
+        return;
+      }
+
+      size_t nbytes = BLOCK_HEADER + (bound - strm.avail_out);
+      uint32_t crc = crc32(0L, data.data(), static_cast<uInt>(data.size()));
+      put_le32(output.data() + nbytes, crc);
+      put_le32(output.data() + nbytes + 4, static_cast<uint32_t>(data.size()));
+      nbytes += BLOCK_TRAILER;
+      put_block_header(output.data(), static_cast<uint32_t>(nbytes), static_cast<uint32_t>(data.size()));
+      sizes[i_task] = nbytes;
+    };
+
+    if (m_pool != nullptr && m_block_count > 1)
+    {
+      m_pool->ParallelFor(m_block_count, task);
+    }
+    else
+    {
+      for (size_t i = 0; i < m_block_count; ++i)
+      {
+        task(i);
+      }
+    }
+
+    /* written in order, up to the first failed block, in one call if the
+       sink allows */
+    std::vector<struct iovec> parts;
+    for (size_t i = 0; i < m_block_count && status[i] == Z_OK; ++i)
+    {
+      struct iovec part;
+      part.iov_base = m_block_output[i].data();
+      part.iov_len = sizes[i];
+      parts.push_back(part);
+    }
+    if (parts.empty() == false
+        && m_sink->WriteVector(parts.data(), static_cast<int>(parts.size())) != Z_OK)
+    {
+      fail();
+      return Z_ERRNO;
+    }
+    if (parts.size() != m_block_count)
+    {
+      fail();
+      return status[parts.size()];
+    }
+
+    for (size_t i = 0; i < m_block_count; ++i)
+    {
+      m_total_out += sizes[i];
+      if (m_format == ZPP_FORMAT_ZSTD)
+      {
+        m_frames.push_back(static_cast<uint32_t>(sizes[i]));
+        m_frames.push_back(static_cast<uint32_t>(m_blocks[i].size()));
+      }
+      m_blocks[i].clear();
+    }
+
+    m_block_count = 0;
+    drop_written();
+    return Z_OK;
+  }
+
+  void ZppWriter::drop_written()
+  {
+    if (m_io_policy == ZPP_IO_DEFAULT || m_drop_from < 0 || m_file == nullptr)
+    {
+      return;
+    }
+
+    off_t pos = ftello(m_file);
+    if (pos < 0 || pos - m_drop_from < static_cast<off_t>(ZppFileSource::STREAM_WINDOW))
+    {
+      return;
+    }
+
+    /* dirty pages cannot be dropped, they are written out first */
+    int fd = fileno(m_file);
+    if (fflush(m_file) != 0)
+    {
+      return;
+    }
+    sync_file_range(fd, m_drop_from, pos - m_drop_from,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(fd, m_drop_from, pos - m_drop_from, POSIX_FADV_DONTNEED);
+    m_drop_from = pos;
+  }
+
+  void ZppWriter::fail()
+  {
+    deflateEnd(&m_stream);
+    m_stream = {};
+    for (z_stream & strm : m_block_streams)
+    {
+      deflateEnd(&strm);
+    }
+    m_block_streams.clear();
+#ifdef ZPP_WITH_ZSTD
+    for (ZSTD_CCtx * cctx : m_zstd_streams)
+    {
+      ZSTD_freeCCtx(cctx);
+    }
+    m_zstd_streams.clear();
+#endif
+    m_flag_error = true;
+  }
+
+  int ZppWriter::write_seek_table()
+  {
+    /* a skippable frame: entries of compressed and uncompressed frame
+       sizes, then the number of frames, the descriptor and the magic */
+    const size_t count = m_frames.size() / 2;
+    std::vector<unsigned char> table(SEEK_HEADER + count * SEEK_ENTRY + SEEK_FOOTER);
+    put_le32(table.data(), SEEK_TABLE_MAGIC);
+    put_le32(table.data() + 4, static_cast<uint32_t>(table.size() - SEEK_HEADER));
+    for (size_t i = 0; i < m_frames.size(); ++i)
+    {
+      put_le32(table.data() + SEEK_HEADER + i * 4, m_frames[i]);
+    }
+    unsigned char * footer = table.data() + table.size() - SEEK_FOOTER;
+    put_le32(footer, static_cast<uint32_t>(count));
+    footer[4] = 0;
+    put_le32(footer + 5, SEEKABLE_MAGIC);
+
+    if (m_sink->Write(table.data(), table.size()) != Z_OK)
+    {
+      fail();
+      return Z_ERRNO;
+    }
+
+    m_total_out += table.size();
+    m_frames.clear();
+    return Z_OK;
+  }
+}
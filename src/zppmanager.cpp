@@ -0,0 +1,170 @@
+#include "zppmanager.hpp"
+
+namespace slx
+{
+  ZppWriterManager::ZppWriterManager(const size_t i_limit)
+    : m_limit(i_limit)
+  {
+  }
+
+  int ZppWriterManager::Add(ZppWriter * i_writer)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (i_writer == nullptr || i_writer->IsReady() == false || m_map.count(i_writer) != 0)
+    {
+      return Z_ERRNO;
+    }
+
+    Entry & entry = m_map[i_writer];
+    if (i_writer->IsHibernated() == true)
+    {
+      entry.position = m_active.end();
+      return Z_OK;
+    }
+
+    m_active.push_front(i_writer);
+    entry.position = m_active.begin();
+    entry.usage = i_writer->GetMemoryUsage();
+    m_usage += entry.usage;
+    trim(i_writer);
+    return Z_OK;
+  }
+
+  void ZppWriterManager::Remove(ZppWriter * i_writer)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_map.find(i_writer);
+    if (it == m_map.end())
+    {
+      return;
+    }
+
+    if (it->second.position != m_active.end())
+    {
+      m_active.erase(it->second.position);
+      m_usage -= it->second.usage;
+    }
+    m_map.erase(it);
+  }
+
+  int ZppWriterManager::Write(ZppWriter * i_writer, const uint8_t * i_data, size_t i_size)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      auto it = m_map.find(i_writer);
+      if (it == m_map.end())
+      {
+        return Z_ERRNO;
+      }
+
+      /* the writer becomes the most recently used, a pinned one is not
+         hibernated by writes to the others */
+      Entry & entry = it->second;
+      if (entry.position == m_active.end())
+      {
+        m_active.push_front(i_writer);
+        entry.position = m_active.begin();
+      }
+      else
+      {
+        m_active.splice(m_active.begin(), m_active, entry.position);
+      }
+      ++entry.pins;
+    }
+
+    int ret_val = i_writer->Write(i_data, i_size);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    /* the writer may have been removed while writing */
+    auto it = m_map.find(i_writer);
+    if (it == m_map.end())
+    {
+      return ret_val;
+    }
+
+    Entry & entry = it->second;
+    --entry.pins;
+    if (entry.position != m_active.end())
+    {
+      const size_t usage = i_writer->GetMemoryUsage();
+      m_usage = m_usage - entry.usage + usage;
+      entry.usage = usage;
+    }
+
+    trim(i_writer);
+    return ret_val;
+  }
+
+  int ZppWriterManager::Trim()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return trim(nullptr);
+  }
+
+  void ZppWriterManager::SetLimit(const size_t i_limit)
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_limit = i_limit;
+    trim(nullptr);
+  }
+
+  size_t ZppWriterManager::GetLimit()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_limit;
+  }
+
+  size_t ZppWriterManager::GetUsage()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_usage;
+  }
+
+  size_t ZppWriterManager::GetCount()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_map.size();
+  }
+
+  size_t ZppWriterManager::GetActiveCount()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active.size();
+  }
+
+  int ZppWriterManager::trim(ZppWriter * i_keep)
+  {
+    /* the least recently used writers are hibernated first, the ones
+       being written are skipped */
+    int ret_val = Z_OK;
+    auto it = m_active.end();
+    while (m_usage > m_limit && it != m_active.begin())
+    {
+      --it;
+      ZppWriter * writer = *it;
+      Entry & entry = m_map[writer];
+      if (writer == i_keep || entry.pins != 0)
+      {
+        continue;
+      }
+
+      it = m_active.erase(it);
+      entry.position = m_active.end();
+      m_usage -= entry.usage;
+      entry.usage = 0;
+
+      int ret = writer->Hibernate();
+      if (ret != Z_OK && ret_val == Z_OK)
+      {
+        ret_val = ret;
+      }
+    }
+
+    return ret_val;
+  }
+}
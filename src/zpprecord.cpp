@@ -0,0 +1,174 @@
+#include "zpprecord.hpp"
+
+namespace slx
+{
+  ZppRecordReader::ZppRecordReader(ZppReader * i_reader, const size_t i_record_size)
+  {
+    Open(i_reader, i_record_size);
+  }
+
+  int ZppRecordReader::Open(ZppReader * i_reader, const size_t i_record_size)
+  {
+    m_reader = nullptr;
+    m_record_size = 0;
+
+    if (i_reader == nullptr || i_record_size == 0)
+    {
+      return Z_ERRNO;
+    }
+
+    m_reader = i_reader;
+    m_record_size = i_record_size;
+
+    return Z_OK;
+  }
+
+  size_t ZppRecordReader::GetRecordSize()
+  {
+    return m_record_size;
+  }
+
+  size_t ZppRecordReader::GetRecordCount()
+  {
+    if (m_reader == nullptr)
+    {
+      return 0;
+    }
+
+    return m_reader->GetSize() / m_record_size;
+  }
+
+  ssize_t ZppRecordReader::ReadRecord(const size_t i_index, uint8_t * o_data)
+  {
+    if (m_reader == nullptr || i_index >= GetRecordCount())
+    {
+      return Z_ERRNO;
+    }
+
+    return m_reader->ReadOffset(o_data, m_record_size, i_index * m_record_size);
+  }
+
+  ssize_t ZppRecordReader::ReadRecord(const size_t i_index, std::vector<uint8_t> & o_data)
+  {
+    o_data.resize(m_record_size);
+    ssize_t ret_val = ReadRecord(i_index, o_data.data());
+    if (ret_val < 0)
+    {
+      o_data.clear();
+    }
+
+    return ret_val;
+  }
+
+  ssize_t ZppRecordReader::ReadRecords(const size_t i_first, const size_t i_count, uint8_t * o_data)
+  {
+    if (m_reader == nullptr || i_first > GetRecordCount() || i_count > GetRecordCount() - i_first)
+    {
+      return Z_ERRNO;
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges(1, std::make_pair(i_first * m_record_size, i_count * m_record_size));
+    ssize_t ret_val = m_reader->ReadOffsets(ranges, o_data);
+    if (ret_val < 0)
+    {
+      return ret_val;
+    }
+
+    return static_cast<ssize_t>(i_count);
+  }
+
+  ssize_t ZppRecordReader::ReadRecords(const size_t i_first, const size_t i_count, std::vector<uint8_t> & o_data)
+  {
+    o_data.resize(i_count * m_record_size);
+    ssize_t ret_val = ReadRecords(i_first, i_count, o_data.data());
+    if (ret_val < 0)
+    {
+      o_data.clear();
+    }
+
+    return ret_val;
+  }
+
+  ssize_t ZppRecordReader::ReadRecordsStrided(const size_t i_first, const size_t i_stride, const size_t i_count, uint8_t * o_data)
+  {
+    if (i_count == 0)
+    {
+      return 0;
+    }
+
+    if (m_reader == nullptr || i_stride == 0
+        || i_first >= GetRecordCount() || (i_count - 1) > (GetRecordCount() - 1 - i_first) / i_stride)
+    {
+      return Z_ERRNO;
+    }
+
+    /* adjacent records form a single range */
+    if (i_stride == 1)
+    {
+      return ReadRecords(i_first, i_count, o_data);
+    }
+
+    std::vector<std::pair<size_t, size_t>> ranges(i_count);
+    for (size_t i = 0; i < i_count; ++i)
+    {
+      ranges[i] = std::make_pair((i_first + i * i_stride) * m_record_size, m_record_size);
+    }
+
+    ssize_t ret_val = m_reader->ReadOffsets(ranges, o_data);
+    if (ret_val < 0)
+    {
+      return ret_val;
+    }
+
+    return static_cast<ssize_t>(i_count);
+  }
+
+  ssize_t ZppRecordReader::ReadRecords(const std::vector<size_t> & i_indices, uint8_t * o_data)
+  {
+    if (m_reader == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    const size_t count = GetRecordCount();
+    std::vector<std::pair<size_t, size_t>> ranges(i_indices.size());
+    for (size_t i = 0; i < i_indices.size(); ++i)
+    {
+      if (i_indices[i] >= count)
+      {
+        return Z_ERRNO;
+      }
+      ranges[i] = std::make_pair(i_indices[i] * m_record_size, m_record_size);
+    }
+
+    ssize_t ret_val = m_reader->ReadOffsets(ranges, o_data);
+    if (ret_val < 0)
+    {
+      return ret_val;
+    }
+
+    return static_cast<ssize_t>(i_indices.size());
+  }
+
+  ssize_t ZppRecordReader::ReadColumn(const size_t i_first, const size_t i_count, const size_t i_field, const size_t i_width, const ZppByteOrder i_order, void * o_data)
+  {
+    if (m_reader == nullptr || i_field > m_record_size || i_width > m_record_size - i_field
+        || i_first > GetRecordCount() || i_count > GetRecordCount() - i_first)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_count == 0)
+    {
+      return 0;
+    }
+
+    ssize_t ret_val = m_reader->ReadColumn(o_data, i_width, i_count, i_first * m_record_size + i_field, m_record_size, i_order);
+    if (ret_val >= 0 && static_cast<size_t>(ret_val) != i_count)
+    {
+      return Z_DATA_ERROR;
+    }
+
+    return ret_val;
+  }
+}
@@ -0,0 +1,246 @@
+#include "zppreverse.hpp"
+
+#include <string.h>
+
+namespace slx
+{
+  ZppReverseReader::ZppReverseReader(ZppReader * i_reader, const size_t i_pos)
+  {
+    Open(i_reader, i_pos);
+  }
+
+  ZppReverseReader::~ZppReverseReader()
+  {
+    wait_prefetch();
+  }
+
+  int ZppReverseReader::Open(ZppReader * i_reader, const size_t i_pos)
+  {
+    wait_prefetch();
+
+    m_reader = nullptr;
+    m_pos = 0;
+    m_span_count = 0;
+    m_buffer.clear();
+    m_buffer_beg = 0;
+
+    if (i_reader == nullptr || i_reader->IsReady() == false)
+    {
+      return Z_ERRNO;
+    }
+
+    m_reader = i_reader;
+    m_pos = std::min(i_pos, m_reader->GetSize());
+
+    return Z_OK;
+  }
+
+  int ZppReverseReader::SetPos(const size_t i_pos)
+  {
+    if (m_reader == nullptr || i_pos > m_reader->GetSize())
+    {
+      return Z_ERRNO;
+    }
+
+    m_pos = i_pos;
+    return Z_OK;
+  }
+
+  size_t ZppReverseReader::GetPos()
+  {
+    return m_pos;
+  }
+
+  int ZppReverseReader::ReadByte()
+  {
+    if (m_reader == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_pos == 0)
+    {
+      return ZPP_END;
+    }
+
+    int ret_val = load(m_pos - 1);
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+
+    --m_pos;
+    return m_buffer[m_pos - m_buffer_beg];
+  }
+
+  ssize_t ZppReverseReader::Read(uint8_t * o_data, const size_t i_count)
+  {
+    if (m_reader == nullptr || o_data == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    const size_t count = std::min(i_count, m_pos);
+    const size_t first = m_pos - count;
+
+    /* the intervals are loaded from the last one, as in ReadByte() */
+    size_t end = m_pos;
+    while (end > first)
+    {
+      int ret_val = load(end - 1);
+      if (ret_val != Z_OK)
+      {
+        return ret_val;
+      }
+
+      const size_t beg = std::max(m_buffer_beg, first);
+      memcpy(o_data + (beg - first), m_buffer.data() + (beg - m_buffer_beg), end - beg);
+      end = beg;
+    }
+
+    m_pos = first;
+    return static_cast<ssize_t>(count);
+  }
+
+  ssize_t ZppReverseReader::ReadLine(std::vector<uint8_t> & o_line)
+  {
+    o_line.clear();
+
+    if (m_reader == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_pos == 0)
+    {
+      return ZPP_END;
+    }
+
+    /* the separator before the position ends the line being read */
+    int ret_val = load(m_pos - 1);
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+    if (m_buffer[m_pos - 1 - m_buffer_beg] == '\n')
+    {
+      --m_pos;
+    }
+
+    while (m_pos > 0)
+    {
+      ret_val = load(m_pos - 1);
+      if (ret_val != Z_OK)
+      {
+        o_line.clear();
+        return ret_val;
+      }
+
+      const uint8_t * data = m_buffer.data();
+      const size_t size = m_pos - m_buffer_beg;
+      const uint8_t * separator = static_cast<const uint8_t *>(memrchr(data, '\n', size));
+      const size_t beg = (separator != nullptr) ? static_cast<size_t>(separator - data) + 1 : 0;
+
+      /* a line longer than an interval is collected from its end */
+      o_line.insert(o_line.begin(), data + beg, data + size);
+      m_pos = m_buffer_beg + beg;
+
+      if (separator != nullptr)
+      {
+        break;
+      }
+    }
+
+    return static_cast<ssize_t>(o_line.size());
+  }
+
+  void ZppReverseReader::SetFlagPrefetch(bool i_flag)
+  {
+    m_flag_prefetch = i_flag;
+  }
+
+  bool ZppReverseReader::GetFlagPrefetch()
+  {
+    return m_flag_prefetch;
+  }
+
+  size_t ZppReverseReader::GetSpanCount()
+  {
+    return m_span_count;
+  }
+
+  int ZppReverseReader::load(const size_t i_pos)
+  {
+    if (m_buffer.empty() == false
+        && i_pos >= m_buffer_beg && i_pos - m_buffer_beg < m_buffer.size())
+    {
+      return Z_OK;
+    }
+
+    size_t beg = 0;
+    size_t end = 0;
+    int ret_val = m_reader->GetSpan(i_pos, beg, end);
+    if (ret_val != Z_OK)
+    {
+      return ret_val;
+    }
+
+    /* the interval is usually the one decoded in advance */
+    bool flag_ready = false;
+    if (m_pending.valid() == true && m_prefetch_beg == beg && m_prefetch.size() == end - beg)
+    {
+      flag_ready = m_pending.get() == static_cast<ssize_t>(m_prefetch.size());
+      if (flag_ready == true)
+      {
+        m_buffer.swap(m_prefetch);
+      }
+    }
+    wait_prefetch();
+
+    if (flag_ready == false)
+    {
+      m_buffer.resize(end - beg);
+      ssize_t ret = m_reader->ReadOffset(m_buffer.data(), m_buffer.size(), beg);
+      if (ret != static_cast<ssize_t>(m_buffer.size()))
+      {
+        m_buffer.clear();
+        return (ret < 0) ? static_cast<int>(ret) : Z_DATA_ERROR;
+      }
+    }
+
+    m_buffer_beg = beg;
+    ++m_span_count;
+
+    prefetch();
+    return Z_OK;
+  }
+
+  void ZppReverseReader::prefetch()
+  {
+    if (m_flag_prefetch == false || m_buffer_beg == 0)
+    {
+      return;
+    }
+
+    size_t beg = 0;
+    size_t end = 0;
+    if (m_reader->GetSpan(m_buffer_beg - 1, beg, end) != Z_OK)
+    {
+      return;
+    }
+
+    m_prefetch.resize(end - beg);
+    m_prefetch_beg = beg;
+    m_cancel = ZppCancel();
+    m_pending = m_reader->ReadOffsetAsync(m_prefetch.data(), m_prefetch.size(), beg, m_cancel);
+  }
+
+  void ZppReverseReader::wait_prefetch()
+  {
+    if (m_pending.valid() == true)
+    {
+      m_cancel.Cancel();
+      m_pending.get();
+    }
+  }
+}
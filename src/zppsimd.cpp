@@ -0,0 +1,341 @@
+#include "zppsimd.hpp"
+
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace slx
+{
+  namespace simd
+  {
+    namespace
+    {
+#if defined(__SSE2__)
+      /* byte swap of every 16-bit lane */
+      inline __m128i swap16(__m128i i_value)
+      {
+        return _mm_or_si128(_mm_slli_epi16(i_value, 8), _mm_srli_epi16(i_value, 8));
+      }
+
+      /* byte swap of every lane of width bytes */
+      inline __m128i swap_lanes(__m128i i_value, size_t i_width)
+      {
+#if defined(__SSSE3__)
+        static const __m128i masks[3] =
+        {
+          _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14),
+          _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12),
+          _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8)
+        };
+        return _mm_shuffle_epi8(i_value, masks[i_width == 2 ? 0 : (i_width == 4 ? 1 : 2)]);
+#else
+        /* reverse the 16-bit words of the lane, then the bytes of the words */
+        if (i_width == 4)
+        {
+          i_value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(i_value, 0xB1), 0xB1);
+        }
+        else if (i_width == 8)
+        {
+          i_value = _mm_shufflehi_epi16(_mm_shufflelo_epi16(i_value, 0x1B), 0x1B);
+        }
+        return swap16(i_value);
+#endif
+      }
+#endif
+
+      inline void swap_one(uint8_t * io_data, size_t i_width)
+      {
+        if (i_width == 2)
+        {
+          uint16_t value;
+          memcpy(&value, io_data, 2);
+          value = __builtin_bswap16(value);
+          memcpy(io_data, &value, 2);
+        }
+        else if (i_width == 4)
+        {
+          uint32_t value;
+          memcpy(&value, io_data, 4);
+          value = __builtin_bswap32(value);
+          memcpy(io_data, &value, 4);
+        }
+        else if (i_width == 8)
+        {
+          uint64_t value;
+          memcpy(&value, io_data, 8);
+          value = __builtin_bswap64(value);
+          memcpy(io_data, &value, 8);
+        }
+      }
+
+      /* a fixed size copy compiles to a single load and store */
+      template <size_t WIDTH>
+      void gather_fixed(const uint8_t * i_src, size_t i_stride, size_t i_count, uint8_t * o_dst)
+      {
+        for (size_t i = 0; i < i_count; ++i)
+        {
+          memcpy(o_dst + i * WIDTH, i_src + i * i_stride, WIDTH);
+        }
+      }
+    }
+
+    const uint8_t * find(const uint8_t * i_data, size_t i_size, const uint8_t * i_pattern, size_t i_pattern_size)
+    {
+      if (i_pattern_size == 0)
+      {
+        return i_data;
+      }
+      if (i_pattern_size > i_size)
+      {
+        return nullptr;
+      }
+      if (i_pattern_size == 1)
+      {
+        return static_cast<const uint8_t *>(memchr(i_data, i_pattern[0], i_size));
+      }
+
+      size_t i = 0;
+      const size_t last = i_pattern_size - 1;
+
+#if defined(__SSE2__)
+      /* compare the first and the last byte of the pattern at 16 positions at
+         once, and verify only the candidates where both match */
+      const __m128i first_byte = _mm_set1_epi8(static_cast<char>(i_pattern[0]));
+      const __m128i last_byte = _mm_set1_epi8(static_cast<char>(i_pattern[last]));
+      for (; i + last + 16 <= i_size; i += 16)
+      {
+        const __m128i block_first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i_data + i));
+        const __m128i block_last = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i_data + i + last));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+                          _mm_and_si128(_mm_cmpeq_epi8(block_first, first_byte),
+                                        _mm_cmpeq_epi8(block_last, last_byte))));
+        while (mask != 0)
+        {
+          const size_t bit = static_cast<size_t>(__builtin_ctz(mask));
+          if (memcmp(i_data + i + bit + 1, i_pattern + 1, i_pattern_size - 2) == 0)
+          {
+            return i_data + i + bit;
+          }
+          mask &= mask - 1;
+        }
+      }
+#endif
+
+      for (; i + last < i_size; ++i)
+      {
+        const uint8_t * next = static_cast<const uint8_t *>(memchr(i_data + i, i_pattern[0], i_size - last - i));
+        if (next == nullptr)
+        {
+          return nullptr;
+        }
+
+        i = static_cast<size_t>(next - i_data);
+        if (i_data[i + last] == i_pattern[last]
+            && memcmp(i_data + i + 1, i_pattern + 1, i_pattern_size - 2) == 0)
+        {
+          return i_data + i;
+        }
+      }
+
+      return nullptr;
+    }
+
+    const uint8_t * find_any(const uint8_t * i_data, size_t i_size, const uint8_t * i_set, size_t i_set_size)
+    {
+      if (i_set_size == 0)
+      {
+        return nullptr;
+      }
+      if (i_set_size == 1)
+      {
+        return static_cast<const uint8_t *>(memchr(i_data, i_set[0], i_size));
+      }
+
+      size_t i = 0;
+
+#if defined(__SSE2__)
+      /* small sets are compared byte by byte in vector registers */
+      if (i_set_size <= 8)
+      {
+        __m128i needles[8];
+        for (size_t k = 0; k < i_set_size; ++k)
+        {
+          needles[k] = _mm_set1_epi8(static_cast<char>(i_set[k]));
+        }
+
+        for (; i + 16 <= i_size; i += 16)
+        {
+          const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i_data + i));
+          __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+          for (size_t k = 1; k < i_set_size; ++k)
+          {
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[k]));
+          }
+
+          const unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(hits));
+          if (mask != 0)
+          {
+            return i_data + i + static_cast<size_t>(__builtin_ctz(mask));
+          }
+        }
+      }
+#endif
+
+      bool table[256] = {};
+      for (size_t k = 0; k < i_set_size; ++k)
+      {
+        table[i_set[k]] = true;
+      }
+
+      for (; i < i_size; ++i)
+      {
+        if (table[i_data[i]] == true)
+        {
+          return i_data + i;
+        }
+      }
+
+      return nullptr;
+    }
+
+    size_t count(const uint8_t * i_data, size_t i_size, uint8_t i_byte)
+    {
+      size_t found = 0;
+      size_t i = 0;
+
+#if defined(__SSE2__)
+      const __m128i needle = _mm_set1_epi8(static_cast<char>(i_byte));
+      for (; i + 16 <= i_size; i += 16)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i_data + i));
+        found += static_cast<size_t>(__builtin_popcount(static_cast<unsigned>(
+                   _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)))));
+      }
+#endif
+
+      for (; i < i_size; ++i)
+      {
+        found += (i_data[i] == i_byte) ? 1 : 0;
+      }
+
+      return found;
+    }
+
+    const uint8_t * find_nth(const uint8_t * i_data, size_t i_size, uint8_t i_byte, size_t & io_n)
+    {
+      if (io_n == 0)
+      {
+        return nullptr;
+      }
+
+      size_t i = 0;
+
+#if defined(__SSE2__)
+      /* count whole blocks until the one holding the n-th byte */
+      const __m128i needle = _mm_set1_epi8(static_cast<char>(i_byte));
+      for (; i + 16 <= i_size; i += 16)
+      {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(i_data + i));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        const size_t bits = static_cast<size_t>(__builtin_popcount(mask));
+        if (bits < io_n)
+        {
+          io_n -= bits;
+          continue;
+        }
+
+        for (; io_n > 1; --io_n)
+        {
+          mask &= mask - 1;
+        }
+        io_n = 0;
+        return i_data + i + static_cast<size_t>(__builtin_ctz(mask));
+      }
+#endif
+
+      for (; i < i_size; ++i)
+      {
+        if (i_data[i] == i_byte && --io_n == 0)
+        {
+          return i_data + i;
+        }
+      }
+
+      return nullptr;
+    }
+
+    void byteswap(uint8_t * io_data, size_t i_count, size_t i_width)
+    {
+      if (i_width != 2 && i_width != 4 && i_width != 8)
+      {
+        return;
+      }
+
+      const size_t size = i_count * i_width;
+      size_t i = 0;
+
+#if defined(__SSE2__)
+      for (; i + 16 <= size; i += 16)
+      {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(io_data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(io_data + i), swap_lanes(v, i_width));
+      }
+#endif
+
+      for (; i < size; i += i_width)
+      {
+        swap_one(io_data + i, i_width);
+      }
+    }
+
+    void gather(const uint8_t * i_src, size_t i_stride, size_t i_width, size_t i_count, uint8_t * o_dst, bool i_swap)
+    {
+      /* the elements are swapped in blocks that are still in the L1 cache */
+      const size_t block = 1024;
+      for (size_t done = 0; done < i_count; done += block)
+      {
+        const size_t n = i_count - done < block ? i_count - done : block;
+        const uint8_t * from = i_src + done * i_stride;
+        uint8_t * to = o_dst + done * i_width;
+
+        if (i_stride == i_width)
+        {
+          memcpy(to, from, n * i_width);
+        }
+        else if (i_width == 1)
+        {
+          gather_fixed<1>(from, i_stride, n, to);
+        }
+        else if (i_width == 2)
+        {
+          gather_fixed<2>(from, i_stride, n, to);
+        }
+        else if (i_width == 4)
+        {
+          gather_fixed<4>(from, i_stride, n, to);
+        }
+        else if (i_width == 8)
+        {
+          gather_fixed<8>(from, i_stride, n, to);
+        }
+        else
+        {
+          for (size_t i = 0; i < n; ++i)
+          {
+            memcpy(to + i * i_width, from + i * i_stride, i_width);
+          }
+        }
+
+        if (i_swap == true)
+        {
+          byteswap(to, n, i_width);
+        }
+      }
+    }
+  }
+}
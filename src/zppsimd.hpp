@@ -0,0 +1,95 @@
+#ifndef ZPPSIMD_HPP
+#define ZPPSIMD_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace slx
+{
+  //! Векторные примитивы просмотра распакованных данных
+  /*!
+     Используется SSE2, если компилятор собирает под него, иначе
+     равнозначный скалярный код
+   */
+  namespace simd
+  {
+    //! Найти образец в данных
+    /*!
+      \return Первое вхождение образца, пустой образец - начало данных
+      \return nullptr Образец не найден
+     */
+    const uint8_t * find
+    (
+        const uint8_t * i_data //!< [in] Данные
+      , size_t i_size //!< [in] Размер данных в байтах
+      , const uint8_t * i_pattern //!< [in] Образец
+      , size_t i_pattern_size //!< [in] Размер образца в байтах
+    );
+
+    //! Найти любой байт из набора
+    /*!
+      \return Первый байт данных, входящий в набор
+      \return nullptr Таких байт нет
+     */
+    const uint8_t * find_any
+    (
+        const uint8_t * i_data //!< [in] Данные
+      , size_t i_size //!< [in] Размер данных в байтах
+      , const uint8_t * i_set //!< [in] Набор байт
+      , size_t i_set_size //!< [in] Количество байт в наборе
+    );
+
+    //! Подсчитать байт в данных
+    /*!
+      \return Количество байт данных, равных i_byte
+     */
+    size_t count
+    (
+        const uint8_t * i_data //!< [in] Данные
+      , size_t i_size //!< [in] Размер данных в байтах
+      , uint8_t i_byte //!< [in] Искомый байт
+    );
+
+    //! Найти n-й байт в данных
+    /*!
+       Если таких байт меньше, io_n уменьшается на количество найденных
+
+      \return n-й (считая с 1) байт данных, равный i_byte
+      \return nullptr Таких байт меньше io_n
+     */
+    const uint8_t * find_nth
+    (
+        const uint8_t * i_data //!< [in] Данные
+      , size_t i_size //!< [in] Размер данных в байтах
+      , uint8_t i_byte //!< [in] Искомый байт
+      , size_t & io_n //!< [in,out] Номер байта, остаток для следующих данных
+    );
+
+    //! Обратить порядок байт элементов
+    /*!
+       Элементы другой ширины не меняются
+     */
+    void byteswap
+    (
+        uint8_t * io_data //!< [in,out] Элементы
+      , size_t i_count //!< [in] Количество элементов
+      , size_t i_width //!< [in] Ширина элемента: 2, 4 или 8 байт
+    );
+
+    //! Собрать поле записей в массив
+    /*!
+       Поле в начале каждой записи копируется в следующий элемент массива
+     */
+    void gather
+    (
+        const uint8_t * i_src //!< [in] Записи
+      , size_t i_stride //!< [in] Размер записи в байтах
+      , size_t i_width //!< [in] Ширина поля в байтах
+      , size_t i_count //!< [in] Количество записей
+      , uint8_t * o_dst //!< [out] Массив из i_count элементов по i_width байт
+      , bool i_swap //!< [in] Обратить порядок байт каждого элемента
+    );
+  }
+}
+
+#endif // ZPPSIMD_HPP
@@ -0,0 +1,214 @@
+#include "zppsink.hpp"
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+namespace slx
+{
+  int ZppSink::WriteVector(const struct iovec * i_parts, const int i_count)
+  {
+    for (int i = 0; i < i_count; ++i)
+    {
+      int ret = Write(static_cast<const uint8_t *>(i_parts[i].iov_base), i_parts[i].iov_len);
+      if (ret != Z_OK)
+      {
+        return ret;
+      }
+    }
+
+    return Z_OK;
+  }
+
+  uint8_t * ZppSink::Reserve(const size_t /*i_size*/)
+  {
+    return nullptr;
+  }
+
+  int ZppSink::Commit(const size_t /*i_size*/)
+  {
+    return Z_ERRNO;
+  }
+
+  int ZppSink::Flush()
+  {
+    return Z_OK;
+  }
+
+  ZppFileSink::ZppFileSink(FILE * i_file)
+    : m_file(i_file)
+  {
+  }
+
+  int ZppFileSink::Write(const uint8_t * i_data, const size_t i_size)
+  {
+    if (m_file == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    if (i_size != 0 && (fwrite(i_data, 1, i_size, m_file) != i_size || ferror(m_file)))
+    {
+      return Z_ERRNO;
+    }
+
+    return Z_OK;
+  }
+
+  int ZppFileSink::Flush()
+  {
+    if (m_file == nullptr || fflush(m_file) != 0)
+    {
+      return Z_ERRNO;
+    }
+
+    return Z_OK;
+  }
+
+  ZppFdSink::ZppFdSink(int i_fd, bool i_flag_own)
+    : m_fd(i_fd)
+    , m_flag_own(i_flag_own)
+  {
+  }
+
+  ZppFdSink::~ZppFdSink()
+  {
+    if (m_flag_own == true && m_fd >= 0)
+    {
+      close(m_fd);
+    }
+  }
+
+  int ZppFdSink::Write(const uint8_t * i_data, const size_t i_size)
+  {
+    struct iovec part;
+    part.iov_base = const_cast<uint8_t *>(i_data);
+    part.iov_len = i_size;
+    return WriteVector(&part, 1);
+  }
+
+  int ZppFdSink::WriteVector(const struct iovec * i_parts, const int i_count)
+  {
+    if (m_fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    /* writev() may stop anywhere, the rest goes in the next call */
+    std::vector<struct iovec> parts(i_parts, i_parts + i_count);
+    size_t first = 0;
+    while (first < parts.size())
+    {
+      const int count = parts.size() - first < IOV_MAX ? static_cast<int>(parts.size() - first) : IOV_MAX;
+      ssize_t done = writev(m_fd, parts.data() + first, count);
+      if (done < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return Z_ERRNO;
+      }
+
+      size_t left = static_cast<size_t>(done);
+      while (first < parts.size() && left >= parts[first].iov_len)
+      {
+        left -= parts[first].iov_len;
+        ++first;
+      }
+      if (left != 0)
+      {
+        parts[first].iov_base = static_cast<uint8_t *>(parts[first].iov_base) + left;
+        parts[first].iov_len -= left;
+      }
+    }
+
+    return Z_OK;
+  }
+
+  ZppMemorySink::ZppMemorySink(const size_t i_capacity)
+    : m_data(i_capacity)
+  {
+  }
+
+  int ZppMemorySink::Write(const uint8_t * i_data, const size_t i_size)
+  {
+    uint8_t * space = Reserve(i_size);
+    if (i_size != 0)
+    {
+      memcpy(space, i_data, i_size);
+    }
+
+    return Commit(i_size);
+  }
+
+  uint8_t * ZppMemorySink::Reserve(const size_t i_size)
+  {
+    /* growth by half keeps appends amortized linear */
+    if (m_data.size() - m_size < i_size)
+    {
+      size_t capacity = m_data.size() + m_data.size() / 2;
+      if (capacity < m_size + i_size)
+      {
+        capacity = m_size + i_size;
+      }
+      m_data.resize(capacity);
+    }
+
+    return m_data.data() + m_size;
+  }
+
+  int ZppMemorySink::Commit(const size_t i_size)
+  {
+    if (m_data.size() - m_size < i_size)
+    {
+      return Z_ERRNO;
+    }
+
+    m_size += i_size;
+    return Z_OK;
+  }
+
+  const uint8_t * ZppMemorySink::GetData()
+  {
+    return m_data.data();
+  }
+
+  size_t ZppMemorySink::GetSize()
+  {
+    return m_size;
+  }
+
+  std::vector<uint8_t> ZppMemorySink::Release()
+  {
+    /* shrinking keeps the memory, nothing is copied */
+    m_data.resize(m_size);
+    std::vector<uint8_t> data;
+    data.swap(m_data);
+    m_size = 0;
+    return data;
+  }
+
+  void ZppMemorySink::Clear()
+  {
+    m_size = 0;
+  }
+
+  ZppCallbackSink::ZppCallbackSink(ZppCallbackSink::WriteFunc i_write)
+    : m_write(i_write)
+  {
+  }
+
+  int ZppCallbackSink::Write(const uint8_t * i_data, const size_t i_size)
+  {
+    if (!m_write)
+    {
+      return Z_ERRNO;
+    }
+
+    return m_write(i_data, i_size);
+  }
+}
@@ -0,0 +1,358 @@
+#include "zppsource.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <zlib.h>
+
+namespace slx
+{
+  namespace
+  {
+    void FillFileId(const struct stat & i_stat, ZppFileId & o_id)
+    {
+      o_id.dev = static_cast<uint64_t>(i_stat.st_dev);
+      o_id.ino = static_cast<uint64_t>(i_stat.st_ino);
+      o_id.size = static_cast<uint64_t>(i_stat.st_size);
+      o_id.mtime = static_cast<int64_t>(i_stat.st_mtim.tv_sec) * 1000000000LL + i_stat.st_mtim.tv_nsec;
+    }
+
+    /* alignment of O_DIRECT offsets, lengths and buffers */
+    const size_t DIRECT_ALIGN = 4096;
+
+    /* numbers of file sources, a reused address does not hit a stale buffer */
+    std::atomic<uint64_t> source_serial(0);
+
+    /* the last block read in O_DIRECT mode by this thread */
+    struct direct_block
+    {
+      uint64_t serial = 0;
+      off_t begin = 0;
+      size_t size = 0;
+      uint8_t * data = nullptr;
+
+      ~direct_block()
+      {
+        free(data);
+      }
+    };
+
+    thread_local direct_block direct;
+  }
+
+  bool ZppFileId::operator == (const ZppFileId & i_other) const
+  {
+    return dev == i_other.dev && ino == i_other.ino
+        && size == i_other.size && mtime == i_other.mtime;
+  }
+
+  bool ZppFileId::operator < (const ZppFileId & i_other) const
+  {
+    if (dev != i_other.dev) return dev < i_other.dev;
+    if (ino != i_other.ino) return ino < i_other.ino;
+    if (size != i_other.size) return size < i_other.size;
+    return mtime < i_other.mtime;
+  }
+
+  uint64_t ZppFileId::Hash() const
+  {
+    /* FNV-1a over the fields */
+    const uint64_t fields[4] = {dev, ino, size, static_cast<uint64_t>(mtime)};
+    uint64_t hash = 14695981039346656037ULL;
+    for (uint64_t field : fields)
+    {
+      for (int i = 0; i < 8; ++i)
+      {
+        hash ^= (field >> (i * 8)) & 0xff;
+        hash *= 1099511628211ULL;
+      }
+    }
+
+    return hash != 0 ? hash : 1;
+  }
+
+  bool ZppFileId::FromFd(int i_fd, ZppFileId & o_id)
+  {
+    struct stat st;
+    if (fstat(i_fd, &st) != 0)
+    {
+      return false;
+    }
+
+    FillFileId(st, o_id);
+    return true;
+  }
+
+  bool ZppFileId::FromPath(const std::string & i_filename, ZppFileId & o_id)
+  {
+    struct stat st;
+    if (stat(i_filename.c_str(), &st) != 0)
+    {
+      return false;
+    }
+
+    FillFileId(st, o_id);
+    return true;
+  }
+
+  const uint8_t * ZppSource::Map(const off_t /*i_offset*/, size_t & o_size)
+  {
+    o_size = 0;
+    return nullptr;
+  }
+
+  bool ZppSource::GetFileId(ZppFileId & /*o_id*/)
+  {
+    return false;
+  }
+
+  ZppFileSource::ZppFileSource(const std::string & i_filename)
+  {
+    m_fd = open(i_filename.c_str(), O_RDONLY | O_CLOEXEC);
+    m_flag_own = true;
+  }
+
+  ZppFileSource::ZppFileSource(FILE * i_file)
+  {
+    if (i_file != nullptr)
+    {
+      m_fd = fileno(i_file);
+    }
+  }
+
+  ZppFileSource::ZppFileSource(int i_fd, bool i_flag_own)
+    : m_fd(i_fd)
+    , m_flag_own(i_flag_own)
+  {
+  }
+
+  ZppFileSource::~ZppFileSource()
+  {
+    if (m_fd >= 0 && m_flag_own == true)
+    {
+      close(m_fd);
+    }
+  }
+
+  ssize_t ZppFileSource::ReadAt(uint8_t * o_data, const size_t i_count, const off_t i_offset)
+  {
+    if (m_fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    if (m_policy == ZPP_IO_DIRECT)
+    {
+      return read_direct(o_data, i_count, i_offset);
+    }
+
+    size_t done = 0;
+    while (done < i_count)
+    {
+      ssize_t ret = pread(m_fd, o_data + done, i_count - done, i_offset + static_cast<off_t>(done));
+      if (ret < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return Z_ERRNO;
+      }
+
+      if (ret == 0)
+      {
+        break;
+      }
+
+      done += static_cast<size_t>(ret);
+    }
+
+    if (m_policy == ZPP_IO_STREAM && done != 0)
+    {
+      advise(i_offset, done);
+    }
+
+    return static_cast<ssize_t>(done);
+  }
+
+  ssize_t ZppFileSource::read_direct(uint8_t * o_data, const size_t i_count, const off_t i_offset)
+  {
+    if (direct.data == nullptr)
+    {
+      void * data = nullptr;
+      if (posix_memalign(&data, DIRECT_ALIGN, DIRECT_BUFFER) != 0)
+      {
+        return Z_MEM_ERROR;
+      }
+      direct.data = static_cast<uint8_t *>(data);
+    }
+
+    size_t done = 0;
+    while (done < i_count)
+    {
+      const off_t offset = i_offset + static_cast<off_t>(done);
+      if (direct.serial != m_serial || offset < direct.begin
+          || offset >= direct.begin + static_cast<off_t>(direct.size))
+      {
+        /* the aligned block containing the offset */
+        const off_t begin = offset & ~static_cast<off_t>(DIRECT_ALIGN - 1);
+        ssize_t ret;
+        do
+        {
+          ret = pread(m_fd, direct.data, DIRECT_BUFFER, begin);
+        } while (ret < 0 && errno == EINTR);
+
+        direct.serial = 0;
+        if (ret < 0)
+        {
+          return Z_ERRNO;
+        }
+
+        direct.serial = m_serial;
+        direct.begin = begin;
+        direct.size = static_cast<size_t>(ret);
+        if (offset >= begin + ret)
+        {
+          break;
+        }
+      }
+
+      const size_t skip = static_cast<size_t>(offset - direct.begin);
+      const size_t part = std::min(direct.size - skip, i_count - done);
+      memcpy(o_data + done, direct.data + skip, part);
+      done += part;
+    }
+
+    return static_cast<ssize_t>(done);
+  }
+
+  void ZppFileSource::advise(const off_t i_offset, const size_t i_count)
+  {
+    std::lock_guard<std::mutex> lock(m_scan_mutex);
+
+    /* a read not continuing the previous one starts a new scan */
+    if (i_offset != m_scan_end)
+    {
+      m_drop_from = i_offset;
+    }
+    m_scan_end = i_offset + static_cast<off_t>(i_count);
+
+    if (m_scan_end - m_drop_from >= static_cast<off_t>(STREAM_WINDOW))
+    {
+      posix_fadvise(m_fd, m_drop_from, m_scan_end - m_drop_from, POSIX_FADV_DONTNEED);
+      posix_fadvise(m_fd, m_scan_end, STREAM_WINDOW, POSIX_FADV_WILLNEED);
+      m_drop_from = m_scan_end;
+    }
+  }
+
+  int ZppFileSource::SetIoPolicy(ZppIoPolicy i_policy)
+  {
+    if (m_fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    int flags = fcntl(m_fd, F_GETFL);
+    if (flags < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    const int direct_flags = i_policy == ZPP_IO_DIRECT ? flags | O_DIRECT : flags & ~O_DIRECT;
+    if (direct_flags != flags && fcntl(m_fd, F_SETFL, direct_flags) != 0)
+    {
+      return Z_ERRNO;
+    }
+
+    posix_fadvise(m_fd, 0, 0, i_policy == ZPP_IO_STREAM ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_NORMAL);
+
+    std::lock_guard<std::mutex> lock(m_scan_mutex);
+    m_policy = i_policy;
+    m_serial = ++source_serial;
+    m_scan_end = -1;
+    m_drop_from = 0;
+    return Z_OK;
+  }
+
+  ZppIoPolicy ZppFileSource::GetIoPolicy()
+  {
+    return m_policy;
+  }
+
+  bool ZppFileSource::GetFileId(ZppFileId & o_id)
+  {
+    if (m_fd < 0)
+    {
+      return false;
+    }
+
+    return ZppFileId::FromFd(m_fd, o_id);
+  }
+
+  bool ZppFileSource::IsReady()
+  {
+    return m_fd >= 0;
+  }
+
+  int ZppFileSource::GetFd()
+  {
+    return m_fd;
+  }
+
+  ZppMemorySource::ZppMemorySource(const uint8_t * i_data, const size_t i_size)
+    : m_data(i_data)
+    , m_size(i_size)
+  {
+  }
+
+  ssize_t ZppMemorySource::ReadAt(uint8_t * o_data, const size_t i_count, const off_t i_offset)
+  {
+    size_t size = 0;
+    const uint8_t * data = Map(i_offset, size);
+    if (data == nullptr)
+    {
+      return 0;
+    }
+
+    if (size > i_count)
+    {
+      size = i_count;
+    }
+
+    memcpy(o_data, data, size);
+    return static_cast<ssize_t>(size);
+  }
+
+  const uint8_t * ZppMemorySource::Map(const off_t i_offset, size_t & o_size)
+  {
+    if (i_offset < 0 || static_cast<size_t>(i_offset) >= m_size)
+    {
+      o_size = 0;
+      return nullptr;
+    }
+
+    o_size = m_size - static_cast<size_t>(i_offset);
+    return m_data + i_offset;
+  }
+
+  ZppCallbackSource::ZppCallbackSource(ZppCallbackSource::ReadFunc i_read)
+    : m_read(i_read)
+  {
+  }
+
+  ssize_t ZppCallbackSource::ReadAt(uint8_t * o_data, const size_t i_count, const off_t i_offset)
+  {
+    if (!m_read)
+    {
+      return Z_ERRNO;
+    }
+
+    return m_read(o_data, i_count, i_offset);
+  }
+}
@@ -0,0 +1,226 @@
+#include "zppthreadpool.hpp"
+
+#include <zlib.h>
+
+namespace slx
+{
+  namespace
+  {
+    std::mutex shared_mutex;
+    bool shared_created = false;
+    size_t shared_threads = 0;
+    size_t shared_queue_limit = 1024;
+  }
+
+  void ZppCancel::Cancel()
+  {
+    m_flag->store(true);
+  }
+
+  bool ZppCancel::IsCanceled() const
+  {
+    return m_flag->load();
+  }
+
+  ZppThreadPool::ZppThreadPool(size_t i_threads, size_t i_queue_limit)
+    : m_queue_limit(i_queue_limit)
+  {
+    if (i_threads == 0)
+    {
+      i_threads = std::thread::hardware_concurrency();
+    }
+
+    if (i_threads == 0)
+    {
+      i_threads = 1;
+    }
+
+    for (size_t i = 0; i < i_threads; ++i)
+    {
+      m_threads.emplace_back(&ZppThreadPool::Work, this);
+    }
+  }
+
+  ZppThreadPool::~ZppThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_flag_stop = true;
+    }
+    m_cond.notify_all();
+
+    for (std::thread & thread : m_threads)
+    {
+      thread.join();
+    }
+  }
+
+  int ZppThreadPool::Submit(std::function<void()> i_task)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_queue_limit != 0 && m_queue.size() >= m_queue_limit)
+      {
+        return ZPP_QUEUE_FULL;
+      }
+
+      m_queue.push_back(std::move(i_task));
+    }
+    m_cond.notify_one();
+
+    return Z_OK;
+  }
+
+  void ZppThreadPool::ParallelFor(size_t i_count, const std::function<void(size_t)> & i_func)
+  {
+    /* helpers that start after all the work is taken only touch this state */
+    struct state
+    {
+      std::atomic<size_t> next{0};
+      std::atomic<bool> failed{false};
+      size_t done = 0;
+      std::exception_ptr error;  /* the first exception of a call */
+      std::mutex mutex;
+      std::condition_variable cond;
+    };
+
+    std::shared_ptr<state> st = std::make_shared<state>();
+    const std::function<void(size_t)> * func = &i_func;
+    std::function<void()> work = [st, func, i_count]()
+    {
+      /* every index is counted, even one that threw or was skipped after
+         a failure, so that the caller always waits for all the helpers:
+         they use i_func, which lives in its frame */
+      size_t finished = 0;
+      for (size_t i = st->next++; i < i_count; i = st->next++)
+      {
+        if (st->failed == false)
+        {
+          try
+          {
+            (*func)(i);
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> lock(st->mutex);
+            if (st->error == nullptr)
+            {
+              st->error = std::current_exception();
+            }
+            st->failed = true;
+          }
+        }
+        ++finished;
+      }
+
+      if (finished != 0)
+      {
+        std::lock_guard<std::mutex> lock(st->mutex);
+        st->done += finished;
+        if (st->done == i_count)
+        {
+          st->cond.notify_all();
+        }
+      }
+    };
+
+    size_t helpers = m_threads.size();
+    if (helpers > i_count)
+    {
+      helpers = i_count;
+    }
+
+    for (size_t i = 1; i < helpers; ++i)
+    {
+      if (Submit(work) != Z_OK)
+      {
+        break;
+      }
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(st->mutex);
+    st->cond.wait(lock, [&st, i_count] { return st->done == i_count; });
+
+    if (st->error != nullptr)
+    {
+      std::rethrow_exception(st->error);
+    }
+  }
+
+  size_t ZppThreadPool::GetThreadCount()
+  {
+    return m_threads.size();
+  }
+
+  size_t ZppThreadPool::GetQueueSize()
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+  }
+
+  size_t ZppThreadPool::GetQueueLimit()
+  {
+    return m_queue_limit;
+  }
+
+  ZppThreadPool & ZppThreadPool::Shared()
+  {
+    size_t threads = 0;
+    size_t queue_limit = 0;
+    {
+      std::lock_guard<std::mutex> lock(shared_mutex);
+      shared_created = true;
+      threads = shared_threads;
+      queue_limit = shared_queue_limit;
+    }
+
+    static ZppThreadPool pool(threads, queue_limit);
+    return pool;
+  }
+
+  int ZppThreadPool::ConfigureShared(size_t i_threads, size_t i_queue_limit)
+  {
+    std::lock_guard<std::mutex> lock(shared_mutex);
+    if (shared_created == true)
+    {
+      return Z_ERRNO;
+    }
+
+    shared_threads = i_threads;
+    shared_queue_limit = i_queue_limit;
+
+    return Z_OK;
+  }
+
+  void ZppThreadPool::Work()
+  {
+    while (true)
+    {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return m_flag_stop == true || m_queue.empty() == false; });
+
+        /* the queue is drained before stopping */
+        if (m_queue.empty() == true)
+        {
+          return;
+        }
+
+        task = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      try
+      {
+        task();
+      }
+      catch (...)
+      {
+        /* an exception must not take the worker down */
+      }
+    }
+  }
+}
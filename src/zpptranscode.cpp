@@ -0,0 +1,291 @@
+#include "zpptranscode.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace slx
+{
+  namespace
+  {
+    /* passes the output on, keeping its size */
+    class counting_sink : public ZppSink
+    {
+    public:
+      explicit counting_sink(ZppSink * i_target)
+        : target(i_target)
+      {
+      }
+
+      int Write(const uint8_t * i_data, const size_t i_size) override
+      {
+        return account(target->Write(i_data, i_size), i_size);
+      }
+
+      int WriteVector(const struct iovec * i_parts, const int i_count) override
+      {
+        size_t part_size = 0;
+        for (int i = 0; i < i_count; ++i)
+        {
+          part_size += i_parts[i].iov_len;
+        }
+        return account(target->WriteVector(i_parts, i_count), part_size);
+      }
+
+      uint8_t * Reserve(const size_t i_size) override
+      {
+        return target->Reserve(i_size);
+      }
+
+      int Commit(const size_t i_size) override
+      {
+        return account(target->Commit(i_size), i_size);
+      }
+
+      int Flush() override
+      {
+        return account(target->Flush(), 0);
+      }
+
+      ZppSink * target;
+      size_t size = 0;
+
+    private:
+      int account(int i_ret, size_t i_size)
+      {
+        if (i_ret == Z_OK)
+        {
+          size += i_size;
+        }
+        return i_ret;
+      }
+    };
+  }
+
+  //! Группа участков, распаковываемых одновременно
+  struct ZppTranscoder::group
+  {
+    std::vector<uint8_t> data;
+    size_t offset = 0;
+    std::vector<std::pair<size_t, size_t>> spans;
+    std::vector<std::future<ssize_t>> pending;
+    ZppCancel cancel;
+  };
+
+  int ZppTranscoder::Transcode(ZppReader * i_reader, ZppSink * o_sink)
+  {
+    m_total_in = 0;
+    m_total_out = 0;
+
+    if (i_reader == nullptr || i_reader->IsReady() == false || o_sink == nullptr)
+    {
+      return Z_ERRNO;
+    }
+
+    counting_sink sink(o_sink);
+    ZppWriter writer;
+    writer.SetFormat(m_format);
+    writer.SetFlagGzip(true);
+    writer.SetCompressionLevel(m_compression_level);
+    writer.SetChunkSize(65536);
+    writer.SetBlockSize(m_block_size);
+    writer.SetThreadPool(m_pool);
+    int ret = writer.Open(&sink);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+
+    /* a group gives every thread of the pool two blocks to compress */
+    ZppThreadPool & pool = (m_pool != nullptr) ? *m_pool : ZppThreadPool::Shared();
+    const size_t threads = std::max(pool.GetThreadCount(), static_cast<size_t>(1));
+    const size_t group_size = threads * m_block_size * 2;
+    const size_t total = i_reader->GetSize();
+
+    group cur;
+    group next;
+    ret = start_group(i_reader, cur, 0, group_size);
+
+    while (ret == Z_OK && cur.data.empty() == false)
+    {
+      ret = finish_group(i_reader, cur);
+      if (ret != Z_OK)
+      {
+        break;
+      }
+
+      /* the next group is decoded while this one is compressed */
+      const size_t end = cur.offset + cur.data.size();
+      next.data.clear();
+      if (end < total)
+      {
+        ret = start_group(i_reader, next, end, group_size);
+        if (ret != Z_OK)
+        {
+          break;
+        }
+      }
+
+      ret = writer.Write(cur.data.data(), cur.data.size());
+      if (ret != Z_OK)
+      {
+        next.cancel.Cancel();
+        finish_group(i_reader, next);
+        break;
+      }
+
+      m_total_in += cur.data.size();
+      std::swap(cur, next);
+    }
+
+    int close_ret = writer.Close();
+    if (ret == Z_OK)
+    {
+      ret = close_ret;
+    }
+
+    m_total_out = sink.size;
+    return ret;
+  }
+
+  int ZppTranscoder::Transcode(ZppReader * i_reader, const std::string & i_filename)
+  {
+    int fd = open(i_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+      return Z_ERRNO;
+    }
+
+    ZppFdSink sink(fd);
+    int ret = Transcode(i_reader, &sink);
+    if (close(fd) != 0 && ret == Z_OK)
+    {
+      ret = Z_ERRNO;
+    }
+
+    if (ret != Z_OK)
+    {
+      unlink(i_filename.c_str());
+    }
+
+    return ret;
+  }
+
+  size_t ZppTranscoder::GetBlockSize()
+  {
+    return m_block_size;
+  }
+
+  void ZppTranscoder::SetBlockSize(size_t i_size)
+  {
+    m_block_size = i_size;
+    if (m_block_size == 0)
+    {
+      m_block_size = DEFAULT_BLOCK_SIZE;
+    }
+    if (m_block_size > ZppWriter::MAX_BLOCK_SIZE)
+    {
+      m_block_size = ZppWriter::MAX_BLOCK_SIZE;
+    }
+  }
+
+  int ZppTranscoder::GetCompressionLevel()
+  {
+    return m_compression_level;
+  }
+
+  void ZppTranscoder::SetCompressionLevel(int i_level)
+  {
+    m_compression_level = i_level;
+  }
+
+  ZppFormat ZppTranscoder::GetFormat()
+  {
+    return m_format;
+  }
+
+  void ZppTranscoder::SetFormat(ZppFormat i_format)
+  {
+    m_format = i_format;
+  }
+
+  void ZppTranscoder::SetThreadPool(ZppThreadPool * i_pool)
+  {
+    m_pool = i_pool;
+  }
+
+  size_t ZppTranscoder::GetTotalIn()
+  {
+    return m_total_in;
+  }
+
+  size_t ZppTranscoder::GetTotalOut()
+  {
+    return m_total_out;
+  }
+
+  int ZppTranscoder::start_group(ZppReader * i_reader, group & io_group, size_t i_offset, size_t i_size)
+  {
+    io_group.offset = i_offset;
+    io_group.spans.clear();
+    io_group.pending.clear();
+    io_group.cancel = ZppCancel();
+
+    /* the group ends at the end of a span, so that the next one starts at
+       an access point */
+    const size_t total = i_reader->GetSize();
+    const size_t target = (total - i_offset > i_size) ? i_offset + i_size : total;
+    size_t pos = i_offset;
+    while (pos < target)
+    {
+      size_t beg = 0;
+      size_t end = 0;
+      int ret = i_reader->GetSpan(pos, beg, end);
+      if (ret != Z_OK)
+      {
+        return ret;
+      }
+
+      io_group.spans.push_back(std::make_pair(pos, end));
+      pos = end;
+    }
+
+    io_group.data.resize(pos - i_offset);
+    for (const std::pair<size_t, size_t> & span : io_group.spans)
+    {
+      io_group.pending.push_back(i_reader->ReadOffsetAsync(io_group.data.data() + (span.first - i_offset)
+                                                           , span.second - span.first
+                                                           , span.first
+                                                           , io_group.cancel));
+    }
+
+    return Z_OK;
+  }
+
+  int ZppTranscoder::finish_group(ZppReader * i_reader, group & io_group)
+  {
+    /* every result is taken, the tasks write into the group */
+    int ret_val = Z_OK;
+    for (size_t i = 0; i < io_group.pending.size(); ++i)
+    {
+      const size_t beg = io_group.spans[i].first;
+      const size_t size = io_group.spans[i].second - beg;
+
+      ssize_t ret = io_group.pending[i].get();
+      if (ret == ZPP_QUEUE_FULL && io_group.cancel.IsCanceled() == false)
+      {
+        ret = i_reader->ReadOffset(io_group.data.data() + (beg - io_group.offset), size, beg);
+      }
+      if (ret >= 0 && static_cast<size_t>(ret) != size)
+      {
+        ret = Z_DATA_ERROR;
+      }
+      if (ret < 0 && ret_val == Z_OK)
+      {
+        ret_val = static_cast<int>(ret);
+      }
+    }
+
+    io_group.pending.clear();
+    return ret_val;
+  }
+}
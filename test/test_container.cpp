@@ -0,0 +1,156 @@
+#include "zpptest.hpp"
+
+#include "zppcontainer.hpp"
+
+#include <string.h>
+
+using namespace slx;
+
+namespace
+{
+  const size_t TRAILER_SIZE = 32;
+
+  std::vector<std::vector<uint8_t>> make_records(size_t i_count)
+  {
+    std::vector<std::vector<uint8_t>> records;
+    unsigned int seed = 7;
+    for (size_t i = 0; i < i_count; ++i)
+    {
+      const size_t size = i % 10 == 0 ? 0 : 20 + rand_r(&seed) % 300;
+      std::vector<uint8_t> record = test::MakeText(size, static_cast<unsigned int>(i + 1));
+      records.push_back(record);
+    }
+    return records;
+  }
+
+  int write_container(const std::string & i_filename, const std::vector<std::vector<uint8_t>> & i_records)
+  {
+    ZppContainerWriter writer;
+    writer.SetGroupSize(16);
+    writer.SetDictionary(test::MakeText(4096));
+    int ret = writer.Open(i_filename);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+
+    for (const std::vector<uint8_t> & record : i_records)
+    {
+      if (writer.Write(record) < 0)
+      {
+        return Z_ERRNO;
+      }
+    }
+
+    return writer.Close();
+  }
+
+  void put_le64(uint8_t * o_data, uint64_t i_value)
+  {
+    for (int i = 0; i < 8; ++i)
+    {
+      o_data[i] = static_cast<uint8_t>(i_value >> (8 * i));
+    }
+  }
+}
+
+TEST(ZppContainer, RoundTrip)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("records.zpc");
+  const std::vector<std::vector<uint8_t>> records = make_records(500);
+  ASSERT_EQ(write_container(name, records), Z_OK);
+
+  ZppContainerReader reader;
+  ASSERT_EQ(reader.Open(name), Z_OK);
+  ASSERT_EQ(reader.GetRecordCount(), records.size());
+  EXPECT_EQ(reader.GetDictionary(), test::MakeText(4096));
+
+  /* every record alone, from the end so no group is decoded in order */
+  std::vector<uint8_t> record;
+  for (size_t i = records.size(); i-- != 0; )
+  {
+    ASSERT_EQ(reader.ReadRecord(i, record), static_cast<ssize_t>(records[i].size())) << i;
+    ASSERT_EQ(record, records[i]) << i;
+  }
+
+  /* a run crossing group boundaries */
+  std::vector<std::vector<uint8_t>> run;
+  ASSERT_EQ(reader.ReadRecords(10, 100, run), 100);
+  for (size_t i = 0; i < run.size(); ++i)
+  {
+    EXPECT_EQ(run[i], records[10 + i]) << i;
+  }
+
+  EXPECT_LT(reader.ReadRecord(records.size(), record), 0);
+}
+
+TEST(ZppContainer, EmptyContainer)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("empty.zpc");
+  ASSERT_EQ(write_container(name, std::vector<std::vector<uint8_t>>()), Z_OK);
+
+  ZppContainerReader reader;
+  ASSERT_EQ(reader.Open(name), Z_OK);
+  EXPECT_EQ(reader.GetRecordCount(), 0u);
+}
+
+TEST(ZppContainer, SettingsKeptWhileOpen)
+{
+  test::TempDir dir;
+  ZppContainerWriter writer;
+  EXPECT_EQ(writer.SetGroupSize(0), Z_STREAM_ERROR);
+  ASSERT_EQ(writer.SetGroupSize(8), Z_OK);
+  ASSERT_EQ(writer.Open(dir.Path("open.zpc")), Z_OK);
+
+  EXPECT_EQ(writer.SetGroupSize(4), Z_ERRNO);
+  EXPECT_EQ(writer.SetDictionary(test::MakeText(100)), Z_ERRNO);
+  EXPECT_EQ(writer.GetGroupSize(), 8u);
+  EXPECT_TRUE(writer.GetDictionary().empty());
+  EXPECT_EQ(writer.Close(), Z_OK);
+}
+
+TEST(ZppContainer, CorruptTrailerRejected)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("records.zpc");
+  const std::string bad = dir.Path("bad.zpc");
+  ASSERT_EQ(write_container(name, make_records(100)), Z_OK);
+  const std::vector<uint8_t> data = test::ReadFile(name);
+  ASSERT_GT(data.size(), TRAILER_SIZE);
+  const size_t trailer = data.size() - TRAILER_SIZE;
+
+  std::vector<uint8_t> corrupt = data;
+  memcpy(corrupt.data() + trailer + 24, "ZPPCEND0", 8);
+  ASSERT_TRUE(test::WriteFile(bad, corrupt));
+  ZppContainerReader magic;
+  EXPECT_EQ(magic.Open(bad), Z_DATA_ERROR);
+
+  /* the table beyond the end of the file */
+  corrupt = data;
+  put_le64(corrupt.data() + trailer, data.size());
+  ASSERT_TRUE(test::WriteFile(bad, corrupt));
+  ZppContainerReader offset;
+  EXPECT_EQ(offset.Open(bad), Z_DATA_ERROR);
+
+  /* more records than the table holds */
+  corrupt = data;
+  put_le64(corrupt.data() + trailer + 8, 1u << 30);
+  ASSERT_TRUE(test::WriteFile(bad, corrupt));
+  ZppContainerReader records;
+  EXPECT_EQ(records.Open(bad), Z_DATA_ERROR);
+
+  /* a group count that does not match the records */
+  corrupt = data;
+  put_le64(corrupt.data() + trailer + 16, 1);
+  ASSERT_TRUE(test::WriteFile(bad, corrupt));
+  ZppContainerReader groups;
+  EXPECT_EQ(groups.Open(bad), Z_DATA_ERROR);
+
+  /* a truncated file */
+  corrupt.assign(data.begin(), data.end() - 5);
+  ASSERT_TRUE(test::WriteFile(bad, corrupt));
+  ZppContainerReader truncated;
+  EXPECT_EQ(truncated.Open(bad), Z_DATA_ERROR);
+}
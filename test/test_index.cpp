@@ -0,0 +1,122 @@
+#include "zpptest.hpp"
+
+#include "zpplib.hpp"
+
+using namespace slx;
+
+namespace
+{
+  const size_t INDEX_HEADER = 64;
+
+  /* a deflate stream long enough for several access points */
+  std::vector<uint8_t> write_gzip(const std::string & i_filename, size_t i_size)
+  {
+    const std::vector<uint8_t> text = test::MakeText(i_size, 11);
+    ZppWriter writer;
+    if (writer.Open(i_filename) != Z_OK
+        || writer.Write(text.data(), text.size()) != Z_OK
+        || writer.Close() != Z_OK)
+    {
+      return std::vector<uint8_t>();
+    }
+    return text;
+  }
+
+  bool read_matches(ZppReader & io_reader, const std::vector<uint8_t> & i_text, size_t i_offset)
+  {
+    std::vector<uint8_t> data(4096);
+    const ssize_t got = io_reader.ReadOffset(data.data(), data.size(), i_offset);
+    if (got != static_cast<ssize_t>(data.size()))
+    {
+      return false;
+    }
+    return std::equal(data.begin(), data.end(), i_text.begin() + i_offset);
+  }
+}
+
+TEST(ZppReaderIndex, SaveLoadRoundTrip)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("data.gz");
+  const std::string index_name = dir.Path("data.idx");
+  const std::vector<uint8_t> text = write_gzip(name, 6 << 20);
+  ASSERT_FALSE(text.empty());
+
+  int points = 0;
+  {
+    ZppReader reader;
+    points = reader.Open(name);
+    ASSERT_GT(points, 1);
+    ASSERT_EQ(reader.SaveIndex(index_name), Z_OK);
+  }
+
+  ZppReader reader;
+  ASSERT_EQ(reader.Open(name, false), 0);
+  ASSERT_EQ(reader.LoadIndex(index_name), points);
+  EXPECT_EQ(reader.GetSize(), text.size());
+  for (size_t offset : {size_t(0), size_t(1 << 20), size_t(3000000), text.size() - 4096})
+  {
+    EXPECT_TRUE(read_matches(reader, text, offset)) << offset;
+  }
+}
+
+TEST(ZppReaderIndex, DamagedIndexRejected)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("data.gz");
+  const std::string index_name = dir.Path("data.idx");
+  const std::string bad_name = dir.Path("bad.idx");
+  ASSERT_FALSE(write_gzip(name, 3 << 20).empty());
+  {
+    ZppReader reader;
+    ASSERT_GT(reader.Open(name), 0);
+    ASSERT_EQ(reader.SaveIndex(index_name), Z_OK);
+  }
+  const std::vector<uint8_t> index = test::ReadFile(index_name);
+  ASSERT_GT(index.size(), INDEX_HEADER);
+
+  std::vector<std::vector<uint8_t>> damaged;
+  /* truncated in the header, in the points and by one byte */
+  damaged.emplace_back(index.begin(), index.begin() + INDEX_HEADER / 2);
+  damaged.emplace_back(index.begin(), index.begin() + index.size() / 2);
+  damaged.emplace_back(index.begin(), index.end() - 1);
+  /* no points */
+  damaged.push_back(index);
+  std::fill(damaged.back().begin() + 16, damaged.back().begin() + 24, 0);
+  /* the first point not at the start of the data */
+  damaged.push_back(index);
+  damaged.back()[INDEX_HEADER] = 1;
+  /* compressed size beyond the data file */
+  damaged.push_back(index);
+  damaged.back()[24 + 6] = 0x7f;
+  /* no span */
+  damaged.push_back(index);
+  std::fill(damaged.back().begin() + 56, damaged.back().begin() + 64, 0);
+
+  for (size_t i = 0; i < damaged.size(); ++i)
+  {
+    ASSERT_TRUE(test::WriteFile(bad_name, damaged[i]));
+    ZppReader reader;
+    ASSERT_EQ(reader.Open(name, false), 0);
+    EXPECT_EQ(reader.LoadIndex(bad_name), Z_DATA_ERROR) << i;
+    EXPECT_FALSE(reader.IsReady()) << i;
+  }
+}
+
+TEST(ZppReaderIndex, OtherDataRejected)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("data.gz");
+  const std::string index_name = dir.Path("data.idx");
+  ASSERT_FALSE(write_gzip(name, 2 << 20).empty());
+  {
+    ZppReader reader;
+    ASSERT_GT(reader.Open(name), 0);
+    ASSERT_EQ(reader.SaveIndex(index_name), Z_OK);
+  }
+
+  ASSERT_FALSE(write_gzip(name, 1 << 20).empty());
+  ZppReader reader;
+  ASSERT_EQ(reader.Open(name, false), 0);
+  EXPECT_EQ(reader.LoadIndex(index_name), Z_DATA_ERROR);
+}
@@ -0,0 +1,44 @@
+#include "zpptest.hpp"
+
+#include "zpplib.hpp"
+#include "zppsource.hpp"
+
+using namespace slx;
+
+TEST(ZppReaderClone, FollowingReaderOnSource)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("growing.gz");
+  const std::vector<uint8_t> text = test::MakeText(1 << 20, 13);
+  const size_t half = text.size() / 2;
+
+  /* the first half is flushed, the stream is not finished yet */
+  ZppWriter writer;
+  ASSERT_EQ(writer.Open(name), Z_OK);
+  ASSERT_EQ(writer.Write(text.data(), half), Z_OK);
+  ASSERT_EQ(writer.Hibernate(), Z_OK);
+
+  ZppFileSource source(name);
+  ASSERT_TRUE(source.IsReady());
+  ZppReader reader;
+  reader.SetFlagFollow(true);
+  ASSERT_GE(reader.Open(&source), 0);
+  ASSERT_TRUE(reader.IsReady());
+
+  ZppReader clone = reader.Clone();
+  ASSERT_TRUE(clone.IsReady());
+  EXPECT_TRUE(clone.GetFlagFollow());
+  EXPECT_EQ(clone.GetSize(), reader.GetSize());
+
+  std::vector<uint8_t> data(1000);
+  ASSERT_EQ(clone.ReadOffset(data.data(), data.size(), 1000), 1000);
+  EXPECT_TRUE(std::equal(data.begin(), data.end(), text.begin() + 1000));
+
+  /* the clone follows the file on its own */
+  ASSERT_EQ(writer.Write(text.data() + half, text.size() - half), Z_OK);
+  ASSERT_EQ(writer.Close(), Z_OK);
+  ASSERT_GT(clone.Refresh(), 0);
+  EXPECT_EQ(clone.GetSize(), text.size());
+  ASSERT_EQ(clone.ReadOffset(data.data(), data.size(), text.size() - 1000), 1000);
+  EXPECT_TRUE(std::equal(data.begin(), data.end(), text.end() - 1000));
+}
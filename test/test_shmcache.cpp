@@ -0,0 +1,129 @@
+#include "zpptest.hpp"
+
+#include "zppcache.hpp"
+
+#include <chrono>
+#include <signal.h>
+#include <sys/wait.h>
+
+using namespace slx;
+
+namespace
+{
+  /* a segment per test and process, removed at the end */
+  class SegmentName
+  {
+  public:
+    explicit SegmentName(const std::string & i_test)
+      : m_name("/zpptest_" + i_test + "_" + std::to_string(getpid()))
+    {
+      ZppShmSpanCache::Remove(m_name);
+    }
+
+    ~SegmentName()
+    {
+      ZppShmSpanCache::Remove(m_name);
+    }
+
+    const std::string & Get() const
+    {
+      return m_name;
+    }
+
+  private:
+    std::string m_name;
+  };
+
+  ZppSpanKey make_key(uint64_t i_offset)
+  {
+    ZppSpanKey key;
+    key.file = 0x1234567890abcdefULL;
+    key.offset = i_offset;
+    return key;
+  }
+}
+
+TEST(ZppShmSpanCache, SharedBetweenProcesses)
+{
+  SegmentName name("shared");
+  const std::vector<uint8_t> span = test::MakeText(100000);
+
+  /* the child decodes the span, the parent finds it in the segment */
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    ZppShmSpanCache cache(name.Get(), 1 << 22, 131072);
+    uint8_t byte = 0;
+    if (cache.IsReady() == false || cache.Lookup(make_key(0), 0, &byte, 1) == true)
+    {
+      _exit(1);
+    }
+    cache.Insert(make_key(0), span.data(), span.size());
+    _exit(0);
+  }
+
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  ZppShmSpanCache cache(name.Get(), 1 << 22, 131072);
+  ASSERT_TRUE(cache.IsReady());
+  EXPECT_EQ(cache.GetSlotSize(), 131072u);
+
+  std::vector<uint8_t> data(1000);
+  ASSERT_TRUE(cache.Lookup(make_key(0), 5000, data.data(), data.size()));
+  EXPECT_TRUE(std::equal(data.begin(), data.end(), span.begin() + 5000));
+
+  /* a read past the end of the span is a miss */
+  EXPECT_FALSE(cache.Lookup(make_key(0), span.size() - 10, data.data(), data.size()));
+  cache.Cancel(make_key(0));
+}
+
+TEST(ZppShmSpanCache, WaitBudgetBounded)
+{
+  SegmentName name("wait");
+
+  /* the child claims the span and never inserts it while alive */
+  int pipe_fd[2];
+  ASSERT_EQ(pipe(pipe_fd), 0);
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0)
+  {
+    ZppShmSpanCache cache(name.Get(), 1 << 22, 131072);
+    uint8_t byte = 0;
+    const char claimed = cache.Lookup(make_key(0), 0, &byte, 1) ? 0 : 1;
+    if (write(pipe_fd[1], &claimed, 1) != 1)
+    {
+      _exit(1);
+    }
+    pause();
+    _exit(0);
+  }
+
+  char claimed = 0;
+  ASSERT_EQ(read(pipe_fd[0], &claimed, 1), 1);
+  close(pipe_fd[0]);
+  close(pipe_fd[1]);
+  ASSERT_EQ(claimed, 1);
+
+  ZppShmSpanCache cache(name.Get(), 1 << 22, 131072, 0600, 20000);
+  uint8_t byte = 0;
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(cache.Lookup(make_key(0), 0, &byte, 1));
+  const auto waited = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(waited, std::chrono::milliseconds(20));
+  EXPECT_LT(waited, std::chrono::milliseconds(1000));
+
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+
+  /* the slot of a dead process is taken over at once */
+  ZppShmSpanCache patient(name.Get(), 1 << 22, 131072, 0600, 5000000);
+  const auto again = std::chrono::steady_clock::now();
+  EXPECT_FALSE(patient.Lookup(make_key(0), 0, &byte, 1));
+  EXPECT_LT(std::chrono::steady_clock::now() - again, std::chrono::milliseconds(1000));
+  patient.Cancel(make_key(0));
+}
@@ -0,0 +1,105 @@
+#include "zpptest.hpp"
+
+#include "zpplib.hpp"
+
+using namespace slx;
+
+namespace
+{
+  /* all data of the split through a reader opened from its description */
+  int read_split(const std::string & i_filename, const ZppSplit & i_split, std::vector<uint8_t> & o_data)
+  {
+    ZppSplitReader reader;
+    int ret = reader.Open(i_filename, i_split);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+
+    o_data.clear();
+    std::vector<uint8_t> buffer(100000);
+    ssize_t got = 0;
+    while ((got = reader.Read(buffer.data(), buffer.size())) > 0)
+    {
+      o_data.insert(o_data.end(), buffer.begin(), buffer.begin() + got);
+    }
+    return got < 0 ? static_cast<int>(got) : Z_OK;
+  }
+}
+
+TEST(ZppSplit, SerializeRoundTrip)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("data.gz");
+  const std::vector<uint8_t> text = test::MakeText(6 << 20, 5);
+  {
+    ZppWriter writer;
+    ASSERT_EQ(writer.Open(name), Z_OK);
+    ASSERT_EQ(writer.Write(text.data(), text.size()), Z_OK);
+    ASSERT_EQ(writer.Close(), Z_OK);
+  }
+
+  std::vector<ZppSplit> splits;
+  {
+    ZppReader reader;
+    ASSERT_GT(reader.Open(name), 0);
+    ASSERT_GT(reader.PlanSplits(4, splits, 0, true), 1);
+  }
+
+  /* each split passes through bytes as it would to another process */
+  std::vector<uint8_t> joined;
+  for (size_t i = 0; i < splits.size(); ++i)
+  {
+    const std::vector<uint8_t> bytes = splits[i].Serialize();
+    ZppSplit split;
+    ASSERT_EQ(split.Deserialize(bytes.data(), bytes.size()), Z_OK) << i;
+    EXPECT_EQ(split.begin, splits[i].begin);
+    EXPECT_EQ(split.end, splits[i].end);
+    EXPECT_EQ(split.window, splits[i].window);
+    EXPECT_EQ(split.Serialize(), bytes);
+
+    /* a split starts at a line */
+    if (split.begin != 0)
+    {
+      EXPECT_EQ(text[split.begin - 1], '\n') << i;
+    }
+
+    std::vector<uint8_t> data;
+    ASSERT_EQ(read_split(name, split, data), Z_OK) << i;
+    ASSERT_EQ(data.size(), split.end - split.begin) << i;
+    joined.insert(joined.end(), data.begin(), data.end());
+  }
+  EXPECT_EQ(joined, text);
+}
+
+TEST(ZppSplit, DamagedDescriptionRejected)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("data.gz");
+  const std::vector<uint8_t> text = test::MakeText(3 << 20, 9);
+  {
+    ZppWriter writer;
+    ASSERT_EQ(writer.Open(name), Z_OK);
+    ASSERT_EQ(writer.Write(text.data(), text.size()), Z_OK);
+    ASSERT_EQ(writer.Close(), Z_OK);
+  }
+
+  std::vector<ZppSplit> splits;
+  {
+    ZppReader reader;
+    ASSERT_GT(reader.Open(name), 0);
+    ASSERT_GT(reader.PlanSplits(2, splits), 1);
+  }
+  const std::vector<uint8_t> bytes = splits.back().Serialize();
+
+  ZppSplit split;
+  EXPECT_EQ(split.Deserialize(bytes.data(), bytes.size() - 1), Z_DATA_ERROR);
+  EXPECT_EQ(split.Deserialize(bytes.data(), 4), Z_DATA_ERROR);
+  EXPECT_EQ(split.Deserialize(nullptr, 0), Z_DATA_ERROR);
+
+  /* a description of another file */
+  ASSERT_EQ(split.Deserialize(bytes.data(), bytes.size()), Z_OK);
+  split.file.size += 1;
+  ZppSplitReader reader;
+  EXPECT_EQ(reader.Open(name, split), Z_DATA_ERROR);
+}
@@ -0,0 +1,154 @@
+#include "zpptest.hpp"
+
+#include "zpplib.hpp"
+#include "zppmanager.hpp"
+
+using namespace slx;
+
+namespace
+{
+  /* writes the text in pieces, hibernating the writer between them */
+  int write_hibernating(const std::string & i_filename, bool i_flag_gzip, const std::vector<uint8_t> & i_text)
+  {
+    ZppWriter writer;
+    writer.SetFlagGzip(i_flag_gzip);
+    int ret = writer.Open(i_filename);
+    if (ret != Z_OK)
+    {
+      return ret;
+    }
+
+    const size_t piece = i_text.size() / 7 + 1;
+    for (size_t done = 0; done < i_text.size(); done += piece)
+    {
+      const size_t size = i_text.size() - done < piece ? i_text.size() - done : piece;
+      if (writer.Write(i_text.data() + done, size) != Z_OK)
+      {
+        return Z_ERRNO;
+      }
+
+      ret = writer.Hibernate();
+      if (ret != Z_OK || writer.IsHibernated() == false || writer.GetMemoryUsage() != 0)
+      {
+        return ret != Z_OK ? ret : Z_ERRNO;
+      }
+    }
+
+    return writer.Close();
+  }
+}
+
+TEST(ZppWriterHibernate, GzipStream)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("hibernate.gz");
+  const std::vector<uint8_t> text = test::MakeText(1 << 20);
+  ASSERT_EQ(write_hibernating(name, true, text), Z_OK);
+
+  std::vector<uint8_t> data;
+  ASSERT_EQ(test::Inflate(test::ReadFile(name), true, data), Z_OK);
+  EXPECT_EQ(data, text);
+
+  ZppReader reader;
+  ASSERT_GT(reader.Open(name), 0);
+  std::vector<uint8_t> part(1000);
+  ASSERT_EQ(reader.ReadOffset(part.data(), part.size(), 500000), 1000);
+  EXPECT_TRUE(std::equal(part.begin(), part.end(), text.begin() + 500000));
+}
+
+TEST(ZppWriterHibernate, ZlibStream)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("hibernate.z");
+  const std::vector<uint8_t> text = test::MakeText(1 << 20, 3);
+  ASSERT_EQ(write_hibernating(name, false, text), Z_OK);
+
+  std::vector<uint8_t> data;
+  ASSERT_EQ(test::Inflate(test::ReadFile(name), false, data), Z_OK);
+  EXPECT_EQ(data, text);
+}
+
+TEST(ZppWriterHibernate, SettingsKeptWhileAsleep)
+{
+  test::TempDir dir;
+  ZppWriter writer;
+  ASSERT_EQ(writer.Open(dir.Path("settings.gz")), Z_OK);
+  const std::vector<uint8_t> text = test::MakeText(10000);
+  ASSERT_EQ(writer.Write(text.data(), text.size()), Z_OK);
+  ASSERT_EQ(writer.Hibernate(), Z_OK);
+
+  EXPECT_EQ(writer.SetFlagGzip(false), Z_ERRNO);
+  EXPECT_EQ(writer.SetBlockSize(65536), Z_ERRNO);
+  EXPECT_EQ(writer.SetFormat(ZPP_FORMAT_ZSTD), Z_ERRNO);
+  EXPECT_TRUE(writer.GetFlagGzip());
+  EXPECT_EQ(writer.GetBlockSize(), 0u);
+
+  ASSERT_EQ(writer.Write(text.data(), text.size()), Z_OK);
+  ASSERT_EQ(writer.Close(), Z_OK);
+  EXPECT_EQ(writer.SetFlagGzip(false), Z_OK);
+
+  std::vector<uint8_t> data;
+  ASSERT_EQ(test::Inflate(test::ReadFile(dir.Path("settings.gz")), true, data), Z_OK);
+  EXPECT_EQ(data.size(), 2 * text.size());
+}
+
+TEST(ZppWriterHibernate, ChangedFileNotResumed)
+{
+  test::TempDir dir;
+  const std::string name = dir.Path("changed.gz");
+  ZppWriter writer;
+  ASSERT_EQ(writer.Open(name), Z_OK);
+  const std::vector<uint8_t> text = test::MakeText(10000);
+  ASSERT_EQ(writer.Write(text.data(), text.size()), Z_OK);
+  ASSERT_EQ(writer.Hibernate(), Z_OK);
+
+  std::vector<uint8_t> data = test::ReadFile(name);
+  data.resize(data.size() / 2);
+  ASSERT_TRUE(test::WriteFile(name, data));
+
+  EXPECT_EQ(writer.Resume(), Z_DATA_ERROR);
+  writer.Close();
+  EXPECT_EQ(test::ReadFile(name), data);
+}
+
+TEST(ZppWriterManager, HibernatesBeyondLimit)
+{
+  test::TempDir dir;
+  const int count = 6;
+  std::vector<std::unique_ptr<ZppWriter>> writers;
+  std::vector<std::vector<uint8_t>> texts(count);
+
+  ZppWriterManager manager(1);
+  for (int i = 0; i < count; ++i)
+  {
+    writers.emplace_back(new ZppWriter);
+    ASSERT_EQ(writers.back()->Open(dir.Path("m" + std::to_string(i) + ".gz")), Z_OK);
+    ASSERT_EQ(manager.Add(writers.back().get()), Z_OK);
+  }
+
+  for (int round = 0; round < 5; ++round)
+  {
+    for (int i = 0; i < count; ++i)
+    {
+      const std::vector<uint8_t> text = test::MakeText(5000, static_cast<unsigned int>(round * count + i + 1));
+      texts[i].insert(texts[i].end(), text.begin(), text.end());
+      ASSERT_EQ(manager.Write(writers[i].get(), text.data(), text.size()), Z_OK);
+
+      /* only the writer just used stays awake */
+      EXPECT_EQ(manager.GetActiveCount(), 1u);
+      EXPECT_EQ(manager.GetUsage(), writers[i]->GetMemoryUsage());
+    }
+  }
+
+  for (int i = 0; i < count; ++i)
+  {
+    manager.Remove(writers[i].get());
+    ASSERT_EQ(writers[i]->Close(), Z_OK);
+
+    std::vector<uint8_t> data;
+    ASSERT_EQ(test::Inflate(test::ReadFile(dir.Path("m" + std::to_string(i) + ".gz")), true, data), Z_OK);
+    EXPECT_EQ(data, texts[i]);
+  }
+  EXPECT_EQ(manager.GetCount(), 0u);
+  EXPECT_EQ(manager.GetUsage(), 0u);
+}
@@ -0,0 +1,156 @@
+#ifndef ZPPTEST_HPP
+#define ZPPTEST_HPP
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace slx
+{
+  namespace test
+  {
+    //! Временный каталог теста, удаляется вместе с содержимым
+    class TempDir
+    {
+    public:
+      TempDir()
+      {
+        char path[] = "/tmp/zpptest.XXXXXX";
+        if (mkdtemp(path) != nullptr)
+        {
+          m_path = path;
+        }
+      }
+
+      ~TempDir()
+      {
+        if (m_path.empty() == false)
+        {
+          std::string command = "rm -rf '" + m_path + "'";
+          if (system(command.c_str()) != 0)
+          {
+            fprintf(stderr, "cannot remove %s\n", m_path.c_str());
+          }
+        }
+      }
+
+      TempDir(const TempDir &) = delete;
+      TempDir & operator = (const TempDir &) = delete;
+
+      //! Получить путь к файлу в каталоге
+      std::string Path(const std::string & i_name) const
+      {
+        return m_path + "/" + i_name;
+      }
+
+    private:
+      std::string m_path;
+    };
+
+    //! Строки из повторяющихся псевдослучайных слов
+    inline std::vector<uint8_t> MakeText(size_t i_size, unsigned int i_seed = 1)
+    {
+      std::vector<std::string> words;
+      for (int i = 0; i < 1000; ++i)
+      {
+        std::string word;
+        const int length = 2 + rand_r(&i_seed) % 8;
+        for (int k = 0; k < length; ++k)
+        {
+          word += static_cast<char>('a' + rand_r(&i_seed) % 16);
+        }
+        words.push_back(word);
+      }
+
+      std::vector<uint8_t> text;
+      text.reserve(i_size + 16);
+      while (text.size() < i_size)
+      {
+        const std::string & word = words[rand_r(&i_seed) % words.size()];
+        text.insert(text.end(), word.begin(), word.end());
+        text.push_back(rand_r(&i_seed) % 12 == 0 ? '\n' : ' ');
+      }
+      text.resize(i_size);
+      return text;
+    }
+
+    //! Прочитать файл целиком
+    inline std::vector<uint8_t> ReadFile(const std::string & i_filename)
+    {
+      std::vector<uint8_t> data;
+      FILE * file = fopen(i_filename.c_str(), "rb");
+      if (file == nullptr)
+      {
+        return data;
+      }
+
+      uint8_t buffer[65536];
+      size_t got = 0;
+      while ((got = fread(buffer, 1, sizeof(buffer), file)) != 0)
+      {
+        data.insert(data.end(), buffer, buffer + got);
+      }
+      fclose(file);
+      return data;
+    }
+
+    //! Записать файл целиком
+    inline bool WriteFile(const std::string & i_filename, const std::vector<uint8_t> & i_data)
+    {
+      FILE * file = fopen(i_filename.c_str(), "wb");
+      if (file == nullptr)
+      {
+        return false;
+      }
+
+      const bool flag_ok = fwrite(i_data.data(), 1, i_data.size(), file) == i_data.size();
+      return fclose(file) == 0 && flag_ok;
+    }
+
+    //! Распаковать один поток GZip или zlib, как gunzip
+    /*!
+       Поток должен занимать данные целиком
+
+      \return Z_OK Успех
+     */
+    inline int Inflate(const std::vector<uint8_t> & i_data, bool i_flag_gzip, std::vector<uint8_t> & o_data)
+    {
+      z_stream strm = {};
+      int ret = inflateInit2(&strm, i_flag_gzip ? 31 : 15);
+      if (ret != Z_OK)
+      {
+        return ret;
+      }
+
+      o_data.clear();
+      strm.next_in = const_cast<Bytef *>(i_data.data());
+      strm.avail_in = static_cast<uInt>(i_data.size());
+      uint8_t buffer[65536];
+      do
+      {
+        strm.next_out = buffer;
+        strm.avail_out = sizeof(buffer);
+        ret = inflate(&strm, Z_NO_FLUSH);
+        o_data.insert(o_data.end(), buffer, buffer + sizeof(buffer) - strm.avail_out);
+      }
+      while (ret == Z_OK);
+
+      const bool flag_whole = strm.avail_in == 0;
+      inflateEnd(&strm);
+      if (ret != Z_STREAM_END)
+      {
+        return ret == Z_BUF_ERROR ? Z_DATA_ERROR : ret;
+      }
+
+      return flag_whole ? Z_OK : Z_DATA_ERROR;
+    }
+  }
+}
+
+#endif // ZPPTEST_HPP
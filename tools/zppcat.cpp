@@ -0,0 +1,334 @@
+#include "zpplib.hpp"
+#include "zppreverse.hpp"
+#include "zpptool.hpp"
+
+#include <getopt.h>
+#include <memory>
+#include <unistd.h>
+
+// Чтение участка сжатого файла по смещению или по номерам строк
+
+namespace
+{
+  void Usage()
+  {
+    fprintf(stderr,
+            "Использование: zppcat [параметры] ФАЙЛ\n"
+            "Выводит участок распакованных данных без распаковки всего файла\n"
+            "  -o, --offset N       смещение в распакованных данных\n"
+            "  -n, --length N       количество байт, по умолчанию до конца\n"
+            "  -l, --lines N[,M]    M строк (по умолчанию до конца), начиная с N-й (с 1)\n"
+            "  -r, --reverse N      N последних строк от конца к началу, 0 - все\n"
+            "  -i, --index ИНДЕКС   файл индекса, по умолчанию ФАЙЛ.zpx, если он есть\n"
+            "  -p, --split УЧАСТОК  участок из файла описания zppindex --splits,\n"
+            "                       индекс не нужен\n"
+            "  -t, --threads N      количество потоков, 0 - по числу ядер\n"
+            "  -s, --stats          вывести скорость в stderr\n"
+            "  -h, --help           эта справка\n"
+            "Размеры принимают суффиксы K, M, G\n");
+  }
+
+  bool WriteAll(const std::vector<uint8_t> & i_data)
+  {
+    const uint8_t * cur = i_data.data();
+    size_t left = i_data.size();
+    while (left != 0)
+    {
+      ssize_t done = write(STDOUT_FILENO, cur, left);
+      if (done <= 0)
+      {
+        return false;
+      }
+      cur += done;
+      left -= static_cast<size_t>(done);
+    }
+    return true;
+  }
+
+  int CatSplit(const std::string & i_filename, const std::string & i_split_name, bool i_flag_stats)
+  {
+    using namespace slx;
+
+    std::vector<uint8_t> data;
+    FILE * file = fopen(i_split_name.c_str(), "rb");
+    if (file != nullptr)
+    {
+      uint8_t chunk[4096];
+      size_t got;
+      while ((got = fread(chunk, 1, sizeof(chunk), file)) != 0)
+      {
+        data.insert(data.end(), chunk, chunk + got);
+      }
+      fclose(file);
+    }
+
+    ZppSplit split;
+    if (file == nullptr || split.Deserialize(data.data(), data.size()) != Z_OK)
+    {
+      fprintf(stderr, "zppcat: %s не является описанием участка\n", i_split_name.c_str());
+      return 2;
+    }
+
+    /* the split is decoded from its own access point, no index is built */
+    tool::Timer timer;
+    ZppSplitReader reader;
+    int ret = reader.Open(i_filename, split);
+    if (ret != Z_OK)
+    {
+      fprintf(stderr, "zppcat: не удалось открыть участок %s: %d\n", i_filename.c_str(), ret);
+      return 1;
+    }
+
+    ssize_t total = 0;
+    data.resize(1048576);
+    for (;;)
+    {
+      ssize_t got = reader.Read(data.data(), data.size());
+      if (got <= 0)
+      {
+        total = (got < 0) ? got : total;
+        break;
+      }
+
+      data.resize(static_cast<size_t>(got));
+      if (WriteAll(data) == false)
+      {
+        total = Z_ERRNO;
+        break;
+      }
+      data.resize(1048576);
+      total += got;
+    }
+
+    if (total < 0)
+    {
+      fprintf(stderr, "zppcat: ошибка чтения участка %s: %zd\n", i_filename.c_str(), total);
+      return 1;
+    }
+
+    if (i_flag_stats == true)
+    {
+      tool::PrintThroughput(stderr, "участок", static_cast<size_t>(total), timer.Elapsed());
+    }
+    return 0;
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  using namespace slx;
+
+  static const struct option options[] =
+  {
+    {"offset", required_argument, nullptr, 'o'},
+    {"length", required_argument, nullptr, 'n'},
+    {"lines", required_argument, nullptr, 'l'},
+    {"reverse", required_argument, nullptr, 'r'},
+    {"index", required_argument, nullptr, 'i'},
+    {"split", required_argument, nullptr, 'p'},
+    {"threads", required_argument, nullptr, 't'},
+    {"stats", no_argument, nullptr, 's'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  size_t offset = 0;
+  size_t length = static_cast<size_t>(-1);
+  size_t first_line = 0;
+  size_t line_count = static_cast<size_t>(-1);
+  bool flag_lines = false;
+  bool flag_reverse = false;
+  bool flag_stats = false;
+  std::string index_name;
+  std::string split_name;
+  std::unique_ptr<ZppThreadPool> pool;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:n:l:r:i:p:t:sh", options, nullptr)) != -1)
+  {
+    size_t value = 0;
+    bool flag_ok = true;
+    switch (opt)
+    {
+      case 'o':
+        flag_ok = tool::ParseSize(optarg, offset);
+        break;
+      case 'n':
+        flag_ok = tool::ParseSize(optarg, length);
+        break;
+      case 'l':
+      {
+        std::string text = optarg;
+        size_t comma = text.find(',');
+        flag_lines = true;
+        flag_ok = tool::ParseSize(text.substr(0, comma).c_str(), first_line) && first_line != 0;
+        if (flag_ok == true && comma != std::string::npos)
+        {
+          flag_ok = tool::ParseSize(text.substr(comma + 1).c_str(), line_count);
+        }
+        --first_line;
+        break;
+      }
+      case 'r':
+        flag_reverse = true;
+        flag_ok = tool::ParseSize(optarg, line_count);
+        if (line_count == 0)
+        {
+          line_count = static_cast<size_t>(-1);
+        }
+        break;
+      case 'i':
+        index_name = optarg;
+        break;
+      case 'p':
+        split_name = optarg;
+        break;
+      case 't':
+        flag_ok = tool::ParseSize(optarg, value);
+        pool.reset(new ZppThreadPool(value));
+        break;
+      case 's':
+        flag_stats = true;
+        break;
+      case 'h':
+        Usage();
+        return 0;
+      default:
+        flag_ok = false;
+        break;
+    }
+
+    if (flag_ok == false)
+    {
+      Usage();
+      return 2;
+    }
+  }
+
+  if (optind + 1 != argc)
+  {
+    Usage();
+    return 2;
+  }
+
+  const std::string filename = argv[optind];
+  if (split_name.empty() == false)
+  {
+    return CatSplit(filename, split_name, flag_stats);
+  }
+
+  const bool flag_index = index_name.empty() == false;
+  if (flag_index == false)
+  {
+    index_name = tool::IndexName(filename);
+  }
+
+  ZppReader reader;
+  reader.SetThreadPool(pool.get());
+  if (reader.Open(filename, false) != Z_OK)
+  {
+    fprintf(stderr, "zppcat: не удалось открыть %s\n", filename.c_str());
+    return 2;
+  }
+
+  /* a saved index is used when it matches the file */
+  tool::Timer timer;
+  int ret = reader.LoadIndex(index_name);
+  if (ret < 0 && flag_index == true)
+  {
+    fprintf(stderr, "zppcat: индекс %s не подходит (%d), строится заново\n", index_name.c_str(), ret);
+  }
+  if (ret < 0)
+  {
+    ret = reader.BuildIndex();
+  }
+  if (ret < 0)
+  {
+    fprintf(stderr, "zppcat: ошибка построения индекса %s: %d\n", filename.c_str(), ret);
+    return 1;
+  }
+
+  ssize_t total = 0;
+  if (flag_reverse == true)
+  {
+    /* each interval is decoded once, the preceding one in the background */
+    ZppReverseReader reverse(&reader);
+    std::vector<uint8_t> line;
+    std::vector<uint8_t> data;
+    for (size_t count = 0; count < line_count; ++count)
+    {
+      ssize_t got = reverse.ReadLine(line);
+      if (got == ZPP_END)
+      {
+        break;
+      }
+      if (got < 0)
+      {
+        total = got;
+        break;
+      }
+
+      data.insert(data.end(), line.begin(), line.end());
+      data.push_back('\n');
+      total += got + 1;
+      if (data.size() >= 1048576)
+      {
+        if (WriteAll(data) == false)
+        {
+          total = Z_ERRNO;
+          break;
+        }
+        data.clear();
+      }
+    }
+    if (total >= 0 && WriteAll(data) == false)
+    {
+      total = Z_ERRNO;
+    }
+  }
+  else if (flag_lines == false)
+  {
+    total = reader.DecompressRange(STDOUT_FILENO, length, offset);
+  }
+  else
+  {
+    ret = reader.BuildLineIndex();
+    if (ret < 0)
+    {
+      fprintf(stderr, "zppcat: ошибка построения индекса строк: %d\n", ret);
+      return 1;
+    }
+
+    const size_t lines = reader.GetLineCount();
+    const size_t last = first_line + std::min(line_count, lines - std::min(first_line, lines));
+    const size_t batch = 4096;
+    std::vector<uint8_t> data;
+    for (size_t line = first_line; line < last && total >= 0; line += batch)
+    {
+      ssize_t got = reader.ReadLines(line, std::min(batch, last - line), data);
+      if (got < 0)
+      {
+        total = got;
+        break;
+      }
+      if (WriteAll(data) == false)
+      {
+        total = Z_ERRNO;
+        break;
+      }
+      total += got;
+    }
+  }
+
+  if (total < 0)
+  {
+    fprintf(stderr, "zppcat: ошибка чтения %s: %zd\n", filename.c_str(), total);
+    return 1;
+  }
+
+  if (flag_stats == true)
+  {
+    tool::PrintThroughput(stderr, "чтение", static_cast<size_t>(total), timer.Elapsed());
+  }
+  return 0;
+}
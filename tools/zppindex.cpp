@@ -0,0 +1,197 @@
+#include "zpplib.hpp"
+#include "zpptool.hpp"
+
+#include <getopt.h>
+#include <memory>
+
+// Построение и сохранение индекса, проверка целостности сжатого файла
+
+namespace
+{
+  void Usage()
+  {
+    fprintf(stderr,
+            "Использование: zppindex [параметры] ФАЙЛ\n"
+            "Строит индекс произвольного доступа и сохраняет его в ФАЙЛ.zpx\n"
+            "  -o, --output ИНДЕКС  имя файла индекса\n"
+            "  -t, --threads N      количество потоков, 0 - по числу ядер\n"
+            "  -V, --verify         проверить целостность вместо построения;\n"
+            "                       используется сохранённый индекс, если он есть\n"
+            "  -d, --direct         читать в обход страничного кэша\n"
+            "  -s, --splits N       разбить данные по строкам на N участков и\n"
+            "                       сохранить их описания в ИНДЕКС.0, ИНДЕКС.1, ...\n"
+            "                       для zppcat --split\n"
+            "  -h, --help           эта справка\n");
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  using namespace slx;
+
+  static const struct option options[] =
+  {
+    {"output", required_argument, nullptr, 'o'},
+    {"threads", required_argument, nullptr, 't'},
+    {"verify", no_argument, nullptr, 'V'},
+    {"direct", no_argument, nullptr, 'd'},
+    {"splits", required_argument, nullptr, 's'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  std::string index_name;
+  std::unique_ptr<ZppThreadPool> pool;
+  bool flag_verify = false;
+  size_t split_count = 0;
+  ZppIoPolicy policy = ZPP_IO_STREAM;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:t:Vds:h", options, nullptr)) != -1)
+  {
+    size_t value = 0;
+    switch (opt)
+    {
+      case 'o':
+        index_name = optarg;
+        break;
+      case 't':
+        if (tool::ParseSize(optarg, value) == false)
+        {
+          Usage();
+          return 2;
+        }
+        pool.reset(new ZppThreadPool(value));
+        break;
+      case 'V':
+        flag_verify = true;
+        break;
+      case 'd':
+        policy = ZPP_IO_DIRECT;
+        break;
+      case 's':
+        if (tool::ParseSize(optarg, split_count) == false || split_count == 0)
+        {
+          Usage();
+          return 2;
+        }
+        break;
+      case 'h':
+        Usage();
+        return 0;
+      default:
+        Usage();
+        return 2;
+    }
+  }
+
+  if (optind + 1 != argc)
+  {
+    Usage();
+    return 2;
+  }
+
+  const std::string filename = argv[optind];
+  if (index_name.empty() == true)
+  {
+    index_name = tool::IndexName(filename);
+  }
+
+  ZppReader reader;
+  reader.SetThreadPool(pool.get());
+  reader.SetIoPolicy(policy);
+  if (reader.Open(filename, false) != Z_OK)
+  {
+    fprintf(stderr, "zppindex: не удалось открыть %s\n", filename.c_str());
+    return 2;
+  }
+
+  tool::Timer timer;
+  int ret = Z_ERRNO;
+  if (flag_verify == true)
+  {
+    ret = reader.LoadIndex(index_name);
+  }
+  if (ret < 0)
+  {
+    ret = reader.BuildIndex();
+  }
+  if (ret == Z_DATA_ERROR && flag_verify == true)
+  {
+    printf("%s: повреждение, индекс не строится\n", filename.c_str());
+    return 1;
+  }
+  if (ret < 0)
+  {
+    fprintf(stderr, "zppindex: ошибка построения индекса %s: %d\n", filename.c_str(), ret);
+    return 1;
+  }
+  const double index_time = timer.Elapsed();
+  const int points = ret;
+
+  if (flag_verify == false)
+  {
+    ret = reader.SaveIndex(index_name);
+    if (ret != Z_OK)
+    {
+      fprintf(stderr, "zppindex: не удалось сохранить индекс %s: %d\n", index_name.c_str(), ret);
+      return 1;
+    }
+
+    printf("%s: точек доступа %d, несжатый размер %zu\n", index_name.c_str(), points, reader.GetSize());
+    tool::PrintThroughput(stdout, "индекс", reader.GetSize(), index_time);
+
+    if (split_count != 0)
+    {
+      std::vector<ZppSplit> splits;
+      ssize_t count = reader.PlanSplits(split_count, splits, 0, true);
+      if (count < 0)
+      {
+        fprintf(stderr, "zppindex: ошибка разбиения %s: %zd\n", filename.c_str(), count);
+        return 1;
+      }
+
+      for (size_t i = 0; i < splits.size(); ++i)
+      {
+        const std::string split_name = index_name + "." + std::to_string(i);
+        const std::vector<uint8_t> data = splits[i].Serialize();
+        FILE * file = fopen(split_name.c_str(), "wb");
+        bool flag_ok = file != nullptr && fwrite(data.data(), 1, data.size(), file) == data.size();
+        if (file != nullptr && fclose(file) != 0)
+        {
+          flag_ok = false;
+        }
+        if (flag_ok == false)
+        {
+          fprintf(stderr, "zppindex: не удалось сохранить участок %s\n", split_name.c_str());
+          return 1;
+        }
+
+        printf("%s: байты %llu-%llu, сжатые %llu-%llu\n", split_name.c_str(),
+               static_cast<unsigned long long>(splits[i].begin),
+               static_cast<unsigned long long>(splits[i].end),
+               static_cast<unsigned long long>(splits[i].compressed_begin),
+               static_cast<unsigned long long>(splits[i].compressed_end));
+      }
+    }
+    return 0;
+  }
+
+  tool::Timer verify_timer;
+  size_t offset = 0, in = 0;
+  ret = reader.Verify(offset, in);
+  if (ret == Z_DATA_ERROR)
+  {
+    printf("%s: повреждение, несжатое смещение %zu, сжатое смещение %zu\n", filename.c_str(), offset, in);
+    return 1;
+  }
+  if (ret != Z_OK)
+  {
+    fprintf(stderr, "zppindex: ошибка проверки %s: %d\n", filename.c_str(), ret);
+    return 2;
+  }
+
+  printf("%s: OK\n", filename.c_str());
+  tool::PrintThroughput(stdout, "проверка", reader.GetSize(), verify_timer.Elapsed());
+  return 0;
+}
@@ -0,0 +1,177 @@
+#include "zpplib.hpp"
+#include "zpptool.hpp"
+#include "zpptranscode.hpp"
+
+#include <getopt.h>
+#include <memory>
+#include <unistd.h>
+
+// Перепаковка сжатого файла в блочный формат с произвольным доступом
+
+namespace
+{
+  void Usage()
+  {
+    fprintf(stderr,
+            "Использование: zpprepack [параметры] ФАЙЛ\n"
+            "Перепаковывает ФАЙЛ (gzip, zlib, блоки, zstd) независимыми блоками\n"
+            "GZip в ФАЙЛ.zpp.gz; результат читается gunzip и открывается без\n"
+            "распаковки всего файла\n"
+            "  -o, --output ИМЯ     имя результата, \"-\" - stdout\n"
+            "  -l, --level N        уровень сжатия 0-9, для zstd до 22\n"
+            "  -b, --block N        размер блока или кадра zstd, по умолчанию 1M\n"
+            "  -i, --index ИНДЕКС   индекс ФАЙЛа, по умолчанию ФАЙЛ.zpx, если он есть\n"
+            "  -t, --threads N      количество потоков, 0 - по числу ядер\n"
+            "  -Z, --zstd           кадры zstd с таблицей поиска, в ФАЙЛ.zpp.zst\n"
+            "  -h, --help           эта справка\n"
+            "Размеры принимают суффиксы K, M, G\n");
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  using namespace slx;
+
+  static const struct option options[] =
+  {
+    {"output", required_argument, nullptr, 'o'},
+    {"level", required_argument, nullptr, 'l'},
+    {"block", required_argument, nullptr, 'b'},
+    {"index", required_argument, nullptr, 'i'},
+    {"threads", required_argument, nullptr, 't'},
+    {"zstd", no_argument, nullptr, 'Z'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  ZppTranscoder transcoder;
+  std::string output;
+  std::string index_name;
+  std::unique_ptr<ZppThreadPool> pool;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:l:b:i:t:Zh", options, nullptr)) != -1)
+  {
+    size_t value = 0;
+    bool flag_ok = true;
+    switch (opt)
+    {
+      case 'o':
+        output = optarg;
+        break;
+      case 'l':
+        flag_ok = tool::ParseSize(optarg, value) && value <= tool::MAX_ZSTD_LEVEL;
+        transcoder.SetCompressionLevel(static_cast<int>(value));
+        break;
+      case 'b':
+        flag_ok = tool::ParseSize(optarg, value) && value != 0;
+        transcoder.SetBlockSize(value);
+        break;
+      case 'i':
+        index_name = optarg;
+        break;
+      case 't':
+        flag_ok = tool::ParseSize(optarg, value);
+        pool.reset(new ZppThreadPool(value));
+        break;
+      case 'Z':
+        transcoder.SetFormat(ZPP_FORMAT_ZSTD);
+        break;
+      case 'h':
+        Usage();
+        return 0;
+      default:
+        flag_ok = false;
+        break;
+    }
+
+    if (flag_ok == false)
+    {
+      Usage();
+      return 2;
+    }
+  }
+
+  if (optind + 1 != argc)
+  {
+    Usage();
+    return 2;
+  }
+
+  // допустимый уровень зависит от формата, выбранного любым параметром
+  if (tool::CheckLevel(transcoder.GetFormat(), transcoder.GetCompressionLevel()) == false)
+  {
+    fprintf(stderr, "zpprepack: уровень сжатия deflate 0-9, zstd до %d\n", tool::MAX_ZSTD_LEVEL);
+    return 2;
+  }
+
+  const std::string filename = argv[optind];
+  if (output.empty() == true)
+  {
+    std::string base = filename;
+    if (base.size() > 3 && base.compare(base.size() - 3, 3, ".gz") == 0)
+    {
+      base.resize(base.size() - 3);
+    }
+    output = base + (transcoder.GetFormat() == ZPP_FORMAT_ZSTD ? ".zpp.zst" : ".zpp.gz");
+  }
+  if (output == filename)
+  {
+    fprintf(stderr, "zpprepack: результат совпадает с исходным файлом\n");
+    return 2;
+  }
+
+  const bool flag_index = index_name.empty() == false;
+  if (flag_index == false)
+  {
+    index_name = tool::IndexName(filename);
+  }
+
+  // распаковка и сжатие выполняются в одном пуле
+  ZppReader reader;
+  reader.SetThreadPool(pool.get());
+  transcoder.SetThreadPool(pool.get());
+  if (reader.Open(filename, false) != Z_OK)
+  {
+    fprintf(stderr, "zpprepack: не удалось открыть %s\n", filename.c_str());
+    return 2;
+  }
+
+  tool::Timer timer;
+  int ret = reader.LoadIndex(index_name);
+  if (ret < 0 && flag_index == true)
+  {
+    fprintf(stderr, "zpprepack: индекс %s не подходит (%d), строится заново\n", index_name.c_str(), ret);
+  }
+  if (ret < 0)
+  {
+    ret = reader.BuildIndex();
+  }
+  if (ret < 0)
+  {
+    fprintf(stderr, "zpprepack: ошибка построения индекса %s: %d\n", filename.c_str(), ret);
+    return 1;
+  }
+  const double index_time = timer.Elapsed();
+
+  tool::Timer transcode_timer;
+  if (output == "-")
+  {
+    ZppFdSink out(STDOUT_FILENO);
+    ret = transcoder.Transcode(&reader, &out);
+  }
+  else
+  {
+    ret = transcoder.Transcode(&reader, output);
+  }
+  if (ret != Z_OK)
+  {
+    fprintf(stderr, "zpprepack: ошибка перепаковки %s: %d\n", filename.c_str(), ret);
+    return 1;
+  }
+
+  fprintf(stderr, "%s: %zu -> %zu байт\n", output.c_str(), transcoder.GetTotalIn(), transcoder.GetTotalOut());
+  tool::PrintThroughput(stderr, "индекс", reader.GetSize(), index_time);
+  tool::PrintThroughput(stderr, "перепаковка", transcoder.GetTotalIn(), transcode_timer.Elapsed());
+  return 0;
+}
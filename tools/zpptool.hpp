@@ -0,0 +1,115 @@
+#ifndef ZPPTOOL_HPP
+#define ZPPTOOL_HPP
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "zpplib.hpp"
+
+// Общие функции утилит командной строки
+
+namespace slx
+{
+  namespace tool
+  {
+    //! Разобрать размер с необязательным суффиксом K, M или G
+    /*!
+      \return true Успех
+     */
+    inline bool ParseSize
+    (
+        const char * i_text //!< [in] Текст
+      , size_t & o_size //!< [out] Размер в байтах
+    )
+    {
+      char * end = nullptr;
+      unsigned long long value = strtoull(i_text, &end, 10);
+      if (end == i_text)
+      {
+        return false;
+      }
+
+      switch (*end)
+      {
+        case 'K': case 'k': value <<= 10; ++end; break;
+        case 'M': case 'm': value <<= 20; ++end; break;
+        case 'G': case 'g': value <<= 30; ++end; break;
+        default: break;
+      }
+
+      if (*end != '\0')
+      {
+        return false;
+      }
+
+      o_size = static_cast<size_t>(value);
+      return true;
+    }
+
+    //! Наибольший уровень сжатия zstd
+    const int MAX_ZSTD_LEVEL = 22;
+
+    //! Проверить уровень сжатия для формата
+    /*!
+      \return true Уровень допустим, в том числе Z_DEFAULT_COMPRESSION
+     */
+    inline bool CheckLevel
+    (
+        ZppFormat i_format //!< [in] Формат сжатия
+      , int i_level //!< [in] Уровень сжатия
+    )
+    {
+      if (i_level == Z_DEFAULT_COMPRESSION)
+      {
+        return true;
+      }
+
+      const int max_level = (i_format == ZPP_FORMAT_ZSTD) ? MAX_ZSTD_LEVEL : 9;
+      return i_level >= 0 && i_level <= max_level;
+    }
+
+    //! Секундомер
+    class Timer
+    {
+    public:
+      //! Получить время с момента создания
+      /*!
+        \return Время в секундах
+       */
+      double Elapsed() const
+      {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+      }
+
+    protected:
+      std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+    };
+
+    //! Вывести скорость обработки
+    inline void PrintThroughput
+    (
+        FILE * i_file //!< [in] Файл для вывода
+      , const char * i_what //!< [in] Название операции
+      , size_t i_bytes //!< [in] Количество обработанных байт
+      , double i_seconds //!< [in] Время в секундах
+    )
+    {
+      const double mib = static_cast<double>(i_bytes) / (1024.0 * 1024.0);
+      fprintf(i_file, "%s: %zu байт за %.3f с, %.1f МиБ/с\n"
+              , i_what, i_bytes, i_seconds, i_seconds > 0 ? mib / i_seconds : 0.0);
+    }
+
+    //! Имя файла индекса по умолчанию
+    inline std::string IndexName
+    (
+        const std::string & i_filename //!< [in] Имя сжатого файла
+    )
+    {
+      return i_filename + ".zpx";
+    }
+  }
+}
+
+#endif // ZPPTOOL_HPP
@@ -0,0 +1,185 @@
+#include "zpplib.hpp"
+#include "zpptool.hpp"
+
+#include <getopt.h>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Сжатие файла через ZppWriter
+
+namespace
+{
+  void Usage()
+  {
+    fprintf(stderr,
+            "Использование: zppzip [параметры] ФАЙЛ\n"
+            "Сжимает ФАЙЛ в ФАЙЛ.gz\n"
+            "  -o, --output ИМЯ     имя сжатого файла, \"-\" - stdout\n"
+            "  -l, --level N        уровень сжатия 0-9, для zstd до 22\n"
+            "  -c, --chunk N        размер буфера записи\n"
+            "  -b, --block N        размер независимого блока или кадра zstd, включает блочный формат\n"
+            "  -t, --threads N      количество потоков для блоков, 0 - по числу ядер\n"
+            "  -z, --zlib           формат zlib вместо gzip\n"
+            "  -Z, --zstd           кадры zstd с таблицей поиска, в ФАЙЛ.zst\n"
+            "  -h, --help           эта справка\n"
+            "Размеры принимают суффиксы K, M, G\n");
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  using namespace slx;
+
+  static const struct option options[] =
+  {
+    {"output", required_argument, nullptr, 'o'},
+    {"level", required_argument, nullptr, 'l'},
+    {"chunk", required_argument, nullptr, 'c'},
+    {"block", required_argument, nullptr, 'b'},
+    {"threads", required_argument, nullptr, 't'},
+    {"zlib", no_argument, nullptr, 'z'},
+    {"zstd", no_argument, nullptr, 'Z'},
+    {"help", no_argument, nullptr, 'h'},
+    {nullptr, 0, nullptr, 0}
+  };
+
+  ZppWriter writer;
+  std::string output;
+  std::unique_ptr<ZppThreadPool> pool;
+
+  int opt;
+  while ((opt = getopt_long(argc, argv, "o:l:c:b:t:zZh", options, nullptr)) != -1)
+  {
+    size_t value = 0;
+    bool flag_ok = true;
+    switch (opt)
+    {
+      case 'o':
+        output = optarg;
+        break;
+      case 'l':
+        flag_ok = tool::ParseSize(optarg, value) && value <= tool::MAX_ZSTD_LEVEL;
+        writer.SetCompressionLevel(static_cast<int>(value));
+        break;
+      case 'c':
+        flag_ok = tool::ParseSize(optarg, value) && value != 0;
+        writer.SetChunkSize(value);
+        break;
+      case 'b':
+        flag_ok = tool::ParseSize(optarg, value) && value <= ZppWriter::MAX_BLOCK_SIZE;
+        writer.SetBlockSize(value);
+        break;
+      case 't':
+        flag_ok = tool::ParseSize(optarg, value);
+        pool.reset(new ZppThreadPool(value));
+        writer.SetThreadPool(pool.get());
+        break;
+      case 'z':
+        writer.SetFlagGzip(false);
+        break;
+      case 'Z':
+        writer.SetFormat(ZPP_FORMAT_ZSTD);
+        break;
+      case 'h':
+        Usage();
+        return 0;
+      default:
+        flag_ok = false;
+        break;
+    }
+
+    if (flag_ok == false)
+    {
+      Usage();
+      return 2;
+    }
+  }
+
+  if (optind + 1 != argc)
+  {
+    Usage();
+    return 2;
+  }
+
+  // допустимый уровень зависит от формата, выбранного любым параметром
+  if (tool::CheckLevel(writer.GetFormat(), writer.GetCompressionLevel()) == false)
+  {
+    fprintf(stderr, "zppzip: уровень сжатия deflate 0-9, zstd до %d\n", tool::MAX_ZSTD_LEVEL);
+    return 2;
+  }
+
+  const std::string filename = argv[optind];
+  if (output.empty() == true)
+  {
+    if (writer.GetFormat() == ZPP_FORMAT_ZSTD)
+    {
+      output = filename + ".zst";
+    }
+    else
+    {
+      output = filename + (writer.GetFlagGzip() ? ".gz" : ".zz");
+    }
+  }
+
+  if (pool != nullptr && writer.GetBlockSize() == 0 && writer.GetFormat() != ZPP_FORMAT_ZSTD)
+  {
+    fprintf(stderr, "zppzip: потоки используются только в блочном формате (--block)\n");
+  }
+
+  FILE * input = fopen(filename.c_str(), "rb");
+  if (input == nullptr)
+  {
+    fprintf(stderr, "zppzip: не удалось открыть %s\n", filename.c_str());
+    return 2;
+  }
+
+  // stdout без буферизации stdio, группа блоков - одним writev()
+  ZppFdSink out(STDOUT_FILENO);
+  int ret = output == "-" ? writer.Open(&out) : writer.Open(output);
+  if (ret != Z_OK)
+  {
+    fprintf(stderr, "zppzip: не удалось создать %s: %d\n", output.c_str(), ret);
+    fclose(input);
+    return 2;
+  }
+
+  tool::Timer timer;
+  size_t total = 0;
+  std::vector<uint8_t> data(1 << 20);
+  size_t got;
+  while ((got = fread(data.data(), 1, data.size(), input)) != 0)
+  {
+    ret = writer.Write(data.data(), got);
+    if (ret != Z_OK)
+    {
+      break;
+    }
+    total += got;
+  }
+
+  if (ferror(input))
+  {
+    ret = Z_ERRNO;
+  }
+  fclose(input);
+
+  int close_ret = writer.Close();
+  if (ret == Z_OK)
+  {
+    ret = close_ret;
+  }
+  if (ret != Z_OK)
+  {
+    fprintf(stderr, "zppzip: ошибка сжатия %s: %d\n", filename.c_str(), ret);
+    return 1;
+  }
+
+  struct stat st;
+  if (output != "-" && stat(output.c_str(), &st) == 0)
+  {
+    fprintf(stderr, "%s: %zu -> %zu байт\n", output.c_str(), total, static_cast<size_t>(st.st_size));
+  }
+  tool::PrintThroughput(stderr, "сжатие", total, timer.Elapsed());
+  return 0;
+}